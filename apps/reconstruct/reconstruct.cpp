@@ -19,9 +19,12 @@
 // Author(s):
 // Ravi Peters
 
+#include <algorithm>
 #include <cstddef>
 #include <filesystem>
+#include <optional>
 #include <string>
+#include <variant>
 
 #include "argh.h"
 #include "toml.hpp"
@@ -29,6 +32,7 @@
 #include <rerun.hpp>
 #endif
 
+#include <roofer/DebugConfig.hpp>
 #include <roofer/io/PointCloudReader.hpp>
 #include <roofer/io/VectorReader.hpp>
 #include <roofer/misc/PC2MeshDistCalculator.hpp>
@@ -102,6 +106,8 @@ struct rerun::CollectionAdapter<rerun::Position3D, roofer::TriangleCollection> {
 
 enum LOD { LOD12 = 12, LOD13 = 13, LOD22 = 22 };
 
+using roofer::collect_debug;
+
 std::unordered_map<int, roofer::Mesh> extrude(
     roofer::Arrangement_2 arrangement, float floor_elevation,
 #ifdef RF_USE_VAL3DITY
@@ -148,8 +154,9 @@ std::unordered_map<int, roofer::Mesh> extrude(
 
   auto ArrangementExtruder =
       roofer::reconstruction::createArrangementExtruder();
-  ArrangementExtruder->compute(arrangement, floor_elevation,
-                               {.LoD2 = extrude_LoD2});
+  ArrangementExtruder->compute(
+      arrangement, floor_elevation,
+      {.LoD2 = extrude_LoD2, .collect_debug = collect_debug});
   logger.info("Completed ArrangementExtruder");
 #ifdef RF_USE_RERUN
   rec.log(worldname + "ArrangementExtruder",
@@ -203,6 +210,59 @@ void print_help(std::string program_name) {
   std::cout << "   -c <file>, --config <file>   Config file" << "\n";
 }
 
+// A building in a tile packed crop output (roofer --crop-output-tiled)
+struct TileIndexEntry {
+  std::string footprint_source;
+  // position of the building in the tile
+  size_t position;
+  std::string pointcloud_source;
+  // range of the building's points in pointcloud_source
+  size_t first;
+  size_t count;
+  float ground_elevation;
+};
+
+// Looks up building bid, or the first building if bid is empty, in a tile
+// index. The points are those of the pointcloud that was selected for it.
+TileIndexEntry read_tile_index(const std::string& path,
+                               const std::string& bid) {
+  auto index = toml::parse_file(path);
+  auto bids = index["bid"].as_array();
+  auto pointclouds = index["pointclouds"].as_array();
+  auto footprint_source = index["polygon-source"].value<std::string>();
+  if (!bids || !pointclouds || !footprint_source) {
+    throw std::runtime_error(path + " is not a tile index");
+  }
+
+  TileIndexEntry entry{.footprint_source = *footprint_source};
+  auto it = std::find_if(bids->begin(), bids->end(), [&](auto& node) {
+    return bid.empty() || node.value_or(std::string()) == bid;
+  });
+  if (it == bids->end()) {
+    throw std::runtime_error("Building " + bid + " is not in " + path);
+  }
+  entry.position = std::distance(bids->begin(), it);
+
+  auto pc_name = index["selected"][entry.position].value_or(std::string());
+  for (auto& node : *pointclouds) {
+    toml::node_view pc(node);
+    if (pc["name"].value_or(std::string()) != pc_name) continue;
+    auto first = pc["first"][entry.position].value<int64_t>();
+    auto count = pc["count"][entry.position].value<int64_t>();
+    auto ground_elevation =
+        pc["ground_elevation"][entry.position].value<double>();
+    if (!first || !count || !ground_elevation) break;
+    entry.pointcloud_source = pc["source"].value_or(std::string());
+    entry.first = *first;
+    entry.count = *count;
+    entry.ground_elevation = *ground_elevation;
+    return entry;
+  }
+  throw std::runtime_error("Pointcloud " + pc_name + " of building " +
+                           std::string(it->value_or(std::string())) +
+                           " is not in " + path);
+}
+
 void print_version() {
   std::cout << fmt::format(
       "roofer {} ({}{}{})\n", git_Describe(),
@@ -268,6 +328,8 @@ int main(int argc, const char* argv[]) {
   float CITYJSON_SCALE_Z = 0.01;
   float floor_elevation = -0.16899998486042023;
   size_t fp_i = 0;
+  std::string path_tile_index;
+  std::string bid;
 
   toml::table config;
 
@@ -292,6 +354,14 @@ int main(int argc, const char* argv[]) {
     auto tml_path_pointcloud = config["INPUT_POINTCLOUD"].value<std::string>();
     if (tml_path_pointcloud.has_value()) path_pointcloud = *tml_path_pointcloud;
 
+    // Read the building from a tile packed crop output instead, this
+    // overrides INPUT_FOOTPRINT, INPUT_POINTCLOUD and GROUND_ELEVATION
+    auto tml_path_tile_index = config["INPUT_TILE_INDEX"].value<std::string>();
+    if (tml_path_tile_index.has_value()) path_tile_index = *tml_path_tile_index;
+
+    auto tml_bid = config["BID"].value<std::string>();
+    if (tml_bid.has_value()) bid = *tml_bid;
+
     auto tml_building_bid_attribute =
         config["id_attribute"].value<std::string>();
     if (tml_building_bid_attribute.has_value())
@@ -357,6 +427,20 @@ int main(int argc, const char* argv[]) {
     return EXIT_FAILURE;
   }
 
+  std::optional<TileIndexEntry> tile_entry;
+  if (!path_tile_index.empty()) {
+    try {
+      tile_entry = read_tile_index(path_tile_index, bid);
+    } catch (const std::exception& e) {
+      logger.error("Unable to read tile index {}.\n{}", path_tile_index,
+                   e.what());
+      return EXIT_FAILURE;
+    }
+    path_footprint = tile_entry->footprint_source;
+    path_pointcloud = tile_entry->pointcloud_source;
+    floor_elevation = tile_entry->ground_elevation;
+  }
+
   // Create Writer. TODO: check if we can write to output file prior to doing
   // reconstruction?
   auto pj = roofer::misc::createProjHelper();
@@ -382,12 +466,27 @@ int main(int argc, const char* argv[]) {
   std::vector<roofer::LinearRing> footprints;
   roofer::AttributeVecMap attributes;
   VectorReader->readPolygons(footprints, &attributes);
+  if (tile_entry) {
+    // keep only this building, the attributes of the other buildings in the
+    // tile are not needed
+    auto position = tile_entry->position;
+    footprints = {footprints.at(position)};
+    for (auto& [name, values] : attributes.get_attributes()) {
+      std::visit([&](auto& vec) { vec = {vec.at(position)}; }, values);
+    }
+  }
 
   PointReader->open(path_pointcloud);
   logger.info("Reading pointcloud from {}", path_pointcloud);
   roofer::vec1i classification;
   roofer::PointCollection points, points_ground, points_roof;
-  PointReader->readPointCloud(points, &classification);
+  if (tile_entry) {
+    // only the building's points are read from the tile pointcloud
+    PointReader->readPointCloudSlice(tile_entry->first, tile_entry->count,
+                                     points, &classification);
+  } else {
+    PointReader->readPointCloud(points, &classification);
+  }
   logger.info("Read {} points", points.size());
 
   // split into ground and roof points
@@ -488,8 +587,9 @@ int main(int argc, const char* argv[]) {
   if (skip) {
     auto SimplePolygonExtruder =
         roofer::reconstruction::createSimplePolygonExtruder();
-    SimplePolygonExtruder->compute(footprints[fp_i], floor_elevation,
-                                   PlaneDetector->roof_elevation_70p);
+    SimplePolygonExtruder->compute(
+        footprints[fp_i], floor_elevation,
+        PlaneDetector->roof_elevation_70p.value_or(floor_elevation));
     fs::create_directories(fs::path(path_output_jsonl).parent_path());
     std::ofstream ofs;
     ofs.open(path_output_jsonl);
@@ -501,7 +601,8 @@ int main(int argc, const char* argv[]) {
     logger.info("Completed CityJsonWriter to {}", path_output_jsonl);
   } else {
     auto AlphaShaper = roofer::reconstruction::createAlphaShaper();
-    AlphaShaper->compute(PlaneDetector->pts_per_roofplane);
+    AlphaShaper->compute(PlaneDetector->pts_per_roofplane,
+                         {.collect_debug = collect_debug});
     logger.info("Completed AlphaShaper (roof), found {} rings, {} labels",
                 AlphaShaper->alpha_rings.size(),
                 AlphaShaper->roofplane_ids.size());
@@ -512,7 +613,8 @@ int main(int argc, const char* argv[]) {
 #endif
 
     auto AlphaShaper_ground = roofer::reconstruction::createAlphaShaper();
-    AlphaShaper_ground->compute(PlaneDetector_ground->pts_per_roofplane);
+    AlphaShaper_ground->compute(PlaneDetector_ground->pts_per_roofplane,
+                                {.collect_debug = collect_debug});
     logger.info("Completed AlphaShaper (ground), found {} rings, {} labels",
                 AlphaShaper_ground->alpha_rings.size(),
                 AlphaShaper_ground->roofplane_ids.size());
@@ -524,7 +626,8 @@ int main(int argc, const char* argv[]) {
 
     auto LineDetector = roofer::reconstruction::createLineDetector();
     LineDetector->detect(AlphaShaper->alpha_rings, AlphaShaper->roofplane_ids,
-                         PlaneDetector->pts_per_roofplane);
+                         PlaneDetector->pts_per_roofplane,
+                         {.collect_debug = collect_debug});
     logger.info("Completed LineDetector");
 #ifdef RF_USE_RERUN
     rec.log("world/boundary_lines",
@@ -551,14 +654,15 @@ int main(int argc, const char* argv[]) {
 
     auto SegmentRasteriser = roofer::reconstruction::createSegmentRasteriser();
     SegmentRasteriser->compute(AlphaShaper->alpha_triangles,
-                               AlphaShaper_ground->alpha_triangles);
+                               AlphaShaper_ground->alpha_triangles,
+                               {.collect_debug = collect_debug});
     logger.info("Completed SegmentRasteriser");
 
+#ifdef RF_USE_RERUN
     auto heightfield_copy = SegmentRasteriser->heightfield;
     heightfield_copy.set_nodata(0);
-#ifdef RF_USE_RERUN
     rec.log("world/heightfield",
-            rerun::DepthImage(heightfield_copy.vals_->data(),
+            rerun::DepthImage(heightfield_copy.vals_.data(),
                               {static_cast<uint32_t>(heightfield_copy.dimx_),
                                static_cast<uint32_t>(heightfield_copy.dimy_)}));
 #endif
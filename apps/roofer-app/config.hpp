@@ -31,11 +31,13 @@
 
 #include <roofer/common/common.hpp>
 #include <roofer/logger/logger.h>
+#include <roofer/DebugConfig.hpp>
 #include <roofer/ReconstructionConfig.hpp>
 #include <roofer/misc/Vector2DOps.hpp>
 #include <stdexcept>
 #include <string>
 #include <list>
+#include <sstream>
 #include <filesystem>
 #include "git.h"
 
@@ -68,6 +70,8 @@ struct InputPointcloud {
 
   std::unique_ptr<roofer::misc::RTreeInterface> rtree;
   std::vector<fileExtent> file_extents;
+  // number of points in each file of file_extents
+  std::vector<size_t> file_point_counts;
 };
 
 struct RooferConfig {
@@ -79,6 +83,7 @@ struct RooferConfig {
   std::string layer_name;
   int layer_id = 0;
   std::string attribute_filter;
+  std::vector<std::string> attributes_keep;
 
   // crop parameters
   float ceil_point_density = 20;
@@ -86,9 +91,16 @@ struct RooferConfig {
   int lod11_fallback_area = 69000;
   float lod11_fallback_density = 5;
   roofer::arr2f tilesize = {1000, 1000};
+  bool align_tiles = false;
+  bool adaptive_tiling = false;
+  int tile_max_buildings = 2500;
+  int tile_max_points = 100000000;
   bool clear_if_insufficient = true;
+  std::string crop_cache;
+  int crop_threads = 4;
 
   bool write_crop_outputs = false;
+  bool write_tiled_crop_outputs = false;
   bool output_all = false;
   bool write_rasters = false;
   bool write_index = false;
@@ -100,6 +112,10 @@ struct RooferConfig {
   // crop output
   bool split_cjseq = false;
   bool omit_metadata = false;
+  std::string output_format = "cityjsonseq";
+  int output_threads = 4;
+  bool write_manifest = false;
+  std::string incremental_from;
   std::optional<roofer::arr3d> cj_scale;
   std::optional<roofer::arr3d> cj_translate;
   std::string building_toml_file_spec =
@@ -111,14 +127,21 @@ struct RooferConfig {
       "{path}/objects/{bid}/crop/{bid}_{pc_name}.tif";
   std::string building_jsonl_file_spec =
       "{path}/objects/{bid}/reconstruct/{bid}.city.jsonl";
+  std::string tile_gpkg_file_spec = "{path}/crop/tile_{tid:05d}.gpkg";
+  std::string tile_las_file_spec = "{path}/crop/tile_{tid:05d}_{pc_name}.las";
+  std::string tile_toml_file_spec = "{path}/crop/tile_{tid:05d}.toml";
   std::string jsonl_list_file_spec = "{path}/features.txt";
   std::string index_file_spec = "{path}/index.gpkg";
   std::string metadata_json_file_spec = "{path}/metadata.json";
+  std::string manifest_file_spec = "{path}/manifest.tsv";
+  std::string journal_file_spec = "{path}/journal.txt";
+  std::string failed_file_spec = "{path}/failed.tsv";
   std::string output_path;
 
   // reconstruct
   int lod11_fallback_planes = 900;
   int lod11_fallback_time = 1800000;
+  int lod11_fallback_total_time = 3600000;
   roofer::ReconstructionConfig rec;
 
   // output attribute names
@@ -193,26 +216,42 @@ struct fmt::formatter<RooferConfig> {
         ctx.out(),
         "RooferConfig(source_footprints={}, id_attribute={}, "
         "force_lod11_attribute={}, yoc_attribute={}, layer_name={}, "
-        "layer_id={}, attribute_filter={}, ceil_point_density={}, cellsize={}, "
+        "layer_id={}, attribute_filter={}, attributes_keep={}, "
+        "ceil_point_density={}, cellsize={}, "
         "lod11_fallback_area={}, lod11_fallback_density={}, tilesize={}, "
-        "clear_if_insufficient={}, write_crop_outputs={}, output_all={}, "
-        "write_rasters={}, write_index={}, region_of_interest={}, "
-        "srs_override={}, split_cjseq={}, building_toml_file_spec={}, "
-        "building_las_file_spec={}, building_gpkg_file_spec={}, "
-        "building_raster_file_spec={}, building_jsonl_file_spec={}, "
+        "align_tiles={}, adaptive_tiling={}, tile_max_buildings={}, "
+        "tile_max_points={}, clear_if_insufficient={}, crop_cache={}, "
+        "crop_threads={}, write_crop_outputs={}, "
+        "write_tiled_crop_outputs={}, output_all={}, write_rasters={}, "
+        "write_index={}, region_of_interest={}, srs_override={}, "
+        "split_cjseq={}, output_format={}, output_threads={}, "
+        "write_manifest={}, incremental_from={}, "
+        "building_toml_file_spec={}, building_las_file_spec={}, "
+        "building_gpkg_file_spec={}, building_raster_file_spec={}, "
+        "building_jsonl_file_spec={}, tile_gpkg_file_spec={}, "
+        "tile_las_file_spec={}, tile_toml_file_spec={}, "
         "jsonl_list_file_spec={}, index_file_spec={}, "
-        "metadata_json_file_spec={}, output_path={}, rec={})",
+        "metadata_json_file_spec={}, manifest_file_spec={}, "
+        "journal_file_spec={}, failed_file_spec={}, output_path={}, rec={})",
         cfg.source_footprints, cfg.id_attribute, cfg.force_lod11_attribute,
         cfg.yoc_attribute, cfg.layer_name, cfg.layer_id, cfg.attribute_filter,
+        cfg.attributes_keep,
         cfg.ceil_point_density, cfg.cellsize, cfg.lod11_fallback_area,
-        cfg.lod11_fallback_density, cfg.tilesize, cfg.clear_if_insufficient,
-        cfg.write_crop_outputs, cfg.output_all, cfg.write_rasters,
-        cfg.write_index, region_of_interest, cfg.srs_override, cfg.split_cjseq,
-        cfg.building_toml_file_spec, cfg.building_las_file_spec,
-        cfg.building_gpkg_file_spec, cfg.building_raster_file_spec,
-        cfg.building_jsonl_file_spec, cfg.jsonl_list_file_spec,
-        cfg.index_file_spec, cfg.metadata_json_file_spec, cfg.output_path,
-        cfg.rec);
+        cfg.lod11_fallback_density, cfg.tilesize, cfg.align_tiles,
+        cfg.adaptive_tiling, cfg.tile_max_buildings, cfg.tile_max_points,
+        cfg.clear_if_insufficient, cfg.crop_cache, cfg.crop_threads,
+        cfg.write_crop_outputs, cfg.write_tiled_crop_outputs,
+        cfg.output_all, cfg.write_rasters, cfg.write_index,
+        region_of_interest, cfg.srs_override, cfg.split_cjseq,
+        cfg.output_format, cfg.output_threads, cfg.write_manifest,
+        cfg.incremental_from, cfg.building_toml_file_spec,
+        cfg.building_las_file_spec, cfg.building_gpkg_file_spec,
+        cfg.building_raster_file_spec, cfg.building_jsonl_file_spec,
+        cfg.tile_gpkg_file_spec, cfg.tile_las_file_spec,
+        cfg.tile_toml_file_spec, cfg.jsonl_list_file_spec,
+        cfg.index_file_spec, cfg.metadata_json_file_spec,
+        cfg.manifest_file_spec, cfg.journal_file_spec, cfg.failed_file_spec,
+        cfg.output_path, cfg.rec);
   }
 };
 
@@ -463,6 +502,15 @@ class ConfigParameterByReference : public ConfigParameter {
       _value = *it;
       return args.erase(it);
       ;
+    } else if constexpr (std::is_same_v<T, std::vector<std::string>>) {
+      // comma separated
+      _value.clear();
+      std::istringstream values(*it);
+      std::string value;
+      while (std::getline(values, value, ',')) {
+        if (!value.empty()) _value.push_back(value);
+      }
+      return args.erase(it);
     } else if constexpr (std::is_same_v<T,
                                         std::optional<roofer::TBox<double>>>) {
       roofer::TBox<double> box;
@@ -556,6 +604,17 @@ class ConfigParameterByReference : public ConfigParameter {
                                    " from config file.");
         }
       }
+    } else if constexpr (std::is_same_v<T, std::vector<std::string>>) {
+      if (const toml::array* a = table[name].as_array()) {
+        if (!a->empty() && !a->is_homogeneous(toml::node_type::string)) {
+          throw std::runtime_error("Failed to read value for " + name +
+                                   " from config file.");
+        }
+        _value.clear();
+        for (auto& value : *a) {
+          _value.push_back(*value.value<std::string>());
+        }
+      }
     } else {
       if (auto value = table[name].value<T>(); value.has_value()) {
         _value = *value;
@@ -574,6 +633,8 @@ class ConfigParameterByReference : public ConfigParameter {
       return "<double>";
     } else if constexpr (std::is_same_v<T, std::string>) {
       return "<str>";
+    } else if constexpr (std::is_same_v<T, std::vector<std::string>>) {
+      return "<str,...>";
     } else if constexpr (std::is_same_v<T,
                                         std::optional<roofer::TBox<double>>>) {
       return "<xmin ymin xmax ymax>";
@@ -613,6 +674,12 @@ struct RooferConfigHandler {
   bool _print_version = false;
   bool _crop_only = false;
   bool _no_tiling = false;
+  bool _resume = false;
+  // this process handles shard _shard_index of _shard_count, 0 if not sharded
+  size_t _shard_index = 0;
+  size_t _shard_count = 0;
+  // number of shards to merge
+  size_t _merge_shards = 0;
   bool _skip_pc_check = false;
   std::string _loglevel = "info";
   size_t _trace_interval = 10;
@@ -641,6 +708,10 @@ struct RooferConfigHandler {
         "Specify WHERE clause in OGR SQL to select specfic features from "
         "<polygon-source>",
         _cfg.attribute_filter, {});
+    add("attributes-keep",
+        "Only read these attributes from <polygon-source>, besides the id, "
+        "force LoD1.1 and year of construction attributes [default: all]",
+        _cfg.attributes_keep, {});
     add("ceil-point-density",
         "Enfore this point density ceiling on each building pointcloud.",
         _cfg.ceil_point_density, {roofer::v::HigherThan<float>(0)});
@@ -651,10 +722,34 @@ struct RooferConfigHandler {
     add("reconstruct-insufficient",
         "reconstruct buildings with insufficient pointcloud data",
         _cfg.clear_if_insufficient, {});
+    add("crop-cache",
+        "Directory in which cropped tiles are cached and reused by later runs "
+        "with the same inputs and crop parameters",
+        _cfg.crop_cache, {});
+    add("crop-threads",
+        "Number of threads that decompress a LAZ file without a spatial index "
+        "while cropping [default: 4]",
+        _cfg.crop_threads, {roofer::v::HigherThan<int>(0)});
     // add("lod11-fallback-density", "lod11 fallback density",
     // _cfg.lod11_fallback_density, {roofer::v::HigherThan<float>(0)}});
     add("tilesize", "Tilesize used for output tiles", _cfg.tilesize,
         {roofer::v::HigherThan<roofer::arr2f>({0, 0})});
+    add("align-tiles",
+        "Align the tiles to the grid of the pointcloud files, so that with a "
+        "tilesize equal to the file size the tile and file boundaries "
+        "coincide",
+        _cfg.align_tiles, {});
+    add("adaptive-tiling",
+        "Split the region of interest in tiles of varying size, with at most "
+        "tile-max-buildings footprints and tile-max-points points per tile "
+        "where possible. Tilesize is the largest tile size.",
+        _cfg.adaptive_tiling, {});
+    add("tile-max-buildings",
+        "Target maximum number of footprints per tile with adaptive tiling",
+        _cfg.tile_max_buildings, {roofer::v::HigherThan<int>(0)});
+    add("tile-max-points",
+        "Target maximum number of points per tile with adaptive tiling",
+        _cfg.tile_max_points, {roofer::v::HigherThan<int>(0)});
     add("box",
         "Region of interest. Data outside of this region will be ignored",
         _cfg.region_of_interest,
@@ -685,6 +780,24 @@ struct RooferConfigHandler {
         _cfg.split_cjseq, {});
     add("omit-metadata", "Omit metadata in CityJSON output", _cfg.omit_metadata,
         {});
+    add("output-format",
+        "Output format, possible values: cityjsonseq, cjb (binary CityJSON) "
+        "[default: cityjsonseq]",
+        _cfg.output_format,
+        {roofer::v::OneOf<std::string>({"cityjsonseq", "cjb"})});
+    add("output-threads",
+        "Number of threads that write the per-building output files "
+        "[default: 4]",
+        _cfg.output_threads, {roofer::v::HigherThan<int>(0)});
+    add("manifest",
+        "Write a manifest with a content hash and the location of every "
+        "output feature, for use with --incremental-from",
+        _cfg.write_manifest, {});
+    add("incremental-from",
+        "Output directory of a previous run that was written with a manifest. "
+        "Buildings whose inputs did not change are copied from it instead of "
+        "reconstructed. Implies --manifest",
+        _cfg.incremental_from, {});
     add("cj-scale", "Scaling applied to CityJSON output vertices",
         _cfg.cj_scale, {});
     add("cj-translate", "Translation applied to CityJSON output vertices",
@@ -696,6 +809,10 @@ struct RooferConfigHandler {
         "Fallback to LoD11 if time spent on detecting planes exceeds this "
         "value. In milliseconds.",
         _cfg.lod11_fallback_time, {roofer::v::HigherThan<int>(0)});
+    add("lod11-fallback-total-time",
+        "Fallback to LoD11 if the reconstruction of a building takes longer "
+        "than this value in total. In milliseconds.",
+        _cfg.lod11_fallback_total_time, {roofer::v::HigherThan<int>(0)});
     addr("plane-detect-k", "plane detect k", _cfg.rec.plane_detect_k,
          {roofer::v::HigherThan<int>(0)});
     addr("plane-detect-min-points", "plane detect min points",
@@ -751,6 +868,23 @@ struct RooferConfigHandler {
       throw std::runtime_error(
           fmt::format("Can't write to output directory: {}", *error_msg));
     }
+    if (!_cfg.incremental_from.empty()) {
+      _cfg.write_manifest = true;
+      std::error_code ec;
+      if (fs::equivalent(_cfg.incremental_from, _cfg.output_path, ec)) {
+        throw std::runtime_error(
+            "The output directory of an incremental run must differ from the "
+            "previous output directory.");
+      }
+    }
+    if (_cfg.write_manifest && _cfg.id_attribute.empty()) {
+      throw std::runtime_error(
+          "A manifest and incremental runs need an id-attribute to identify "
+          "the buildings.");
+    }
+    if (_shard_count != 0 && _merge_shards != 0) {
+      throw std::runtime_error("--shard and --merge can not be combined.");
+    }
   }
 
   template <typename T, typename node>
@@ -807,8 +941,18 @@ struct RooferConfigHandler {
     // std::cout << "   --crop-only                  Only crop pointclouds. Skip
     // reconstruction.\n";
     std::cout << "   --no-tiling                  Do not use tiling.\n";
+    std::cout << "   --resume                     Skip the tiles that an "
+                 "interrupted run with the same configuration finished.\n";
+    std::cout << "   --shard <i/N>                Process shard i of N, "
+                 "0 <= i < N, together with other roofer processes that "
+                 "write to the same output directory.\n";
+    std::cout << "   --merge <N>                  Merge the outputs of N "
+                 "shards.\n";
     std::cout << "   --crop-output                Output cropped building "
                  "pointclouds.\n";
+    std::cout << "   --crop-output-tiled          Output the cropped "
+                 "pointclouds packed per tile, with a tile index. Implies "
+                 "--crop-output.\n";
     std::cout << "   --crop-output-all            Output files for each "
                  "candidate pointcloud instead of only the optimal candidate. "
                  "Implies --crop-output.\n";
@@ -905,6 +1049,38 @@ struct RooferConfigHandler {
       } else if (arg == "--no-tiling") {
         _no_tiling = true;
         it = c.args.erase(it);
+      } else if (arg == "--resume") {
+        _resume = true;
+        it = c.args.erase(it);
+      } else if (arg == "--shard") {
+        auto next_it = std::next(it);
+        if (next_it != c.args.end() && !next_it->starts_with("-")) {
+          auto slash = next_it->find('/');
+          if (slash == std::string::npos) {
+            throw std::runtime_error("Invalid argument for --shard, use i/N.");
+          }
+          _shard_index = std::stoul(next_it->substr(0, slash));
+          _shard_count = std::stoul(next_it->substr(slash + 1));
+          if (_shard_index >= _shard_count) {
+            throw std::runtime_error(
+                "Invalid argument for --shard, i must be less than N.");
+          }
+          // Erase the option and its argument
+          it = c.args.erase(it);
+          it = c.args.erase(it);
+        } else {
+          throw std::runtime_error("Missing argument for --shard.");
+        }
+      } else if (arg == "--merge") {
+        auto next_it = std::next(it);
+        if (next_it != c.args.end() && !next_it->starts_with("-")) {
+          _merge_shards = std::stoul(*next_it);
+          // Erase the option and its argument
+          it = c.args.erase(it);
+          it = c.args.erase(it);
+        } else {
+          throw std::runtime_error("Missing argument for --merge.");
+        }
       } else if (arg == "--skip-pc-check") {
         _skip_pc_check = true;
         it = c.args.erase(it);
@@ -915,6 +1091,10 @@ struct RooferConfigHandler {
       } else if (arg == "--crop-output") {
         _cfg.write_crop_outputs = true;
         it = c.args.erase(it);
+      } else if (arg == "--crop-output-tiled") {
+        _cfg.write_crop_outputs = true;
+        _cfg.write_tiled_crop_outputs = true;
+        it = c.args.erase(it);
       } else if (arg == "--crop-output-all") {
         _cfg.write_crop_outputs = true;
         _cfg.output_all = true;
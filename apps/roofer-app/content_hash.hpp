@@ -0,0 +1,79 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+/**
+ * @brief 64 bit FNV-1a hash of a sequence of values
+ *
+ * Unlike std::hash the result does not depend on the run or the build, so it
+ * can be stored on disk and compared with the hash computed in a later run.
+ * Sizes are hashed along with strings and vectors, so that e.g. ("ab", "c")
+ * and ("a", "bc") give different hashes.
+ */
+class ContentHash {
+  uint64_t h_ = 0xcbf29ce484222325ull;
+
+ public:
+  ContentHash& add_bytes(const void* data, size_t size) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      h_ ^= bytes[i];
+      h_ *= 0x100000001b3ull;
+    }
+    return *this;
+  }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  ContentHash& add(const T& value) {
+    return add_bytes(&value, sizeof(T));
+  }
+  ContentHash& add(std::string_view value) {
+    add(uint64_t(value.size()));
+    return add_bytes(value.data(), value.size());
+  }
+  ContentHash& add(const char* value) { return add(std::string_view(value)); }
+  template <typename T>
+  ContentHash& add(const std::optional<T>& value) {
+    add(value.has_value());
+    if (value) add(*value);
+    return *this;
+  }
+  template <typename T>
+  ContentHash& add(const std::vector<T>& values) {
+    add(uint64_t(values.size()));
+    for (const auto& value : values) add(value);
+    return *this;
+  }
+
+  // Size and modification time of a file, or a marker if it does not exist
+  ContentHash& add_file_stat(const fs::path& path) {
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec) return add(false);
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) return add(false);
+    add(true).add(uint64_t(size));
+    return add(int64_t(mtime.time_since_epoch().count()));
+  }
+
+  uint64_t value() const { return h_; }
+  std::string hex() const { return fmt::format("{:016x}", h_); }
+};
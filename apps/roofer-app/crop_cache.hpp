@@ -0,0 +1,426 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+/**
+ * @brief On-disk cache of cropped tiles
+ *
+ * Cropping reads and decodes every pointcloud file below a tile, which
+ * dominates the runtime when the same area is reconstructed again and again
+ * with different reconstruction parameters. With crop_cache set, the result
+ * of crop_tile is stored in one file per tile: the thinned building and
+ * ground points of the selected pointcloud, the crop results of each
+ * building and the attribute columns that the crop adds.
+ *
+ * The file name is a hash of everything the crop depends on: the roofer
+ * version, the tile, the footprints and the attributes that the crop uses, the
+ * pointcloud files with their sizes and modification times and the crop
+ * parameters. A later run with
+ * the same inputs finds the file and skips the pointcloud I/O altogether, a
+ * change in any of the inputs gives another name, so that a stale file is
+ * never read.
+ *
+ * The file is memory mapped and the arrays are copied straight out of it.
+ * It is written and read on the same machine, so values are stored in the
+ * native byte order.
+ *
+ * file     := header, column*, building*
+ * header   := magic, uint32 version, uint64 buildings, uint64 columns
+ * column   := string name, uint32 type, uint64 size, (uint8 valid, value)*
+ * building := float z_offset, h_ground, h_roof_70p_rough,
+ *             uint8 force_lod11, pointcloud_insufficient, is_glass_roof,
+ *             int32 extrusion_mode, string jsonl_path,
+ *             array footprint, uint64 interior rings, array interior ring*,
+ *             array pointcloud_ground, array pointcloud_building
+ * string   := uint64 size, char*
+ * array    := uint64 size, arr3f*
+ */
+
+#include <random>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace crop_cache {
+
+  inline constexpr std::array<char, 8> magic = {'R', 'F', 'C', 'R',
+                                                'O', 'P', '\0', '\0'};
+  inline constexpr uint32_t version = 1;
+
+  enum class ColumnType : uint32_t { Bool = 0, Int = 1, Float = 2, String = 3 };
+
+  // Names of the attribute columns that crop_tile adds to the footprint
+  // attributes
+  inline std::vector<std::string> crop_attribute_names(
+      const RooferConfig& cfg,
+      const std::vector<InputPointcloud>& input_pointclouds) {
+    std::vector<std::string> names = {cfg.n.at("force_lod11")};
+    for (auto& ipc : input_pointclouds) {
+      names.push_back(cfg.n.at("nodata_r") + "_" + ipc.name);
+      names.push_back(cfg.n.at("nodata_frac") + "_" + ipc.name);
+      names.push_back(cfg.n.at("pt_density") + "_" + ipc.name);
+    }
+    for (size_t i = 0; i + 1 < input_pointclouds.size(); ++i) {
+      names.push_back(cfg.n.at("is_mutated") + "_" + input_pointclouds[i].name +
+                      "_" + input_pointclouds[i + 1].name);
+    }
+    names.push_back(cfg.n.at("pc_select"));
+    names.push_back(cfg.n.at("pc_source"));
+    names.push_back(cfg.n.at("pc_year"));
+    return names;
+  }
+
+  // Name of the cache file for a tile, lasfiles are the pointcloud files that
+  // intersect the tile for each of the input pointclouds
+  inline std::string key(
+      const roofer::TBox<double>& tile, const roofer::arr3d& data_offset,
+      const std::vector<roofer::LinearRing>& footprints,
+      const roofer::AttributeVecMap& attributes,
+      const std::vector<InputPointcloud>& input_pointclouds,
+      const std::vector<std::vector<std::string>>& lasfiles,
+      const RooferConfig& cfg,
+      const roofer::io::SpatialReferenceSystemInterface* srs) {
+    ContentHash h;
+    h.add(version);
+    // a change to the cropping code gives other crops for the same inputs
+    h.add(git_Describe());
+    h.add(tile.pmin).add(tile.pmax).add(data_offset);
+    h.add(srs->is_valid() ? srs->export_wkt() : "");
+
+    h.add(uint64_t(footprints.size()));
+    for (auto& footprint : footprints) {
+      h.add(static_cast<const roofer::vec3f&>(footprint));
+      h.add(footprint.interior_rings());
+    }
+    // only the attributes that are used by the crop
+    h.add(cfg.id_attribute);
+    if (auto bid_vec = attributes.get_if<std::string>(cfg.id_attribute)) {
+      h.add(*bid_vec);
+    }
+    h.add(cfg.yoc_attribute);
+    if (auto yoc_vec = attributes.get_if<int>(cfg.yoc_attribute)) {
+      h.add(*yoc_vec);
+    }
+    h.add(cfg.force_lod11_attribute);
+    if (auto force_lod11_vec =
+            attributes.get_if<bool>(cfg.force_lod11_attribute)) {
+      h.add(*force_lod11_vec);
+    }
+
+    h.add(cfg.ceil_point_density).add(cfg.cellsize);
+    h.add(cfg.lod11_fallback_area).add(cfg.lod11_fallback_density);
+    h.add(cfg.clear_if_insufficient);
+    h.add(cfg.output_path).add(cfg.building_jsonl_file_spec);
+    for (auto& name : crop_attribute_names(cfg, input_pointclouds)) {
+      h.add(name);
+    }
+
+    for (size_t j = 0; j < input_pointclouds.size(); ++j) {
+      auto& ipc = input_pointclouds[j];
+      h.add(ipc.name).add(ipc.quality).add(ipc.date);
+      h.add(ipc.bld_class).add(ipc.grnd_class);
+      h.add(ipc.force_lod11).add(ipc.select_only_for_date);
+      auto files = lasfiles[j];
+      std::sort(files.begin(), files.end());
+      h.add(uint64_t(files.size()));
+      for (auto& file : files) {
+        h.add(file).add_file_stat(file);
+      }
+    }
+    return h.hex();
+  }
+
+  class Encoder {
+    std::string& out_;
+
+   public:
+    explicit Encoder(std::string& out) : out_(out) {}
+
+    template <typename T>
+      requires std::is_trivially_copyable_v<T>
+    void put(const T& value) {
+      out_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void put(std::string_view value) {
+      put(uint64_t(value.size()));
+      out_.append(value);
+    }
+    void put(const roofer::vec3f& values) {
+      put(uint64_t(values.size()));
+      out_.append(reinterpret_cast<const char*>(values.data()),
+                  values.size() * sizeof(roofer::arr3f));
+    }
+    template <typename T>
+    void put(const std::vector<std::optional<T>>& column) {
+      put(uint64_t(column.size()));
+      for (auto& value : column) {
+        put(uint8_t(value.has_value()));
+        if (value) put(*value);
+      }
+    }
+  };
+
+  class Decoder {
+    const std::byte* data_;
+    size_t size_;
+    size_t pos_ = 0;
+
+    void check(size_t size) const {
+      if (size > size_ - pos_) {
+        throw std::runtime_error("Truncated crop cache file");
+      }
+    }
+
+   public:
+    Decoder(const std::byte* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+      requires std::is_trivially_copyable_v<T>
+    T get() {
+      check(sizeof(T));
+      T value;
+      std::memcpy(&value, data_ + pos_, sizeof(T));
+      pos_ += sizeof(T);
+      return value;
+    }
+    std::string get_string() {
+      auto size = get<uint64_t>();
+      check(size);
+      std::string value(reinterpret_cast<const char*>(data_ + pos_), size);
+      pos_ += size;
+      return value;
+    }
+    void get(roofer::vec3f& values) {
+      auto size = get<uint64_t>();
+      if (size > (size_ - pos_) / sizeof(roofer::arr3f)) {
+        throw std::runtime_error("Truncated crop cache file");
+      }
+      values.resize(size);
+      std::memcpy(values.data(), data_ + pos_, size * sizeof(roofer::arr3f));
+      pos_ += size * sizeof(roofer::arr3f);
+    }
+    template <typename T>
+    void get(std::vector<std::optional<T>>& column) {
+      auto size = get<uint64_t>();
+      // at least one byte per value
+      check(size);
+      column.reserve(size);
+      for (size_t i = 0; i < size; ++i) {
+        if (!get<uint8_t>()) {
+          column.emplace_back();
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          column.emplace_back(get_string());
+        } else {
+          column.emplace_back(get<T>());
+        }
+      }
+    }
+  };
+
+  // Encodes the buildings of a cropped tile and the attribute columns
+  // that were added by the crop
+  inline std::string encode(const BuildingTile& tile,
+                            const roofer::AttributeVecMap& attributes,
+                            const std::vector<std::string>& columns) {
+    std::string out;
+    Encoder enc(out);
+    enc.put(magic);
+    enc.put(version);
+    enc.put(uint64_t(tile.buildings.size()));
+    enc.put(uint64_t(columns.size()));
+
+    for (auto& name : columns) {
+      enc.put(std::string_view(name));
+      if (auto vec = attributes.get_if<bool>(name)) {
+        enc.put(ColumnType::Bool);
+        enc.put(*vec);
+      } else if (auto vec = attributes.get_if<int>(name)) {
+        enc.put(ColumnType::Int);
+        enc.put(*vec);
+      } else if (auto vec = attributes.get_if<float>(name)) {
+        enc.put(ColumnType::Float);
+        enc.put(*vec);
+      } else if (auto vec = attributes.get_if<std::string>(name)) {
+        enc.put(ColumnType::String);
+        enc.put(*vec);
+      } else {
+        throw std::runtime_error("Unsupported crop attribute " + name);
+      }
+    }
+
+    for (auto& building : tile.buildings) {
+      enc.put(building.z_offset);
+      enc.put(building.h_ground);
+      enc.put(building.h_roof_70p_rough);
+      enc.put(uint8_t(building.force_lod11));
+      enc.put(uint8_t(building.pointcloud_insufficient));
+      enc.put(uint8_t(building.is_glass_roof));
+      enc.put(int32_t(building.extrusion_mode));
+      enc.put(std::string_view(building.jsonl_path.string()));
+      enc.put(building.footprint);
+      enc.put(uint64_t(building.footprint.interior_rings().size()));
+      for (auto& ring : building.footprint.interior_rings()) {
+        enc.put(ring);
+      }
+      enc.put(building.pointcloud_ground);
+      enc.put(building.pointcloud_building);
+    }
+    return out;
+  }
+
+  // Reads the cache file of a tile with n_buildings footprints into tile and
+  // attributes. Returns false if there is no file or it was written for
+  // another number of buildings or another file version. Throws if the file
+  // is truncated or damaged; tile and attributes are left as they were.
+  inline bool read(const fs::path& path, size_t n_buildings,
+                   BuildingTile& tile, roofer::AttributeVecMap& attributes) {
+    const std::byte* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    std::string buffer;
+    {
+      std::ifstream ifs(path, std::ios::binary);
+      if (!ifs) return false;
+      buffer.assign(std::istreambuf_iterator<char>(ifs), {});
+    }
+    data = reinterpret_cast<const std::byte*>(buffer.data());
+    size = buffer.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      size = st.st_size;
+      map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+    std::unique_ptr<void, std::function<void(void*)>> unmap(
+        map, [size](void* p) { ::munmap(p, size); });
+    data = static_cast<const std::byte*>(map);
+#endif
+
+    Decoder dec(data, size);
+    if (dec.get<std::array<char, 8>>() != magic ||
+        dec.get<uint32_t>() != version ||
+        dec.get<uint64_t>() != n_buildings) {
+      return false;
+    }
+
+    // decode everything before touching tile and attributes, so that a
+    // damaged file leaves them as they were
+    roofer::AttributeVecMap columns;
+    auto n_columns = dec.get<uint64_t>();
+    for (size_t c = 0; c < n_columns; ++c) {
+      auto name = dec.get_string();
+      auto type = dec.get<ColumnType>();
+      if (type == ColumnType::Bool) {
+        dec.get(columns.insert_vec<bool>(name));
+      } else if (type == ColumnType::Int) {
+        dec.get(columns.insert_vec<int>(name));
+      } else if (type == ColumnType::Float) {
+        dec.get(columns.insert_vec<float>(name));
+      } else if (type == ColumnType::String) {
+        dec.get(columns.insert_vec<std::string>(name));
+      } else {
+        throw std::runtime_error("Unknown column type in crop cache file");
+      }
+    }
+
+    std::vector<BuildingObject> buildings(n_buildings);
+    for (size_t i = 0; i < n_buildings; ++i) {
+      auto& building = buildings[i];
+      building.attribute_index = i;
+      building.z_offset = dec.get<float>();
+      building.h_ground = dec.get<float>();
+      building.h_roof_70p_rough = dec.get<float>();
+      building.force_lod11 = dec.get<uint8_t>();
+      building.pointcloud_insufficient = dec.get<uint8_t>();
+      building.is_glass_roof = dec.get<uint8_t>();
+      building.extrusion_mode = ExtrusionMode(dec.get<int32_t>());
+      building.jsonl_path = dec.get_string();
+      dec.get(building.footprint);
+      building.footprint.interior_rings().resize(dec.get<uint64_t>());
+      for (auto& ring : building.footprint.interior_rings()) {
+        dec.get(ring);
+      }
+      dec.get(building.pointcloud_ground);
+      dec.get(building.pointcloud_building);
+    }
+
+    for (auto& [name, column] : columns.get_attributes()) {
+      attributes.get_attributes()[name] = std::move(column);
+    }
+    tile.buildings = std::move(buildings);
+    return true;
+  }
+
+  // Name of the file that path is written to before it is renamed. Runs that
+  // share a cache directory can write the same tile at the same time, so each
+  // writer gets its own name from the process id, the thread and a random
+  // number.
+  inline fs::path temp_path(const fs::path& path) {
+    thread_local std::mt19937_64 rng(
+        std::random_device{}() ^
+        std::hash<std::thread::id>{}(std::this_thread::get_id()));
+#if defined(_WIN32)
+    auto pid = _getpid();
+#else
+    auto pid = ::getpid();
+#endif
+    auto tmp_path = path;
+    tmp_path += fmt::format(".{}.{:016x}.tmp", pid, rng());
+    return tmp_path;
+  }
+
+  // Writes the cache file on the output threads, the file only appears under
+  // its final name once it is complete. Returns the future of the write.
+  inline std::future<void> write(OutputWriter& output_writer,
+                                 const fs::path& path, std::string content) {
+    return output_writer.submit([&output_writer, path,
+                          content = std::move(content)] {
+      output_writer.create_directories(path.parent_path());
+      auto tmp_path = temp_path(path);
+      try {
+        {
+          std::ofstream ofs(tmp_path, std::ios::binary);
+          ofs.write(content.data(), content.size());
+          ofs.close();
+          if (!ofs) {
+            throw std::runtime_error("Failed to write " + tmp_path.string());
+          }
+        }
+        fs::rename(tmp_path, path);
+      } catch (...) {
+        std::error_code ec;
+        fs::remove(tmp_path, ec);
+        throw;
+      }
+    });
+  }
+
+}  // namespace crop_cache
@@ -22,30 +22,36 @@
 bool crop_tile(const roofer::TBox<double>& tile,
                std::vector<InputPointcloud>& input_pointclouds,
                BuildingTile& output_building_tile, const RooferConfig& cfg,
-               const roofer::io::SpatialReferenceSystemInterface* srs) {
+               const roofer::io::SpatialReferenceSystemInterface* srs,
+               OutputWriter& output_writer,
+               const incremental::Manifest* previous_manifest) {
   auto& logger = roofer::logger::Logger::get_logger();
 
   auto& pj = output_building_tile.proj_helper;
   auto vector_reader = roofer::io::createVectorReaderOGR(*pj);
   auto vector_writer = roofer::io::createVectorWriterOGR(*pj);
   auto PointCloudCropper = roofer::io::createPointCloudCropper(*pj);
-  auto RasterWriter = roofer::io::createRasterWriterGDAL(*pj);
   auto vector_ops = roofer::misc::createVector2DOpsGEOS();
-  auto LASWriter = roofer::io::createLASWriter(*pj);
 
   // logger.info("region_of_interest.has_value()? {}",
   // region_of_interest.has_value()); if(region_of_interest.has_value())
   vector_reader->layer_name = cfg.layer_name;
   vector_reader->layer_id = cfg.layer_id;
   vector_reader->attribute_filter = cfg.attribute_filter;
+  if (!cfg.attributes_keep.empty()) {
+    vector_reader->attributes_keep = cfg.attributes_keep;
+    for (auto* name : {&cfg.id_attribute, &cfg.force_lod11_attribute,
+                       &cfg.yoc_attribute}) {
+      if (!name->empty()) vector_reader->attributes_keep.push_back(*name);
+    }
+  }
   vector_reader->open(cfg.source_footprints);
   vector_reader->region_of_interest = tile;
   std::vector<roofer::LinearRing> footprints;
   roofer::AttributeVecMap attributes;
   vector_reader->readPolygons(footprints, &attributes);
 
-  const unsigned N_fp = footprints.size();
-  if (N_fp == 0) {
+  if (footprints.empty()) {
     return false;
   }
 
@@ -54,6 +60,74 @@ bool crop_tile(const roofer::TBox<double>& tile,
     return false;
   }
 
+  // With a manifest every building gets a content hash. In an incremental run
+  // the buildings with the same hash as in the previous run are set aside
+  // here, they are copied from the previous output instead of cropped and
+  // reconstructed.
+  std::vector<uint64_t> content_hashes;
+  std::vector<BuildingObject> unchanged_buildings;
+  if (cfg.write_manifest) {
+    content_hashes = incremental::building_hashes(
+        incremental::config_hash(cfg, input_pointclouds),
+        cfg.cj_translate.value_or(*pj->data_offset), footprints, attributes,
+        input_pointclouds, *pj);
+    auto bid_vec = attributes.get_if<std::string>(cfg.id_attribute);
+    if (previous_manifest && bid_vec) {
+      std::vector<size_t> changed;
+      for (size_t i = 0; i < footprints.size(); ++i) {
+        auto& bid = (*bid_vec)[i];
+        auto entry = bid ? previous_manifest->find(*bid) : nullptr;
+        if (entry && entry->hash == content_hashes[i]) {
+          auto& building = unchanged_buildings.emplace_back();
+          building.bid = *bid;
+          building.content_hash = content_hashes[i];
+          building.previous_feature = entry->feature;
+          building.jsonl_path =
+              fs::path(cfg.output_path) / entry->feature.file;
+        } else {
+          changed.push_back(i);
+        }
+      }
+      if (!unchanged_buildings.empty()) {
+        logger.info("{} of {} buildings did not change since the previous run",
+                    unchanged_buildings.size(), footprints.size());
+        std::vector<roofer::LinearRing> changed_footprints;
+        std::vector<uint64_t> changed_hashes;
+        changed_footprints.reserve(changed.size());
+        changed_hashes.reserve(changed.size());
+        for (auto i : changed) {
+          changed_footprints.push_back(std::move(footprints[i]));
+          changed_hashes.push_back(content_hashes[i]);
+        }
+        footprints = std::move(changed_footprints);
+        content_hashes = std::move(changed_hashes);
+        incremental::select_rows(attributes, changed);
+      }
+    }
+  }
+  // The cropped buildings get their id and hash, and the buildings that were
+  // set aside go after them
+  auto add_unchanged_buildings = [&]() {
+    if (!content_hashes.empty()) {
+      auto bid_vec =
+          output_building_tile.attributes.get_if<std::string>(cfg.id_attribute);
+      for (auto& building : output_building_tile.buildings) {
+        auto i = building.attribute_index;
+        building.content_hash = content_hashes[i];
+        building.bid = bid_vec ? (*bid_vec)[i].value_or("") : "";
+      }
+    }
+    for (auto& building : unchanged_buildings) {
+      building.attribute_index = output_building_tile.buildings.size();
+      output_building_tile.buildings.push_back(std::move(building));
+    }
+  };
+  if (footprints.empty()) {
+    add_unchanged_buildings();
+    return true;
+  }
+  const unsigned N_fp = footprints.size();
+
   // get yoc attribute vector (nullptr if it does not exist)
   auto yoc_vec = attributes.get_if<int>(cfg.yoc_attribute);
   if (!cfg.yoc_attribute.empty() && !yoc_vec) {
@@ -80,26 +154,57 @@ bool crop_tile(const roofer::TBox<double>& tile,
   polygon_extent_untransformed.add(pj->coord_transform_rev(
       polygon_extent.pmax[0], polygon_extent.pmax[1], polygon_extent.pmax[2]));
 
-  // Crop all pointclouds
+  // find the pointcloud files that intersect the footprints
+  std::vector<std::vector<std::string>> ipc_lasfiles;
   for (auto& ipc : input_pointclouds) {
-    logger.info("Cropping pointcloud {}...", ipc.name);
-
     auto intersecting_files = ipc.rtree->query(polygon_extent_untransformed);
 
-    std::vector<std::string> lasfiles;
+    auto& lasfiles = ipc_lasfiles.emplace_back();
     for (auto* file_extent_ : intersecting_files) {
       auto* file_extent = static_cast<fileExtent*>(file_extent_);
       lasfiles.push_back(file_extent->first);
     }
+  }
+
+  // The crop outputs and the index need the rasters, these are not cached
+  fs::path crop_cache_path;
+  if (!cfg.crop_cache.empty()) {
+    crop_cache_path =
+        fs::path(cfg.crop_cache) /
+        (crop_cache::key(tile, *pj->data_offset, footprints, attributes,
+                         input_pointclouds, ipc_lasfiles, cfg, srs) +
+         ".rfcrop");
+    if (!cfg.write_crop_outputs && !cfg.write_index) {
+      try {
+        if (crop_cache::read(crop_cache_path, N_fp, output_building_tile,
+                             attributes)) {
+          logger.info("Read {} cropped buildings from crop cache {}", N_fp,
+                      crop_cache_path.string());
+          output_building_tile.attributes = std::move(attributes);
+          add_unchanged_buildings();
+          return true;
+        }
+      } catch (const std::exception& e) {
+        logger.warning("Ignoring crop cache {}. {}", crop_cache_path.string(),
+                       e.what());
+      }
+    }
+  }
+
+  // Crop all pointclouds
+  for (size_t j = 0; j < input_pointclouds.size(); ++j) {
+    auto& ipc = input_pointclouds[j];
+    logger.info("Cropping pointcloud {}...", ipc.name);
 
     PointCloudCropper->process(
-        lasfiles, footprints, buffered_footprints, ipc.building_clouds,
+        ipc_lasfiles[j], footprints, buffered_footprints, ipc.building_clouds,
         ipc.ground_elevations, ipc.acquisition_years,
         ipc.pointcloud_insufficient, polygon_extent,
         {.ground_class = ipc.grnd_class,
          .building_class = ipc.bld_class,
          .clear_if_insufficient = cfg.clear_if_insufficient,
-         .use_acquisition_year = static_cast<bool>(yoc_vec)});
+         .use_acquisition_year = static_cast<bool>(yoc_vec),
+         .decode_threads = cfg.crop_threads});
     if (ipc.date != 0) {
       logger.info("Overriding acquisition year from config file");
       std::fill(ipc.acquisition_years.begin(), ipc.acquisition_years.end(),
@@ -238,6 +343,32 @@ bool crop_tile(const roofer::TBox<double>& tile,
   std::unordered_map<std::string, roofer::vec1s> jsonl_paths;
   std::string bid;
   bool only_write_selected = !cfg.output_all;
+  // The crop outputs are written on the I/O threads once all buildings are
+  // selected, because the selection still adds to attributes. Every write
+  // gets its own writer and spatial reference system, these are not thread
+  // safe.
+  std::vector<std::function<void()>> crop_writes;
+  // all writes of the tile, these are waited for before returning
+  std::vector<std::future<void>> pending_writes;
+  std::string srs_wkt = srs->is_valid() ? srs->export_wkt() : "";
+  auto copy_srs = [&srs_wkt]() {
+    auto srs_copy = roofer::io::createSpatialReferenceSystemOGR();
+    if (!srs_wkt.empty()) srs_copy->import_wkt(srs_wkt);
+    return srs_copy;
+  };
+  // With tiled crop output the buildings are packed per tile: one pointcloud
+  // per input pointcloud with the buildings one after the other, and the
+  // range of each building recorded in the tile index.
+  struct TilePack {
+    roofer::PointCollection points;
+    toml::array first;
+    toml::array count;
+    toml::array ground_elevation;
+  };
+  std::vector<TilePack> tile_packs(
+      cfg.write_tiled_crop_outputs ? input_pointclouds.size() : 0);
+  toml::array tile_bids;
+  toml::array tile_selected;
   for (unsigned i = 0; i < N_fp; ++i) {
     if (bid_vec) {
       bid = (*bid_vec)[i].value();
@@ -363,111 +494,216 @@ bool crop_tile(const roofer::TBox<double>& tile,
           fmt::arg("path", cfg.output_path));
     }
 
-    if (cfg.write_crop_outputs) {
-      {
-        // fs::create_directories(fs::path(fname).parent_path());
-        std::string fp_path = fmt::format(
-            fmt::runtime(cfg.building_gpkg_file_spec), fmt::arg("bid", bid),
-            fmt::arg("path", cfg.output_path));
-        vector_writer->writePolygons(fp_path, srs, footprints, attributes, i,
-                                     i + 1);
-
-        size_t j = 0;
-        for (auto& ipc : input_pointclouds) {
-          if ((selected->index != j) && (only_write_selected)) {
-            ++j;
-            continue;
-          };
-
-          std::string pc_path = fmt::format(
-              fmt::runtime(cfg.building_las_file_spec), fmt::arg("bid", bid),
-              fmt::arg("pc_name", ipc.name), fmt::arg("path", cfg.output_path));
-          std::string raster_path = fmt::format(
-              fmt::runtime(cfg.building_raster_file_spec), fmt::arg("bid", bid),
-              fmt::arg("pc_name", ipc.name), fmt::arg("path", cfg.output_path));
-          std::string jsonl_path = fmt::format(
-              fmt::runtime(cfg.building_jsonl_file_spec), fmt::arg("bid", bid),
-              fmt::arg("pc_name", ipc.name), fmt::arg("path", cfg.output_path));
-
-          if (cfg.write_rasters) {
-            RasterWriter->writeBands(raster_path, ipc.building_rasters[i]);
+    if (cfg.write_tiled_crop_outputs) {
+      tile_bids.push_back(bid);
+      tile_selected.push_back(selected->name);
+      for (size_t j = 0; j < input_pointclouds.size(); ++j) {
+        auto& ipc = input_pointclouds[j];
+        auto& pack = tile_packs[j];
+        size_t first = pack.points.size();
+        if ((selected->index == j) || (!only_write_selected)) {
+          auto& cloud = ipc.building_clouds[i];
+          auto classification = cloud.attributes.get_if<int>("classification");
+          auto& pack_classification =
+              pack.points.attributes.insert_vec<int>("classification");
+          auto& pack_source_id =
+              pack.points.attributes.insert_vec<int>("point_source_id");
+          pack.points.insert(pack.points.end(), cloud.begin(), cloud.end());
+          for (size_t k = 0; k < cloud.size(); ++k) {
+            pack_classification.push_back(
+                classification ? (*classification)[k] : std::nullopt);
+            // LAS point source ids are 16 bit, the index has the exact ranges
+            pack_source_id.push_back(int(i % 65536));
           }
 
-          LASWriter->write_pointcloud(input_pointclouds[j].building_clouds[i],
-                                      srs, pc_path);
-
-          // Correct ground height for offset, NB this ignores crs
-          // transformation
-          double h_ground =
-              input_pointclouds[j].ground_elevations[i] + (*pj->data_offset)[2];
-
-          // Create an array of tables
-          toml::array array_of_pointclouds;
-          // Add the first table
-          toml::table pointcloud{
-              {"name", ipc.name},
-              {"source", pc_path},
-          };
-          array_of_pointclouds.emplace_back(std::move(pointcloud));
-
-          auto gf_config =
-              toml::table{{"polygon-source", fp_path},
-                          {"GROUND_ELEVATION", h_ground},
-                          {"force-lod11-attribute", cfg.n.at("force_lod11")},
-                          {"id-attribute", cfg.id_attribute},
-                          {"pointclouds", std::move(array_of_pointclouds)}};
-
-          if (!only_write_selected) {
-            std::ofstream ofs;
-            std::string config_path =
-                fmt::format(fmt::runtime(cfg.building_toml_file_spec),
-                            fmt::arg("bid", bid), fmt::arg("pc_name", ipc.name),
-                            fmt::arg("path", cfg.output_path));
-            ofs.open(config_path);
-            ofs << gf_config;
-            ofs.close();
-
-            jsonl_paths[ipc.name].push_back(jsonl_path);
-          }
-          if (selected->index == j) {
-            // set optimal jsonl path
-            std::string jsonl_path =
-                fmt::format(fmt::runtime(cfg.building_jsonl_file_spec),
-                            fmt::arg("bid", bid), fmt::arg("pc_name", ""),
-                            fmt::arg("path", cfg.output_path));
-            // gf_config.insert_or_assign("OUTPUT_JSONL", jsonl_path);
-            jsonl_paths[""].push_back(jsonl_path);
-
-            // write optimal config
-            std::ofstream ofs;
-            std::string config_path = fmt::format(
-                fmt::runtime(cfg.building_toml_file_spec), fmt::arg("bid", bid),
-                fmt::arg("pc_name", ""), fmt::arg("path", cfg.output_path));
-            ofs.open(config_path);
-            ofs << gf_config;
-            ofs.close();
+          if (cfg.write_rasters) {
+            std::string raster_path = fmt::format(
+                fmt::runtime(cfg.building_raster_file_spec),
+                fmt::arg("bid", bid), fmt::arg("pc_name", ipc.name),
+                fmt::arg("path", cfg.output_path));
+            crop_writes.push_back([&, i, j, raster_path] {
+              output_writer.create_directories(
+                  fs::path(raster_path).parent_path());
+              auto writer = roofer::io::createRasterWriterGDAL(*pj);
+              writer->writeBands(raster_path,
+                                 input_pointclouds[j].building_rasters[i]);
+            });
           }
+        }
+        pack.first.push_back(int64_t(first));
+        pack.count.push_back(int64_t(pack.points.size() - first));
+        // Correct ground height for offset, NB this ignores crs
+        // transformation
+        pack.ground_elevation.push_back(
+            double(ipc.ground_elevations[i]) + (*pj->data_offset)[2]);
+      }
+    } else if (cfg.write_crop_outputs) {
+      std::string fp_path = fmt::format(
+          fmt::runtime(cfg.building_gpkg_file_spec), fmt::arg("bid", bid),
+          fmt::arg("path", cfg.output_path));
+      crop_writes.push_back([&, i, fp_path] {
+        output_writer.create_directories(fs::path(fp_path).parent_path());
+        auto writer = roofer::io::createVectorWriterOGR(*pj);
+        writer->create_directories_ = false;
+        writer->writePolygons(fp_path, copy_srs().get(), footprints,
+                              attributes, i, i + 1);
+      });
+
+      size_t j = 0;
+      for (auto& ipc : input_pointclouds) {
+        if ((selected->index != j) && (only_write_selected)) {
           ++j;
+          continue;
+        };
+
+        std::string pc_path = fmt::format(
+            fmt::runtime(cfg.building_las_file_spec), fmt::arg("bid", bid),
+            fmt::arg("pc_name", ipc.name), fmt::arg("path", cfg.output_path));
+        std::string raster_path = fmt::format(
+            fmt::runtime(cfg.building_raster_file_spec), fmt::arg("bid", bid),
+            fmt::arg("pc_name", ipc.name), fmt::arg("path", cfg.output_path));
+        std::string jsonl_path = fmt::format(
+            fmt::runtime(cfg.building_jsonl_file_spec), fmt::arg("bid", bid),
+            fmt::arg("pc_name", ipc.name), fmt::arg("path", cfg.output_path));
+
+        if (cfg.write_rasters) {
+          crop_writes.push_back([&, i, j, raster_path] {
+            output_writer.create_directories(
+                fs::path(raster_path).parent_path());
+            auto writer = roofer::io::createRasterWriterGDAL(*pj);
+            writer->writeBands(raster_path,
+                               input_pointclouds[j].building_rasters[i]);
+          });
+        }
+
+        crop_writes.push_back([&, i, j, pc_path] {
+          output_writer.create_directories(fs::path(pc_path).parent_path());
+          auto writer = roofer::io::createLASWriter(*pj);
+          writer->write_pointcloud(input_pointclouds[j].building_clouds[i],
+                                   copy_srs().get(), pc_path);
+        });
+
+        // Correct ground height for offset, NB this ignores crs
+        // transformation
+        double h_ground =
+            input_pointclouds[j].ground_elevations[i] + (*pj->data_offset)[2];
+
+        // Create an array of tables
+        toml::array array_of_pointclouds;
+        // Add the first table
+        toml::table pointcloud{
+            {"name", ipc.name},
+            {"source", pc_path},
+        };
+        array_of_pointclouds.emplace_back(std::move(pointcloud));
+
+        auto gf_config =
+            toml::table{{"polygon-source", fp_path},
+                        {"GROUND_ELEVATION", h_ground},
+                        {"force-lod11-attribute", cfg.n.at("force_lod11")},
+                        {"id-attribute", cfg.id_attribute},
+                        {"pointclouds", std::move(array_of_pointclouds)}};
+        std::ostringstream gf_config_stream;
+        gf_config_stream << gf_config;
+
+        if (!only_write_selected) {
+          std::string config_path =
+              fmt::format(fmt::runtime(cfg.building_toml_file_spec),
+                          fmt::arg("bid", bid), fmt::arg("pc_name", ipc.name),
+                          fmt::arg("path", cfg.output_path));
+          pending_writes.push_back(
+              output_writer.write_file(config_path, gf_config_stream.str()));
+
+          jsonl_paths[ipc.name].push_back(jsonl_path);
+        }
+        if (selected->index == j) {
+          // set optimal jsonl path
+          std::string jsonl_path =
+              fmt::format(fmt::runtime(cfg.building_jsonl_file_spec),
+                          fmt::arg("bid", bid), fmt::arg("pc_name", ""),
+                          fmt::arg("path", cfg.output_path));
+          // gf_config.insert_or_assign("OUTPUT_JSONL", jsonl_path);
+          jsonl_paths[""].push_back(jsonl_path);
+
+          // write optimal config
+          std::string config_path = fmt::format(
+              fmt::runtime(cfg.building_toml_file_spec), fmt::arg("bid", bid),
+              fmt::arg("pc_name", ""), fmt::arg("path", cfg.output_path));
+          pending_writes.push_back(
+              output_writer.write_file(config_path, gf_config_stream.str()));
         }
-      };
-      // write config
+        ++j;
+      }
     }
   }
 
-  // Write index output
-  if (cfg.write_index) {
-    std::string index_file = fmt::format(fmt::runtime(cfg.index_file_spec),
-                                         fmt::arg("path", cfg.output_path));
-    vector_writer->writePolygons(index_file, srs, footprints, attributes);
+  if (cfg.write_tiled_crop_outputs) {
+    auto tile_path = [&](const std::string& spec, const std::string& pc_name) {
+      return fmt::format(fmt::runtime(spec),
+                         fmt::arg("tid", output_building_tile.id),
+                         fmt::arg("pc_name", pc_name),
+                         fmt::arg("path", cfg.output_path));
+    };
+    // the footprints are written in building order, so feature i of the
+    // GeoPackage matches entry i of the index arrays
+    std::string fp_path = tile_path(cfg.tile_gpkg_file_spec, "");
+    crop_writes.push_back([&, fp_path] {
+      output_writer.create_directories(fs::path(fp_path).parent_path());
+      auto writer = roofer::io::createVectorWriterOGR(*pj);
+      writer->create_directories_ = false;
+      writer->writePolygons(fp_path, copy_srs().get(), footprints, attributes);
+    });
+
+    toml::array index_pointclouds;
+    for (size_t j = 0; j < input_pointclouds.size(); ++j) {
+      std::string pc_path =
+          tile_path(cfg.tile_las_file_spec, input_pointclouds[j].name);
+      crop_writes.push_back([&, j, pc_path] {
+        output_writer.create_directories(fs::path(pc_path).parent_path());
+        auto writer = roofer::io::createLASWriter(*pj);
+        writer->write_pointcloud(tile_packs[j].points, copy_srs().get(),
+                                 pc_path);
+      });
+      index_pointclouds.push_back(
+          toml::table{{"name", input_pointclouds[j].name},
+                      {"source", pc_path},
+                      {"first", std::move(tile_packs[j].first)},
+                      {"count", std::move(tile_packs[j].count)},
+                      {"ground_elevation",
+                       std::move(tile_packs[j].ground_elevation)}});
+    }
 
-    // write nodata circles
-    for (auto& ipc : input_pointclouds) {
-      vector_writer->writePolygons(
-          index_file + "_" + ipc.name + "_nodatacircle.gpkg", srs,
-          ipc.nodata_circles, attributes);
+    auto index =
+        toml::table{{"polygon-source", fp_path},
+                    {"force-lod11-attribute", cfg.n.at("force_lod11")},
+                    {"id-attribute", cfg.id_attribute},
+                    {"bid", std::move(tile_bids)},
+                    {"selected", std::move(tile_selected)},
+                    {"pointclouds", std::move(index_pointclouds)}};
+    std::ostringstream index_stream;
+    index_stream << index;
+    pending_writes.push_back(output_writer.write_file(
+        tile_path(cfg.tile_toml_file_spec, ""), index_stream.str()));
+  }
+
+  std::future<void> crop_cache_write;
+  if (!crop_cache_path.empty()) {
+    try {
+      crop_cache_write = crop_cache::write(
+          output_writer, crop_cache_path,
+          crop_cache::encode(
+              output_building_tile, attributes,
+              crop_cache::crop_attribute_names(cfg, input_pointclouds)));
+    } catch (const std::exception& e) {
+      logger.warning("Failed to write crop cache {}. {}",
+                     crop_cache_path.string(), e.what());
     }
   }
 
+  for (auto& crop_write : crop_writes) {
+    pending_writes.push_back(output_writer.submit(std::move(crop_write)));
+  }
+
   // write the txt containing paths to all jsonl features to be written by
   // reconstruct
   if (cfg.write_crop_outputs) {
@@ -476,15 +712,50 @@ bool crop_tile(const roofer::TBox<double>& tile,
         std::string jsonl_list_file = fmt::format(
             fmt::runtime(cfg.jsonl_list_file_spec),
             fmt::arg("path", cfg.output_path), fmt::arg("pc_name", name));
-        std::ofstream ofs;
-        ofs.open(jsonl_list_file);
+        std::string jsonl_list;
         for (auto& jsonl_p : pathsvec) {
-          ofs << jsonl_p << "\n";
+          jsonl_list += jsonl_p;
+          jsonl_list += "\n";
         }
-        ofs.close();
+        pending_writes.push_back(
+            output_writer.write_file(jsonl_list_file, std::move(jsonl_list)));
       }
     }
   }
+  // the crop outputs refer to the footprints, attributes and pointclouds, so
+  // every write must be done before the first error is thrown
+  std::exception_ptr write_error;
+  for (auto& pending : pending_writes) {
+    try {
+      pending.get();
+    } catch (...) {
+      if (!write_error) write_error = std::current_exception();
+    }
+  }
+  if (crop_cache_write.valid()) {
+    try {
+      crop_cache_write.get();
+    } catch (const std::exception& e) {
+      logger.warning("Failed to write crop cache {}. {}",
+                     crop_cache_path.string(), e.what());
+    }
+  }
+  if (write_error) std::rethrow_exception(write_error);
+
+  // Write index output
+  if (cfg.write_index) {
+    std::string index_file = fmt::format(fmt::runtime(cfg.index_file_spec),
+                                         fmt::arg("path", cfg.output_path));
+    vector_writer->writePolygons(index_file, srs, footprints, attributes);
+
+    // write nodata circles
+    for (auto& ipc : input_pointclouds) {
+      vector_writer->writePolygons(
+          index_file + "_" + ipc.name + "_nodatacircle.gpkg", srs,
+          ipc.nodata_circles, attributes);
+    }
+  }
+
   // clear input_pointclouds data
   for (auto& ipc : input_pointclouds) {
     ipc.nodata_radii.clear();
@@ -497,5 +768,6 @@ bool crop_tile(const roofer::TBox<double>& tile,
     ipc.acquisition_years.clear();
   }
 
+  add_unchanged_buildings();
   return true;
 }
@@ -0,0 +1,264 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+/**
+ * @brief Incremental runs based on a manifest of the previous run
+ *
+ * With write_manifest, every feature in the output gets a line in the
+ * manifest with its building id, a content hash and its location in the
+ * output directory:
+ *
+ *   <bid> \t <hash> \t <file> \t <offset> \t <size>
+ *
+ * where file is relative to the output directory. The content hash covers
+ * everything that goes into the feature: the footprint, the attribute row,
+ * the pointcloud files around the footprint with their sizes and modification
+ * times, the CityJSON transform and the configuration.
+ *
+ * A run with incremental_from set reads the manifest of that previous output
+ * directory. Buildings with an unchanged hash are neither cropped nor
+ * reconstructed, their feature is copied from the previous output as is.
+ */
+namespace incremental {
+
+  // Location of a feature in an output directory
+  struct Feature {
+    std::string file;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+  };
+
+  struct ManifestEntry {
+    uint64_t hash = 0;
+    Feature feature;
+  };
+
+  // Hash of the configuration that affects the output features
+  inline uint64_t config_hash(
+      const RooferConfig& cfg,
+      const std::vector<InputPointcloud>& input_pointclouds) {
+    ContentHash h;
+    h.add(git_Describe());
+    h.add(cfg.id_attribute).add(cfg.force_lod11_attribute);
+    h.add(cfg.yoc_attribute);
+    for (auto& name : cfg.attributes_keep) h.add(name);
+    h.add(cfg.ceil_point_density).add(cfg.cellsize);
+    h.add(cfg.lod11_fallback_area).add(cfg.lod11_fallback_density);
+    h.add(cfg.clear_if_insufficient);
+    h.add(cfg.lod11_fallback_planes).add(cfg.lod11_fallback_time);
+    h.add(cfg.lod11_fallback_total_time);
+    h.add(fmt::format("{}", cfg.rec));
+    h.add(cfg.output_format).add(cfg.cj_scale);
+    h.add(cfg.split_cjseq).add(cfg.building_jsonl_file_spec);
+
+    std::vector<std::pair<std::string, std::string>> names(cfg.n.begin(),
+                                                           cfg.n.end());
+    std::sort(names.begin(), names.end());
+    for (auto& [key, name] : names) {
+      h.add(key).add(name);
+    }
+    for (auto& ipc : input_pointclouds) {
+      h.add(ipc.name).add(ipc.quality).add(ipc.date);
+      h.add(ipc.bld_class).add(ipc.grnd_class);
+      h.add(ipc.force_lod11).add(ipc.select_only_for_date);
+    }
+    return h.value();
+  }
+
+  // Content hash of each footprint, translate is the translation of the
+  // CityJSON transform
+  inline std::vector<uint64_t> building_hashes(
+      uint64_t config_hash, const roofer::arr3d& translate,
+      const std::vector<roofer::LinearRing>& footprints,
+      const roofer::AttributeVecMap& attributes,
+      std::vector<InputPointcloud>& input_pointclouds,
+      roofer::misc::projHelperInterface& pj) {
+    // attributes in a fixed order
+    std::vector<std::pair<std::string, const roofer::AttributeVec*>> columns;
+    for (auto& [name, column] : attributes) {
+      columns.emplace_back(name, &column);
+    }
+    std::sort(columns.begin(), columns.end(),
+              [](auto& a, auto& b) { return a.first < b.first; });
+
+    std::unordered_map<std::string, uint64_t> file_hashes;
+    auto file_hash = [&file_hashes](const std::string& path) {
+      auto [it, inserted] = file_hashes.try_emplace(path, 0);
+      if (inserted) {
+        it->second = ContentHash().add(path).add_file_stat(path).value();
+      }
+      return it->second;
+    };
+
+    std::vector<uint64_t> hashes;
+    hashes.reserve(footprints.size());
+    for (size_t i = 0; i < footprints.size(); ++i) {
+      auto& footprint = footprints[i];
+      ContentHash h;
+      h.add(config_hash).add(translate);
+      h.add(static_cast<const roofer::vec3f&>(footprint));
+      h.add(footprint.interior_rings());
+      for (auto& [name, column] : columns) {
+        h.add(name);
+        std::visit([&h, i](auto& vec) { h.add(vec.at(i)); }, *column);
+      }
+
+      // the pointcloud files around the footprint, with the same margin
+      // as the buffer that is used for cropping
+      roofer::Box box;
+      for (auto& p : footprint) box.add(p);
+      roofer::TBox<double> query;
+      query.add(pj.coord_transform_rev(box.pmin[0] - 4, box.pmin[1] - 4,
+                                       box.pmin[2]));
+      query.add(pj.coord_transform_rev(box.pmax[0] + 4, box.pmax[1] + 4,
+                                       box.pmax[2]));
+      for (auto& ipc : input_pointclouds) {
+        std::vector<uint64_t> files;
+        for (auto* item : ipc.rtree->query(query)) {
+          files.push_back(file_hash(static_cast<fileExtent*>(item)->first));
+        }
+        std::sort(files.begin(), files.end());
+        h.add(files);
+      }
+      hashes.push_back(h.value());
+    }
+    return hashes;
+  }
+
+  // Keeps only the given rows of every attribute column
+  inline void select_rows(roofer::AttributeVecMap& attributes,
+                          const std::vector<size_t>& rows) {
+    for (auto& [name, column] : attributes.get_attributes()) {
+      std::visit(
+          [&rows](auto& vec) {
+            std::remove_cvref_t<decltype(vec)> selected;
+            selected.reserve(rows.size());
+            for (auto row : rows) selected.push_back(vec.at(row));
+            vec = std::move(selected);
+          },
+          column);
+    }
+  }
+
+  /**
+   * @brief Manifest of a previous run
+   */
+  class Manifest {
+    fs::path dir_;
+    std::unordered_map<std::string, ManifestEntry> entries_;
+
+   public:
+    // Reads the manifest at path, dir is the output directory it refers to
+    void read(const fs::path& path, const fs::path& dir) {
+      std::ifstream ifs(path);
+      if (!ifs) throw std::runtime_error("Failed to open " + path.string());
+      dir_ = dir;
+      std::string line;
+      while (std::getline(ifs, line)) {
+        if (line.empty() || line.starts_with('#')) continue;
+        std::istringstream fields(line);
+        std::string bid, hash;
+        ManifestEntry entry;
+        if (!std::getline(fields, bid, '\t') ||
+            !std::getline(fields, hash, '\t') ||
+            !std::getline(fields, entry.feature.file, '\t') ||
+            !(fields >> entry.feature.offset >> entry.feature.size)) {
+          throw std::runtime_error("Malformed line in " + path.string() +
+                                   ": " + line);
+        }
+        entry.hash = std::stoull(hash, nullptr, 16);
+        entries_.insert_or_assign(std::move(bid), std::move(entry));
+      }
+    }
+
+    size_t size() const { return entries_.size(); }
+
+    const ManifestEntry* find(const std::string& bid) const {
+      auto it = entries_.find(bid);
+      return it == entries_.end() ? nullptr : &it->second;
+    }
+
+    // The bytes of a feature in the output directory of the previous run
+    std::string read_feature(const Feature& feature) const {
+      auto path = dir_ / feature.file;
+      std::ifstream ifs(path, std::ios::binary);
+      std::string content(feature.size, '\0');
+      ifs.seekg(feature.offset);
+      ifs.read(content.data(), content.size());
+      if (!ifs) {
+        throw std::runtime_error("Failed to read feature from " +
+                                 path.string());
+      }
+      return content;
+    }
+  };
+
+  /**
+   * @brief Writes the manifest of this run
+   *
+   * The entries of a tile are written when the tile is journaled, so that
+   * the manifest of an interrupted run has no entries of tiles that are
+   * cropped and reconstructed again on resume.
+   */
+  class ManifestWriter {
+    fs::path dir_;
+    std::ofstream ofs_;
+    std::mutex mutex_;
+
+   public:
+    // Creates the manifest at path, dir is the output directory. With append
+    // the entries of an interrupted run are kept, a later entry for the same
+    // building replaces an earlier one when the manifest is read.
+    void open(const fs::path& path, const fs::path& dir, bool append = false) {
+      dir_ = dir;
+      fs::create_directories(path.parent_path());
+      const bool write_header = !append || !fs::exists(path);
+      ofs_.open(path, append ? std::ios::app : std::ios::out);
+      if (!ofs_) throw std::runtime_error("Failed to open " + path.string());
+      if (write_header) ofs_ << "# bid\thash\tfile\toffset\tsize\n";
+    }
+
+    // The manifest line of a feature, can be called from multiple threads
+    std::string line(const std::string& bid, uint64_t hash,
+                     const fs::path& file, uint64_t offset,
+                     uint64_t size) const {
+      return fmt::format("{}\t{:016x}\t{}\t{}\t{}\n", bid, hash,
+                         file.lexically_relative(dir_).generic_string(),
+                         offset, size);
+    }
+
+    // Writes the lines of a tile and flushes them, returns false if that
+    // failed
+    bool write(const std::vector<std::string>& lines) {
+      if (lines.empty()) return true;
+      std::scoped_lock lock{mutex_};
+      for (auto& line : lines) ofs_ << line;
+      ofs_.flush();
+      return static_cast<bool>(ofs_);
+    }
+
+    void close() {
+      std::scoped_lock lock{mutex_};
+      ofs_.close();
+    }
+  };
+
+}  // namespace incremental
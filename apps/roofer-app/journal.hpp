@@ -0,0 +1,220 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+/**
+ * @brief Journal of the tiles that are completely written
+ *
+ * A tile is added once all of its output is on disk. Its failed buildings
+ * are appended to the list of failed buildings and then its id to the
+ * journal, each followed by an fsync, so that after a crash the journal
+ * holds the tiles that were finished. A resumed run skips those tiles and
+ * loses at most the tiles that were in progress. The failed buildings of a
+ * tile that is not in the journal are ignored, and so is a last line that
+ * was not completely written.
+ *
+ * Both files are only rewritten as a whole by open(), which drops these
+ * leftovers, and by a merge. Appending keeps the cost per tile constant.
+ *
+ * The journal starts with a fingerprint of the tiling and configuration, a
+ * run with a different fingerprint can not be resumed from it.
+ */
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+class Journal {
+  // A file that lines are appended to, each append is flushed to disk
+  class AppendFile {
+    std::FILE* file_ = nullptr;
+
+   public:
+    AppendFile() = default;
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+    ~AppendFile() { close(); }
+
+    void open(const fs::path& path) {
+      close();
+      file_ = std::fopen(path.string().c_str(), "ab");
+      if (file_ == nullptr) {
+        throw std::runtime_error("Failed to open " + path.string());
+      }
+    }
+
+    void close() {
+      if (file_ != nullptr) std::fclose(file_);
+      file_ = nullptr;
+    }
+
+    void append(const std::string& content) {
+      if (file_ == nullptr) throw std::runtime_error("Journal is not open");
+      bool ok = std::fwrite(content.data(), 1, content.size(), file_) ==
+                    content.size() &&
+                std::fflush(file_) == 0;
+#if defined(_WIN32)
+      ok = ok && ::_commit(::_fileno(file_)) == 0;
+#else
+      ok = ok && ::fsync(::fileno(file_)) == 0;
+#endif
+      if (!ok) throw std::runtime_error("Failed to append to the journal");
+    }
+  };
+
+  fs::path path_;
+  fs::path failed_path_;
+  uint64_t fingerprint_ = 0;
+  std::mutex mutex_;
+  std::set<size_t> finished_tiles_;
+  // lines of the failed buildings list, per tile
+  std::map<size_t, std::vector<std::string>> failed_;
+  AppendFile journal_file_;
+  AppendFile failed_file_;
+
+  static void write_atomically(const fs::path& path,
+                               const std::string& content) {
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    fs::create_directories(path.parent_path());
+    {
+      std::ofstream ofs(tmp_path, std::ios::binary);
+      ofs.write(content.data(), content.size());
+      ofs.close();
+      if (!ofs) {
+        throw std::runtime_error("Failed to write " + tmp_path.string());
+      }
+    }
+    fs::rename(tmp_path, path);
+  }
+
+  static std::string failed_line(size_t tile_id, const std::string& bid,
+                                 const std::string& stage) {
+    return fmt::format("{}\t{}\t{}\n", tile_id, bid, stage);
+  }
+
+ public:
+  Journal(fs::path path, fs::path failed_path, uint64_t fingerprint)
+      : path_(std::move(path)),
+        failed_path_(std::move(failed_path)),
+        fingerprint_(fingerprint) {}
+
+  // Writes the journal and failed buildings as a whole, throws on errors
+  void write() {
+    std::string journal =
+        fmt::format("# roofer journal {:016x}\n", fingerprint_);
+    for (auto tile_id : finished_tiles_) {
+      journal += fmt::format("{}\n", tile_id);
+    }
+    std::string failed = "# tile\tbid\tstage\n";
+    for (auto& [tile_id, lines] : failed_) {
+      for (auto& line : lines) failed += line;
+    }
+    write_atomically(failed_path_, failed);
+    write_atomically(path_, journal);
+  }
+
+  // Writes the tiles that were read so far, none for a new run, and opens
+  // the files to append the tiles that are finished next. Throws on errors.
+  void open() {
+    write();
+    failed_file_.open(failed_path_);
+    journal_file_.open(path_);
+  }
+
+  // Reads the journal and failed buildings of an earlier run with the same
+  // fingerprint, returns the number of finished tiles
+  size_t read() { return read(path_, failed_path_); }
+
+  // Adds the finished tiles and failed buildings from another journal with
+  // the same fingerprint, eg. the journal of a shard
+  size_t read(const fs::path& path, const fs::path& failed_path) {
+    std::ifstream ifs(path);
+    if (!ifs) return finished_tiles_.size();
+    std::string line;
+    std::getline(ifs, line);
+    if (line != fmt::format("# roofer journal {:016x}", fingerprint_)) {
+      throw std::runtime_error(
+          fmt::format("The journal {} was written with a different "
+                      "configuration or tiling",
+                      path.string()));
+    }
+    // a line without a newline at the end was cut off by a crash
+    while (std::getline(ifs, line) && !ifs.eof()) {
+      if (!line.empty()) finished_tiles_.insert(std::stoull(line));
+    }
+
+    std::ifstream failed_ifs(failed_path);
+    while (std::getline(failed_ifs, line) && !failed_ifs.eof()) {
+      if (line.empty() || line.starts_with('#')) continue;
+      size_t tile_id = std::stoull(line.substr(0, line.find('\t')));
+      // the failures of unfinished tiles are found again when these are redone
+      if (finished_tiles_.contains(tile_id)) {
+        failed_[tile_id].push_back(line + "\n");
+      }
+    }
+    return finished_tiles_.size();
+  }
+
+  bool is_finished(size_t tile_id) {
+    std::scoped_lock lock{mutex_};
+    return finished_tiles_.contains(tile_id);
+  }
+
+  // Adds a tile of which all output is written, failed holds the ids of the
+  // buildings that failed, with the stage in which they failed. Errors are
+  // logged, the tile is then done again in a resumed run.
+  void finish_tile(size_t tile_id,
+                   const std::vector<std::pair<std::string, std::string>>&
+                       failed = {}) {
+    std::vector<std::string> lines;
+    std::string content;
+    for (auto& [bid, stage] : failed) {
+      lines.push_back(failed_line(tile_id, bid, stage));
+      content += lines.back();
+    }
+    std::scoped_lock lock{mutex_};
+    try {
+      if (!content.empty()) failed_file_.append(content);
+      journal_file_.append(fmt::format("{}\n", tile_id));
+    } catch (const std::exception& e) {
+      roofer::logger::Logger::get_logger().error(
+          "Failed to journal tile {}. {}", tile_id, e.what());
+      return;
+    }
+    finished_tiles_.insert(tile_id);
+    if (!lines.empty()) failed_[tile_id] = std::move(lines);
+  }
+
+  // Lists a tile that failed as a whole in the given stage, eg. when its crop
+  // failed, with * as building id. The tile is not journaled, so that a
+  // resumed run tries it again and a merge reports it as unfinished.
+  void fail_tile(size_t tile_id, const std::string& stage) {
+    std::scoped_lock lock{mutex_};
+    try {
+      failed_file_.append(failed_line(tile_id, "*", stage));
+    } catch (const std::exception& e) {
+      roofer::logger::Logger::get_logger().error(
+          "Failed to list failed tile {}. {}", tile_id, e.what());
+    }
+  }
+};
@@ -0,0 +1,112 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+/**
+ * @brief Asynchronous output of the many small per-building files
+ *
+ * With split_cjseq and write_crop_outputs every building gets its own
+ * directory and files. On network filesystems each directory and open/close
+ * call costs a round trip, so these are done on a small pool of I/O threads
+ * that overlaps them with cropping and reconstruction. Directories are
+ * created once and remembered, so that a file in a new directory below a
+ * known one costs a single mkdir.
+ *
+ * The number of pending writes is bounded; submitting blocks when the I/O
+ * threads fall behind, which keeps the memory held by pending writes in check.
+ */
+class OutputWriter {
+  BS::thread_pool pool_;
+  std::mutex directories_mutex_;
+  std::unordered_set<fs::path::string_type> known_directories_;
+
+  const size_t max_pending_;
+  size_t pending_ = 0;
+  std::mutex pending_mutex_;
+  std::condition_variable pending_cv_;
+
+  bool is_known_directory(const fs::path& dir) {
+    std::scoped_lock lock{directories_mutex_};
+    return known_directories_.contains(dir.native());
+  }
+
+ public:
+  explicit OutputWriter(size_t nthreads, size_t max_pending = 1024)
+      : pool_(nthreads), max_pending_(max_pending) {}
+  ~OutputWriter() { wait(); }
+
+  // Creates dir and its parents, skipping the ones that were created before
+  void create_directories(const fs::path& dir) {
+    if (dir.empty() || is_known_directory(dir)) return;
+    if (dir.has_relative_path() && dir.parent_path() != dir) {
+      create_directories(dir.parent_path());
+    }
+    std::error_code ec;
+    fs::create_directory(dir, ec);
+    if (ec && !fs::is_directory(dir)) {
+      throw fs::filesystem_error("Failed to create directory", dir, ec);
+    }
+    std::scoped_lock lock{directories_mutex_};
+    known_directories_.insert(dir.native());
+  }
+
+  // Runs task on the I/O threads, errors are logged and passed on to the
+  // returned future
+  std::future<void> submit(std::function<void()> task) {
+    {
+      std::unique_lock lock{pending_mutex_};
+      pending_cv_.wait(lock, [this] { return pending_ < max_pending_; });
+      ++pending_;
+    }
+    return pool_.submit_task([this, task = std::move(task)] {
+      std::exception_ptr error;
+      try {
+        task();
+      } catch (const std::exception& e) {
+        roofer::logger::Logger::get_logger().error("[output] {}", e.what());
+        error = std::current_exception();
+      }
+      {
+        std::scoped_lock lock{pending_mutex_};
+        --pending_;
+      }
+      pending_cv_.notify_one();
+      if (error) std::rethrow_exception(error);
+    });
+  }
+
+  // Writes content to path on the I/O threads, creating the directory
+  std::future<void> write_file(fs::path path, std::string content,
+                               std::ios::openmode mode = std::ios::out) {
+    return submit([this, path = std::move(path), content = std::move(content),
+                   mode] {
+      create_directories(path.parent_path());
+      std::ofstream ofs(path, mode);
+      ofs.write(content.data(), content.size());
+      ofs.close();
+      if (!ofs) {
+        throw std::runtime_error("Failed to write " + path.string());
+      }
+    });
+  }
+
+  // Waits until everything that was submitted is written
+  void wait() { pool_.wait(); }
+};
@@ -21,49 +21,101 @@
 
 enum LOD { LOD11 = 11, LOD12 = 12, LOD13 = 13, LOD22 = 22 };
 
+using roofer::collect_debug;
+
+/**
+ * @brief Reconstruction stages that are reused for all buildings of a worker
+ *
+ * Each stage clears its outputs when it is run again, so the output buffers
+ * keep their capacity from one building to the next. The temporary data of the
+ * stages is allocated from scratch, which is released after every building.
+ */
+struct ReconstructionContext {
+  roofer::ScratchArena scratch;
+
+  std::unique_ptr<roofer::reconstruction::PlaneDetectorInterface>
+      PlaneDetector = roofer::reconstruction::createPlaneDetector(&scratch);
+  std::unique_ptr<roofer::reconstruction::PlaneDetectorInterface>
+      PlaneDetector_ground =
+          roofer::reconstruction::createPlaneDetector(&scratch);
+  std::unique_ptr<roofer::reconstruction::AlphaShaperInterface> AlphaShaper =
+      roofer::reconstruction::createAlphaShaper(&scratch);
+  std::unique_ptr<roofer::reconstruction::AlphaShaperInterface>
+      AlphaShaper_ground = roofer::reconstruction::createAlphaShaper(&scratch);
+  std::unique_ptr<roofer::reconstruction::LineDetectorInterface> LineDetector =
+      roofer::reconstruction::createLineDetector();
+  std::unique_ptr<roofer::reconstruction::PlaneIntersectorInterface>
+      PlaneIntersector = roofer::reconstruction::createPlaneIntersector();
+  std::unique_ptr<roofer::reconstruction::LineRegulariserInterface>
+      LineRegulariser = roofer::reconstruction::createLineRegulariser();
+  std::unique_ptr<roofer::reconstruction::SegmentRasteriserInterface>
+      SegmentRasteriser = roofer::reconstruction::createSegmentRasteriser();
+  std::unique_ptr<roofer::reconstruction::ArrangementBuilderInterface>
+      ArrangementBuilder = roofer::reconstruction::createArrangementBuilder();
+  std::unique_ptr<roofer::reconstruction::ArrangementOptimiserInterface>
+      ArrangementOptimiser =
+          roofer::reconstruction::createArrangementOptimiser();
+  std::unique_ptr<roofer::reconstruction::ArrangementDissolverInterface>
+      ArrangementDissolver =
+          roofer::reconstruction::createArrangementDissolver();
+  std::unique_ptr<roofer::reconstruction::ArrangementSnapperInterface>
+      ArrangementSnapper = roofer::reconstruction::createArrangementSnapper();
+  std::unique_ptr<roofer::reconstruction::ArrangementExtruderInterface>
+      ArrangementExtruder =
+          roofer::reconstruction::createArrangementExtruder(&scratch);
+  std::unique_ptr<roofer::reconstruction::SimplePolygonExtruderInterface>
+      SimplePolygonExtruder =
+          roofer::reconstruction::createSimplePolygonExtruder();
+  std::unique_ptr<roofer::reconstruction::MeshTriangulatorInterface>
+      MeshTriangulator =
+          roofer::reconstruction::createMeshTriangulatorLegacy();
+  std::unique_ptr<roofer::misc::PC2MeshDistCalculatorInterface>
+      PC2MeshDistCalculator = roofer::misc::createPC2MeshDistCalculator();
+  std::unique_ptr<roofer::misc::MeshPropertyCalculatorInterface>
+      MeshPropertyCalculator = roofer::misc::createMeshPropertyCalculator();
+#ifdef RF_USE_VAL3DITY
+  std::unique_ptr<roofer::misc::Val3datorInterface> Val3dator =
+      roofer::misc::createVal3dator();
+#endif
+};
+
+void compute_roof_heights(roofer::Mesh& mesh,
+                          roofer::RasterTools::Raster& heightmap,
+                          float z_offset, RooferConfig* rfcfg,
+                          ReconstructionContext& ctx) {
+  mesh.get_attributes().resize(mesh.get_polygons().size());
+  ctx.MeshPropertyCalculator->calculate_h_attr(
+      mesh, heightmap,
+      {.z_offset = z_offset,
+       .h_50p = rfcfg->n["h_roof_50p"],
+       .h_70p = rfcfg->n["h_roof_70p"],
+       .h_min = rfcfg->n["h_roof_min"],
+       .h_max = rfcfg->n["h_roof_max"]});
+}
+
 void compute_mesh_properties(
     std::unordered_map<int, roofer::Mesh>& multisolid_lod12,
     std::unordered_map<int, roofer::Mesh>& multisolid_lod13,
     std::unordered_map<int, roofer::Mesh>& multisolid_lod22, float z_offset,
-    RooferConfig* rfcfg) {
-  auto MeshPropertyCalculator = roofer::misc::createMeshPropertyCalculator();
-  for (size_t i; i < multisolid_lod22.size(); ++i) {
+    RooferConfig* rfcfg, ReconstructionContext& ctx) {
+  auto& MeshPropertyCalculator = ctx.MeshPropertyCalculator;
+  for (size_t i = 0; i < multisolid_lod22.size(); ++i) {
     auto& mesh22 = multisolid_lod22.at(i);
-    mesh22.get_attributes().resize(mesh22.get_polygons().size());
 
     auto heightmap =
         MeshPropertyCalculator->get_heightmap(mesh22, rfcfg->cellsize);
-    MeshPropertyCalculator->calculate_h_attr(mesh22, heightmap,
-                                             {.z_offset = z_offset,
-                                              .h_50p = rfcfg->n["h_roof_50p"],
-                                              .h_70p = rfcfg->n["h_roof_70p"],
-                                              .h_min = rfcfg->n["h_roof_min"],
-                                              .h_max = rfcfg->n["h_roof_max"]});
+    compute_roof_heights(mesh22, heightmap, z_offset, rfcfg, ctx);
 
     MeshPropertyCalculator->compute_roof_orientation(
         mesh22, {.slope = rfcfg->n["slope"], .azimuth = rfcfg->n["azimuth"]});
 
     if (multisolid_lod12.size() > i) {
-      auto& mesh12 = multisolid_lod12.at(i);
-      mesh12.get_attributes().resize(mesh12.get_polygons().size());
-      MeshPropertyCalculator->calculate_h_attr(
-          mesh12, heightmap,
-          {.z_offset = z_offset,
-           .h_50p = rfcfg->n["h_roof_50p"],
-           .h_70p = rfcfg->n["h_roof_70p"],
-           .h_min = rfcfg->n["h_roof_min"],
-           .h_max = rfcfg->n["h_roof_max"]});
+      compute_roof_heights(multisolid_lod12.at(i), heightmap, z_offset, rfcfg,
+                           ctx);
     }
     if (multisolid_lod13.size() > i) {
-      auto& mesh13 = multisolid_lod13.at(i);
-      mesh13.get_attributes().resize(mesh13.get_polygons().size());
-      MeshPropertyCalculator->calculate_h_attr(
-          mesh13, heightmap,
-          {.z_offset = z_offset,
-           .h_50p = rfcfg->n["h_roof_50p"],
-           .h_70p = rfcfg->n["h_roof_70p"],
-           .h_min = rfcfg->n["h_roof_min"],
-           .h_max = rfcfg->n["h_roof_max"]});
+      compute_roof_heights(multisolid_lod13.at(i), heightmap, z_offset, rfcfg,
+                           ctx);
     }
   }
 }
@@ -73,9 +125,9 @@ void multisolid_post_process(BuildingObject& building, RooferConfig* rfcfg,
                              std::unordered_map<int, roofer::Mesh>& multisolid,
                              std::optional<float>& rmse,
                              std::optional<float>& volume,
-                             std::optional<std::string>& attr_val3dity) {
-  auto MeshTriangulator =
-      roofer::reconstruction::createMeshTriangulatorLegacy();
+                             std::optional<std::string>& attr_val3dity,
+                             ReconstructionContext& ctx) {
+  auto& MeshTriangulator = ctx.MeshTriangulator;
   MeshTriangulator->compute(multisolid);
   volume = MeshTriangulator->volumes.at(0);
   // logger.debug("Completed MeshTriangulator");
@@ -86,7 +138,7 @@ void multisolid_post_process(BuildingObject& building, RooferConfig* rfcfg,
               .with_class_ids(MeshTriangulator->ring_ids));
 #endif
 
-  auto PC2MeshDistCalculator = roofer::misc::createPC2MeshDistCalculator();
+  auto& PC2MeshDistCalculator = ctx.PC2MeshDistCalculator;
   PC2MeshDistCalculator->compute(building.pointcloud_building,
                                  MeshTriangulator->multitrianglecol,
                                  MeshTriangulator->ring_ids);
@@ -100,7 +152,7 @@ void multisolid_post_process(BuildingObject& building, RooferConfig* rfcfg,
 
 #ifdef RF_USE_VAL3DITY
   if (multisolid.size() > 0) {
-    auto Val3dator = roofer::misc::createVal3dator();
+    auto& Val3dator = ctx.Val3dator;
     Val3dator->compute(multisolid);
     attr_val3dity = Val3dator->errors.front();
   }
@@ -110,10 +162,9 @@ void multisolid_post_process(BuildingObject& building, RooferConfig* rfcfg,
 
 std::unordered_map<int, roofer::Mesh> extrude_lod22(
     roofer::Arrangement_2 arrangement, BuildingObject& building,
-    RooferConfig* rfcfg,
-    roofer::reconstruction::SegmentRasteriserInterface* SegmentRasteriser,
-    LOD lod, std::optional<float>& rmse, std::optional<float>& volume,
-    std::optional<std::string>& attr_val3dity) {
+    RooferConfig* rfcfg, LOD lod, std::optional<float>& rmse,
+    std::optional<float>& volume, std::optional<std::string>& attr_val3dity,
+    ReconstructionContext& ctx) {
   auto* cfg = &(rfcfg->rec);
   bool dissolve_step_edges = false;
   bool dissolve_all_interior = false;
@@ -130,10 +181,9 @@ std::unordered_map<int, roofer::Mesh> extrude_lod22(
 
   auto& logger = roofer::logger::Logger::get_logger();
 
-  auto ArrangementDissolver =
-      roofer::reconstruction::createArrangementDissolver();
+  auto& ArrangementDissolver = ctx.ArrangementDissolver;
   ArrangementDissolver->compute(
-      arrangement, SegmentRasteriser->heightfield,
+      arrangement, ctx.SegmentRasteriser->heightfield,
       {.dissolve_step_edges = dissolve_step_edges,
        .dissolve_all_interior = dissolve_all_interior,
        .step_height_threshold = cfg->lod13_step_height});
@@ -144,7 +194,7 @@ std::unordered_map<int, roofer::Mesh> extrude_lod22(
       worldname + "ArrangementDissolver",
       rerun::LineStrips3D(roofer::reconstruction::arr2polygons(arrangement)));
 #endif
-  auto ArrangementSnapper = roofer::reconstruction::createArrangementSnapper();
+  auto& ArrangementSnapper = ctx.ArrangementSnapper;
   ArrangementSnapper->compute(arrangement);
   // logger.debug("Completed ArrangementSnapper");
 #ifdef RF_USE_RERUN
@@ -152,10 +202,10 @@ std::unordered_map<int, roofer::Mesh> extrude_lod22(
 // roofer::reconstruction::arr2polygons(arrangement) ));
 #endif
 
-  auto ArrangementExtruder =
-      roofer::reconstruction::createArrangementExtruder();
-  ArrangementExtruder->compute(arrangement, building.h_ground,
-                               {.LoD2 = extrude_LoD2});
+  auto& ArrangementExtruder = ctx.ArrangementExtruder;
+  ArrangementExtruder->compute(
+      arrangement, building.h_ground,
+      {.LoD2 = extrude_LoD2, .collect_debug = collect_debug});
   // logger.debug("Completed ArrangementExtruder");
 #ifdef RF_USE_RERUN
   rec.log(worldname + "ArrangementExtruder",
@@ -164,28 +214,40 @@ std::unordered_map<int, roofer::Mesh> extrude_lod22(
 #endif
 
   multisolid_post_process(building, rfcfg, lod, ArrangementExtruder->multisolid,
-                          rmse, volume, attr_val3dity);
+                          rmse, volume, attr_val3dity, ctx);
 
-  return ArrangementExtruder->multisolid;
+  return std::move(ArrangementExtruder->multisolid);
 }
 
-void extrude_lod11(BuildingObject& building, RooferConfig* rfcfg) {
-  auto SimplePolygonExtruder =
-      roofer::reconstruction::createSimplePolygonExtruder();
+void extrude_lod11(BuildingObject& building, RooferConfig* rfcfg,
+                   ReconstructionContext& ctx) {
+  auto& SimplePolygonExtruder = ctx.SimplePolygonExtruder;
   SimplePolygonExtruder->compute(building.footprint, building.h_ground,
                                  building.h_roof_70p_rough);
-  // std::vector<std::unordered_map<int, roofer::Mesh>> multisolidvec;
-  building.multisolids_lod12 = SimplePolygonExtruder->multisolid;
-  building.multisolids_lod13 = SimplePolygonExtruder->multisolid;
-  building.multisolids_lod22 = SimplePolygonExtruder->multisolid;
-
-  compute_mesh_properties(building.multisolids_lod12,
-                          building.multisolids_lod13,
-                          building.multisolids_lod22, building.z_offset, rfcfg);
-
-  multisolid_post_process(
-      building, rfcfg, LOD11, SimplePolygonExtruder->multisolid,
-      building.rmse_lod12, building.volume_lod12, building.val3dity_lod12);
+  auto& multisolid = SimplePolygonExtruder->multisolid;
+
+  multisolid_post_process(building, rfcfg, LOD11, multisolid,
+                          building.rmse_lod12, building.volume_lod12,
+                          building.val3dity_lod12, ctx);
+
+  // All LoDs get the same mesh, so we compute the roof heights only once and
+  // copy the result. Like in compute_mesh_properties() only LoD2.2 gets the
+  // roof orientation.
+  for (size_t i = 0; i < multisolid.size(); ++i) {
+    auto& mesh = multisolid.at(i);
+    auto heightmap =
+        ctx.MeshPropertyCalculator->get_heightmap(mesh, rfcfg->cellsize);
+    compute_roof_heights(mesh, heightmap, building.z_offset, rfcfg, ctx);
+  }
+  building.multisolids_lod12 = multisolid;
+  building.multisolids_lod13 = multisolid;
+  building.multisolids_lod22 = std::move(multisolid);
+  for (size_t i = 0; i < building.multisolids_lod22.size(); ++i) {
+    ctx.MeshPropertyCalculator->compute_roof_orientation(
+        building.multisolids_lod22.at(i),
+        {.slope = rfcfg->n["slope"], .azimuth = rfcfg->n["azimuth"]});
+  }
+
   building.rmse_lod13 = building.rmse_lod12;
   building.rmse_lod22 = building.rmse_lod12;
   building.volume_lod13 = building.volume_lod12;
@@ -199,7 +261,13 @@ void extrude_lod11(BuildingObject& building, RooferConfig* rfcfg) {
   building.roof_elevation_70p = building.h_roof_70p_rough;
 }
 
-void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
+/**
+ * @brief Reconstruct a single building, the stages after plane detection stop
+ * with roofer::DeadlineExceeded once the deadline has passed
+ */
+void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg,
+                          ReconstructionContext& ctx,
+                          const roofer::Deadline& deadline) {
   auto* cfg = &(rfcfg->rec);
   auto& logger = roofer::logger::Logger::get_logger();
 
@@ -235,12 +303,12 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
   if (building.extrusion_mode == SKIP) {
     return;
   } else if (building.extrusion_mode == LOD11_FALLBACK) {
-    extrude_lod11(building, rfcfg);
+    extrude_lod11(building, rfcfg, ctx);
     return;
   } else {
     auto t0 = std::chrono::high_resolution_clock::now();
-    auto PlaneDetector = roofer::reconstruction::createPlaneDetector();
-    auto PlaneDetector_ground = roofer::reconstruction::createPlaneDetector();
+    auto& PlaneDetector = ctx.PlaneDetector;
+    auto& PlaneDetector_ground = ctx.PlaneDetector_ground;
     try {
       auto plane_detector_cfg = roofer::reconstruction::PlaneDetectorConfig{
           .metrics_plane_k = cfg->plane_detect_k,
@@ -273,7 +341,7 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
         return;
       }
     } catch (const std::runtime_error& e) {
-      extrude_lod11(building, rfcfg);
+      extrude_lod11(building, rfcfg, ctx);
       logger.warning("[reconstructor] {}, LoD1.1 fallback: {}",
                      building.jsonl_path.string(), e.what());
       return;
@@ -289,9 +357,11 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
     //         rerun::Points3D(points_roof).with_class_ids(PlaneDetector->plane_id));
     // #endif
     t0 = std::chrono::high_resolution_clock::now();
-    auto AlphaShaper = roofer::reconstruction::createAlphaShaper();
+    auto& AlphaShaper = ctx.AlphaShaper;
     AlphaShaper->compute(PlaneDetector->pts_per_roofplane,
-                         {.thres_alpha = cfg->thres_alpha});
+                         {.thres_alpha = cfg->thres_alpha,
+                          .collect_debug = collect_debug,
+                          .deadline = &deadline});
     timings["AlphaShaper"] = std::chrono::high_resolution_clock::now() - t0;
     // logger.debug("Completed AlphaShaper (roof), found {} rings, {} labels",
     //  AlphaShaper->alpha_rings.size(),
@@ -302,8 +372,10 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
                 .with_class_ids(AlphaShaper->roofplane_ids));
 #endif
     t0 = std::chrono::high_resolution_clock::now();
-    auto AlphaShaper_ground = roofer::reconstruction::createAlphaShaper();
-    AlphaShaper_ground->compute(PlaneDetector_ground->pts_per_roofplane);
+    auto& AlphaShaper_ground = ctx.AlphaShaper_ground;
+    AlphaShaper_ground->compute(
+        PlaneDetector_ground->pts_per_roofplane,
+        {.collect_debug = collect_debug, .deadline = &deadline});
     timings["AlphaShaper_ground"] =
         std::chrono::high_resolution_clock::now() - t0;
     // logger.debug("Completed AlphaShaper (ground), found {} rings, {} labels",
@@ -315,10 +387,11 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
                 .with_class_ids(AlphaShaper_ground->roofplane_ids));
 #endif
     t0 = std::chrono::high_resolution_clock::now();
-    auto LineDetector = roofer::reconstruction::createLineDetector();
+    auto& LineDetector = ctx.LineDetector;
     LineDetector->detect(AlphaShaper->alpha_rings, AlphaShaper->roofplane_ids,
                          PlaneDetector->pts_per_roofplane,
-                         {.dist_thres = cfg->line_detect_epsilon});
+                         {.dist_thres = cfg->line_detect_epsilon,
+                          .collect_debug = collect_debug});
     timings["LineDetector"] = std::chrono::high_resolution_clock::now() - t0;
     // logger.debug("Completed LineDetector");
 #ifdef RF_USE_RERUN
@@ -327,7 +400,7 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
 #endif
 
     t0 = std::chrono::high_resolution_clock::now();
-    auto PlaneIntersector = roofer::reconstruction::createPlaneIntersector();
+    auto& PlaneIntersector = ctx.PlaneIntersector;
     PlaneIntersector->compute(PlaneDetector->pts_per_roofplane,
                               PlaneDetector->plane_adjacencies);
     timings["PlaneIntersector"] =
@@ -339,7 +412,7 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
 #endif
 
     t0 = std::chrono::high_resolution_clock::now();
-    auto LineRegulariser = roofer::reconstruction::createLineRegulariser();
+    auto& LineRegulariser = ctx.LineRegulariser;
     LineRegulariser->compute(LineDetector->edge_segments,
                              PlaneIntersector->segments,
                              {.dist_threshold = cfg->thres_reg_line_dist,
@@ -352,11 +425,11 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
 #endif
 
     t0 = std::chrono::high_resolution_clock::now();
-    auto SegmentRasteriser = roofer::reconstruction::createSegmentRasteriser();
+    auto& SegmentRasteriser = ctx.SegmentRasteriser;
     SegmentRasteriser->compute(
         AlphaShaper->alpha_triangles, AlphaShaper_ground->alpha_triangles,
-        {.use_ground =
-             !building.pointcloud_ground.empty() && cfg->clip_ground});
+        {.use_ground = !building.pointcloud_ground.empty() && cfg->clip_ground,
+         .collect_debug = collect_debug});
     timings["SegmentRasteriser"] =
         std::chrono::high_resolution_clock::now() - t0;
     // logger.debug("Completed SegmentRasteriser");
@@ -366,15 +439,15 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
     heightfield_copy.set_nodata(0);
     rec.log("world/heightfield",
             rerun::DepthImage({heightfield_copy.dimy_, heightfield_copy.dimx_},
-                              *heightfield_copy.vals_));
+                              heightfield_copy.vals_));
 #endif
 
     t0 = std::chrono::high_resolution_clock::now();
     roofer::Arrangement_2 arrangement;
-    auto ArrangementBuilder =
-        roofer::reconstruction::createArrangementBuilder();
+    auto& ArrangementBuilder = ctx.ArrangementBuilder;
     ArrangementBuilder->compute(arrangement, building.footprint,
-                                LineRegulariser->exact_regularised_edges);
+                                LineRegulariser->exact_regularised_edges,
+                                {.deadline = &deadline});
     timings["ArrangementBuilder"] =
         std::chrono::high_resolution_clock::now() - t0;
     // logger.debug("Completed ArrangementBuilder");
@@ -387,8 +460,7 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
 #endif
 
     t0 = std::chrono::high_resolution_clock::now();
-    auto ArrangementOptimiser =
-        roofer::reconstruction::createArrangementOptimiser();
+    auto& ArrangementOptimiser = ctx.ArrangementOptimiser;
     ArrangementOptimiser->compute(
         arrangement, SegmentRasteriser->heightfield,
         PlaneDetector->pts_per_roofplane,
@@ -398,6 +470,7 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
             .smoothness_multiplier = float(1. - cfg->complexity_factor),
             .use_ground =
                 !building.pointcloud_ground.empty() && cfg->clip_ground,
+            .deadline = &deadline,
         });
     timings["ArrangementOptimiser"] =
         std::chrono::high_resolution_clock::now() - t0;
@@ -411,23 +484,23 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
     t0 = std::chrono::high_resolution_clock::now();
     if (cfg->lod == 0 || cfg->lod == 12) {
       building.multisolids_lod12 = extrude_lod22(
-          arrangement, building, rfcfg, SegmentRasteriser.get(), LOD12,
-          building.rmse_lod12, building.volume_lod12, building.val3dity_lod12);
+          arrangement, building, rfcfg, LOD12, building.rmse_lod12,
+          building.volume_lod12, building.val3dity_lod12, ctx);
     }
 
     if (cfg->lod == 0 || cfg->lod == 13) {
       building.multisolids_lod13 = extrude_lod22(
-          arrangement, building, rfcfg, SegmentRasteriser.get(), LOD13,
-          building.rmse_lod13, building.volume_lod13, building.val3dity_lod13);
+          arrangement, building, rfcfg, LOD13, building.rmse_lod13,
+          building.volume_lod13, building.val3dity_lod13, ctx);
     }
 
     if (cfg->lod == 0 || cfg->lod == 22) {
       building.multisolids_lod22 = extrude_lod22(
-          arrangement, building, rfcfg, SegmentRasteriser.get(), LOD22,
-          building.rmse_lod22, building.volume_lod22, building.val3dity_lod22);
+          arrangement, building, rfcfg, LOD22, building.rmse_lod22,
+          building.volume_lod22, building.val3dity_lod22, ctx);
       compute_mesh_properties(
           building.multisolids_lod12, building.multisolids_lod13,
-          building.multisolids_lod22, building.z_offset, rfcfg);
+          building.multisolids_lod22, building.z_offset, rfcfg, ctx);
     }
     timings["extrude"] = std::chrono::high_resolution_clock::now() - t0;
 
@@ -441,3 +514,28 @@ void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg) {
     logger.debug("{})", timings_str);
   }
 }
+
+/**
+ * @brief Reconstruct a single building
+ *
+ * A building that takes longer than lod11_fallback_total_time in total gets
+ * an LoD1.1 fallback, so that a pathological building does not hold up its
+ * worker indefinitely.
+ *
+ * The stages of ctx are reused. None of their scratch data is referenced by
+ * the building after this returns, so the caller can release ctx.scratch right
+ * away.
+ */
+void reconstruct_building(BuildingObject& building, RooferConfig* rfcfg,
+                          ReconstructionContext& ctx) {
+  roofer::Deadline deadline(
+      std::chrono::milliseconds(rfcfg->lod11_fallback_total_time));
+  try {
+    reconstruct_building(building, rfcfg, ctx, deadline);
+  } catch (const roofer::DeadlineExceeded& e) {
+    extrude_lod11(building, rfcfg, ctx);
+    roofer::logger::Logger::get_logger().warning(
+        "[reconstructor] {}, LoD1.1 fallback: {}", building.jsonl_path.string(),
+        e.what());
+  }
+}
@@ -20,14 +20,27 @@
 // Ravi Peters
 // Balazs Dukai
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <deque>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 namespace fs = std::filesystem;
 
@@ -36,6 +49,7 @@ namespace fs = std::filesystem;
 // common
 #include <roofer/logger/logger.h>
 #include <roofer/misc/projHelper.hpp>
+#include <roofer/common/ScratchArena.hpp>
 #include <roofer/common/datastructures.hpp>
 #include <roofer/io/SpatialReferenceSystem.hpp>
 
@@ -72,7 +86,9 @@ namespace fs = std::filesystem;
 #include <roofer/reconstruction/SimplePolygonExtruder.hpp>
 
 // serialisation
+#include <roofer/io/CityJsonBinaryWriter.hpp>
 #include <roofer/io/CityJsonWriter.hpp>
+#include <nlohmann/json.hpp>
 
 #include "BS_thread_pool.hpp"
 
@@ -84,6 +100,9 @@ namespace fs = std::filesystem;
 #endif
 
 #include "config.hpp"
+#include "content_hash.hpp"
+#include "incremental.hpp"
+#include "journal.hpp"
 
 enum ExtrusionMode { STANDARD, LOD11_FALLBACK, SKIP };
 
@@ -116,6 +135,13 @@ struct BuildingObject {
   bool is_glass_roof;
   ExtrusionMode extrusion_mode = STANDARD;
 
+  // set in crop with write_manifest
+  std::string bid;
+  uint64_t content_hash = 0;
+  // set in crop for buildings that did not change since the previous run,
+  // these are copied instead of reconstructed
+  std::optional<incremental::Feature> previous_feature;
+
   // set in reconstruction
   // optionals may not get assigned a valid value
   std::string roof_type = "unknown";
@@ -248,8 +274,11 @@ struct fmt::formatter<BuildingTile> {
   }
 };
 
+#include "output_writer.hpp"
+#include "crop_cache.hpp"
 #include "crop_tile.hpp"
 #include "reconstruct_building.hpp"
+#include "shard.hpp"
 
 void get_las_extents(InputPointcloud& ipc,
                      roofer::io::SpatialReferenceSystemInterface* srs) {
@@ -259,6 +288,7 @@ void get_las_extents(InputPointcloud& ipc,
     PointReader->open(fp);
     if (!srs->is_valid()) PointReader->get_crs(srs);
     ipc.file_extents.push_back(std::make_pair(fp, PointReader->getExtent()));
+    ipc.file_point_counts.push_back(PointReader->getPointCount());
   }
 }
 
@@ -280,6 +310,121 @@ std::vector<roofer::TBox<double>> create_tiles(roofer::TBox<double>& roi,
   return tiles;
 }
 
+// The roi extended at its lower left corner so that the tiles of create_tiles
+// fall on the grid of the pointcloud files. Files usually hold the points of
+// one square tile of a fixed size, but the points of a file at the edge of
+// the data or over water do not fill it. The grid origin is therefore the
+// offset of the rounded lower left file corners modulo the tilesize that
+// most files have.
+roofer::TBox<double> align_to_pointclouds(
+    const roofer::TBox<double>& roi, double tilesize_x, double tilesize_y,
+    const std::vector<InputPointcloud>& input_pointclouds) {
+  std::map<std::pair<double, double>, size_t> offset_counts;
+  for (auto& ipc : input_pointclouds) {
+    for (auto& [path, extent] : ipc.file_extents) {
+      double offset_x = std::fmod(std::round(extent.pmin[0]), tilesize_x);
+      double offset_y = std::fmod(std::round(extent.pmin[1]), tilesize_y);
+      if (offset_x < 0) offset_x += tilesize_x;
+      if (offset_y < 0) offset_y += tilesize_y;
+      ++offset_counts[{offset_x, offset_y}];
+    }
+  }
+  if (offset_counts.empty()) return roi;
+  // the smallest offset among equally common ones, for a fixed tiling
+  auto origin = std::ranges::max_element(
+      offset_counts, [](auto& a, auto& b) { return a.second < b.second; });
+  auto [origin_x, origin_y] = origin->first;
+  roofer::TBox<double> grid = roi;
+  grid.pmin[0] =
+      origin_x + std::floor((roi.pmin[0] - origin_x) / tilesize_x) * tilesize_x;
+  grid.pmin[1] =
+      origin_y + std::floor((roi.pmin[1] - origin_y) / tilesize_y) * tilesize_y;
+  return grid;
+}
+
+// Estimated number of points in box, assuming that the points are evenly
+// spread over the extent of each pointcloud file
+double estimate_point_count(const roofer::TBox<double>& box,
+                            std::vector<InputPointcloud>& input_pointclouds) {
+  double count = 0;
+  for (auto& ipc : input_pointclouds) {
+    for (auto* item : ipc.rtree->query(box)) {
+      auto* file_extent = static_cast<fileExtent*>(item);
+      auto& extent = file_extent->second;
+      auto overlap = box.intersect(extent);
+      double area = extent.size_x() * extent.size_y();
+      if (!overlap.has_value() || area <= 0) continue;
+      size_t i = file_extent - ipc.file_extents.data();
+      count += ipc.file_point_counts[i] * overlap->size_x() *
+               overlap->size_y() / area;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Tiles that follow the density of footprints and points
+ *
+ * Starts from the tiles of create_tiles over grid, which covers roi, and
+ * splits each tile in four until it has at most max_buildings footprint
+ * centroids and an estimated max_points points, or until it is 64 times
+ * smaller than tilesize. Tiles without
+ * footprints are left out, the others are intersected with the roi. The tiles
+ * are in a fixed order, so the same inputs give the same tile ids.
+ */
+std::vector<roofer::TBox<double>> create_adaptive_tiles(
+    roofer::TBox<double>& roi, roofer::TBox<double>& grid, double tilesize_x,
+    double tilesize_y, const std::vector<roofer::arr3d>& centroids,
+    std::vector<InputPointcloud>& input_pointclouds, size_t max_buildings,
+    double max_points) {
+  auto roots = create_tiles(grid, tilesize_x, tilesize_y);
+  size_t dimy = (grid.max()[1] - grid.min()[1]) / tilesize_y + 1;
+  size_t dimx = roots.size() / dimy;
+
+  // centroids per root tile, in the column-major order of create_tiles
+  std::vector<std::vector<roofer::arr3d>> root_centroids(roots.size());
+  for (auto& c : centroids) {
+    if (!roi.intersects(c)) continue;
+    auto col = size_t((c[0] - grid.min()[0]) / tilesize_x);
+    auto row = size_t((c[1] - grid.min()[1]) / tilesize_y);
+    if (col < dimx && row < dimy) root_centroids[col * dimy + row].push_back(c);
+  }
+
+  std::vector<roofer::TBox<double>> tiles;
+  std::function<void(const roofer::TBox<double>&,
+                     std::vector<roofer::arr3d>&)>
+      split = [&](const roofer::TBox<double>& tile,
+                  std::vector<roofer::arr3d>& tile_centroids) {
+        if (tile_centroids.empty()) return;
+        bool too_dense =
+            tile_centroids.size() > max_buildings ||
+            estimate_point_count(tile, input_pointclouds) > max_points;
+        if (!too_dense || tile.size_x() * 64 <= tilesize_x) {
+          if (auto t = roi.intersect(tile)) tiles.push_back(*t);
+          return;
+        }
+        auto center = tile.center();
+        std::array<std::vector<roofer::arr3d>, 4> quadrant_centroids;
+        for (auto& c : tile_centroids) {
+          quadrant_centroids[(c[0] >= center[0]) * 2 + (c[1] >= center[1])]
+              .push_back(c);
+        }
+        tile_centroids = {};
+        for (size_t q = 0; q < 4; ++q) {
+          double xmin = q / 2 ? center[0] : tile.pmin[0];
+          double ymin = q % 2 ? center[1] : tile.pmin[1];
+          double xmax = q / 2 ? tile.pmax[0] : center[0];
+          double ymax = q % 2 ? tile.pmax[1] : center[1];
+          split(roofer::TBox<double>{xmin, ymin, 0., xmax, ymax, 0.},
+                quadrant_centroids[q]);
+        }
+      };
+  for (size_t i = 0; i < roots.size(); ++i) {
+    split(roots[i], root_centroids[i]);
+  }
+  return tiles;
+}
+
 #ifdef RF_ENABLE_HEAP_TRACING
 // Overrides for heap allocation counting
 // Ref.: https://www.youtube.com/watch?v=sLlGEUO_EGE
@@ -635,8 +780,30 @@ int main(int argc, const char* argv[]) {
       building_tile.extent = roi;
       building_tile.proj_helper = roofer::misc::createProjHelper();
     } else {
-      auto tile_extents =
-          create_tiles(roi, roofer_cfg.tilesize[0], roofer_cfg.tilesize[1]);
+      auto grid = roi;
+      if (roofer_cfg.align_tiles) {
+        grid = align_to_pointclouds(roi, roofer_cfg.tilesize[0],
+                                    roofer_cfg.tilesize[1], input_pointclouds);
+        logger.info("Aligned tiles to pointcloud files at {:.3f} {:.3f}",
+                    grid.pmin[0], grid.pmin[1]);
+      }
+      std::vector<roofer::TBox<double>> tile_extents;
+      if (roofer_cfg.adaptive_tiling) {
+        if (roofer_cfg.region_of_interest.has_value()) {
+          VectorReader->region_of_interest = roi;
+        }
+        std::vector<roofer::arr3d> centroids;
+        VectorReader->readCentroids(centroids);
+        VectorReader->region_of_interest.reset();
+        tile_extents = create_adaptive_tiles(
+            roi, grid, roofer_cfg.tilesize[0], roofer_cfg.tilesize[1],
+            centroids, input_pointclouds, roofer_cfg.tile_max_buildings,
+            roofer_cfg.tile_max_points);
+        logger.info("Created {} adaptive tiles", tile_extents.size());
+      } else {
+        tile_extents =
+            create_tiles(grid, roofer_cfg.tilesize[0], roofer_cfg.tilesize[1]);
+      }
 
       for (std::size_t tid = 0; tid < tile_extents.size(); tid++) {
         // intersect with roi, to avoid creating buildings outside of the roi
@@ -654,6 +821,31 @@ int main(int argc, const char* argv[]) {
         building_tile.proj_helper = roofer::misc::createProjHelper();
       }
     }
+
+    // Every shard orders the same tiles, starting with the tiles assigned to
+    // it and then those of the next shards, from the last tile backwards
+    if (size_t n_shards = roofer_cfg_handler._shard_count) {
+      std::vector<size_t> counts;
+      for (auto& building_tile : initial_tiles) {
+        counts.push_back(VectorReader->get_feature_count(building_tile.extent));
+      }
+      auto shard_of = shard::assign(counts, n_shards);
+      std::deque<BuildingTile> ordered_tiles;
+      for (size_t k = 0; k < n_shards; ++k) {
+        size_t s = (roofer_cfg_handler._shard_index + k) % n_shards;
+        for (size_t j = 0; j < initial_tiles.size(); ++j) {
+          size_t t = k == 0 ? j : initial_tiles.size() - 1 - j;
+          if (shard_of[t] == s) {
+            ordered_tiles.push_back(std::move(initial_tiles[t]));
+          }
+        }
+      }
+      logger.info("Shard {} of {} is assigned {} tiles",
+                  roofer_cfg_handler._shard_index, n_shards,
+                  std::ranges::count(shard_of,
+                                     roofer_cfg_handler._shard_index));
+      initial_tiles = std::move(ordered_tiles);
+    }
   }
   logger.debug("Created {} batch tile regions", initial_tiles.size());
 
@@ -708,6 +900,7 @@ int main(int argc, const char* argv[]) {
   std::atomic<size_t> reconstructed_started_cnt = 0;
   std::atomic<size_t> sorted_buildings_cnt = 0;
   std::atomic<size_t> serialized_buildings_cnt = 0;
+  std::atomic<size_t> scratch_capacity = 0;
   std::optional<std::thread> tracer_thread;
 
   std::thread reconstructor_thread;
@@ -722,6 +915,7 @@ int main(int argc, const char* argv[]) {
         logger.trace("heap", heap_allocation_counter.current_usage());
 #endif
         logger.trace("rss", GetCurrentRSS());
+        logger.trace("scratch", scratch_capacity);
         logger.trace("crop", cropped_buildings_cnt);
         logger.trace("reconstruct", reconstructed_buildings_cnt);
         logger.trace("sort", sorted_buildings_cnt);
@@ -739,6 +933,7 @@ int main(int argc, const char* argv[]) {
       logger.trace("heap", heap_allocation_counter.current_usage());
 #endif
       logger.trace("rss", GetCurrentRSS());
+      logger.trace("scratch", scratch_capacity);
       logger.trace("crop", cropped_buildings_cnt);
       logger.trace("reconstruct", reconstructed_buildings_cnt);
       logger.trace("sort", sorted_buildings_cnt);
@@ -746,27 +941,136 @@ int main(int argc, const char* argv[]) {
     });
   }
 
+  // Per-building output files are written asynchronously
+  OutputWriter output_writer(roofer_cfg.output_threads);
+
+  // The files that are written once for all tiles are written per shard
+  if (roofer_cfg_handler._shard_count != 0) {
+    for (auto* spec :
+         {&roofer_cfg.journal_file_spec, &roofer_cfg.failed_file_spec,
+          &roofer_cfg.manifest_file_spec, &roofer_cfg.metadata_json_file_spec,
+          &roofer_cfg.index_file_spec, &roofer_cfg.jsonl_list_file_spec}) {
+      *spec = shard::spec_for(*spec, roofer_cfg_handler._shard_index);
+    }
+  }
+
+  // Tiles are journaled once all of their output is written. The fingerprint
+  // ties the journal to the tiling and configuration of this run.
+  ContentHash fingerprint;
+  fingerprint.add(incremental::config_hash(roofer_cfg, input_pointclouds));
+  fingerprint.add(roofer_cfg.source_footprints).add(roofer_cfg.layer_name);
+  fingerprint.add(roofer_cfg.layer_id).add(roofer_cfg.attribute_filter);
+  fingerprint.add(roofer_cfg.write_crop_outputs);
+  fingerprint.add(roofer_cfg.write_tiled_crop_outputs);
+  fingerprint.add(roofer_cfg.write_index).add(roofer_cfg_handler._crop_only);
+  // in tile id order, shards order the tiles differently
+  std::vector<const BuildingTile*> tiles_by_id;
+  for (auto& building_tile : initial_tiles) {
+    tiles_by_id.push_back(&building_tile);
+  }
+  std::ranges::sort(tiles_by_id, {}, &BuildingTile::id);
+  for (auto* building_tile : tiles_by_id) {
+    fingerprint.add(building_tile->id);
+    fingerprint.add(building_tile->extent.pmin);
+    fingerprint.add(building_tile->extent.pmax);
+  }
+  Journal journal(fmt::format(fmt::runtime(roofer_cfg.journal_file_spec),
+                              fmt::arg("path", roofer_cfg.output_path)),
+                  fmt::format(fmt::runtime(roofer_cfg.failed_file_spec),
+                              fmt::arg("path", roofer_cfg.output_path)),
+                  fingerprint.value());
+
+  if (roofer_cfg_handler._merge_shards != 0) {
+    try {
+      size_t n_unfinished =
+          shard::merge(roofer_cfg, roofer_cfg_handler._merge_shards,
+                       fingerprint.value(), initial_tiles);
+      return n_unfinished == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& e) {
+      logger.error("{}", e.what());
+      return EXIT_FAILURE;
+    }
+  }
+
+  // An incremental run copies the unchanged buildings from the previous output
+  std::optional<incremental::Manifest> previous_manifest;
+  incremental::ManifestWriter manifest_writer;
+  // Shards claim a tile before cropping it
+  std::optional<shard::Claims> claims;
+  try {
+    if (roofer_cfg_handler._resume) {
+      size_t n_finished = journal.read();
+      std::erase_if(initial_tiles, [&journal](const BuildingTile& tile) {
+        return journal.is_finished(tile.id);
+      });
+      logger.info("Resuming, {} tiles were finished before, {} tiles to go",
+                  n_finished, initial_tiles.size());
+    }
+    if (roofer_cfg_handler._shard_count != 0) {
+      claims.emplace(fs::path(roofer_cfg.output_path) / "claims",
+                     roofer_cfg_handler._shard_index);
+      if (roofer_cfg_handler._resume) {
+        logger.info("Released {} claims of unfinished tiles",
+                    claims->release_unfinished(journal));
+      }
+    }
+    if (!roofer_cfg.incremental_from.empty()) {
+      previous_manifest.emplace();
+      previous_manifest->read(
+          fmt::format(fmt::runtime(roofer_cfg.manifest_file_spec),
+                      fmt::arg("path", roofer_cfg.incremental_from)),
+          roofer_cfg.incremental_from);
+      logger.info("Read {} features from the manifest of {}",
+                  previous_manifest->size(), roofer_cfg.incremental_from);
+    }
+    journal.open();
+    if (roofer_cfg.write_manifest && !roofer_cfg_handler._crop_only) {
+      manifest_writer.open(
+          fmt::format(fmt::runtime(roofer_cfg.manifest_file_spec),
+                      fmt::arg("path", roofer_cfg.output_path)),
+          roofer_cfg.output_path, roofer_cfg_handler._resume);
+    }
+  } catch (const std::exception& e) {
+    logger.error("{}", e.what());
+    return EXIT_FAILURE;
+  }
+
   // Process tiles
   std::thread cropper_thread([&]() {
     logger.debug("[cropper] Starting cropper");
     while (!initial_tiles.empty()) {
       auto& building_tile = initial_tiles.front();
+      bool claimed = false;
+      // a tile that failed is left to another shard or a resumed run
+      auto fail_tile = [&]() {
+        journal.fail_tile(building_tile.id, "crop");
+        if (claimed) claims->release(building_tile.id);
+      };
       try {
         // crop each tile
         logger.debug("[cropper] Cropping tile {}", building_tile);
         // crop_tile returns true if at least one building was cropped
-        if (!crop_tile(building_tile.extent,  // tile extent
+        if (claims && !(claimed = claims->claim(building_tile.id))) {
+          logger.debug("[cropper] Tile {} is claimed by another shard",
+                       building_tile.id);
+        } else if (!crop_tile(building_tile.extent,  // tile extent
                        input_pointclouds,     // input pointclouds
                        building_tile,         // output building data
                        roofer_cfg,            // configuration parameters
-                       project_srs.get())) {
+                       project_srs.get(),
+                       output_writer,
+                       previous_manifest ? &*previous_manifest : nullptr)) {
           logger.info("No footprints found in tile {}, skipping...",
                       building_tile.id);
+          journal.finish_tile(building_tile.id);
         } else {
           building_tile.buildings_cnt = building_tile.buildings.size();
           building_tile.buildings_progresses.resize(
               building_tile.buildings_cnt);
           std::ranges::fill(building_tile.buildings_progresses, CROP_SUCCEEDED);
+          if (roofer_cfg_handler._crop_only) {
+            journal.finish_tile(building_tile.id);
+          }
           {
             std::scoped_lock lock{cropped_tiles_mutex};
             cropped_buildings_cnt += building_tile.buildings_cnt;
@@ -777,8 +1081,13 @@ int main(int argc, const char* argv[]) {
               building_tile);
           cropped_pending.notify_one();
         }
+      } catch (const std::exception& e) {
+        logger.error("[cropper] Failed to crop tile {}. {}", building_tile,
+                     e.what());
+        fail_tile();
       } catch (...) {
         logger.error("[cropper] Failed to crop tile {}", building_tile);
+        fail_tile();
       }
       initial_tiles.pop_front();
     }
@@ -844,7 +1153,12 @@ int main(int argc, const char* argv[]) {
           reconstructor_pool.detach_task([bref = std::move(building_ref),
                                           &roofer_cfg, &reconstructed_buildings,
                                           &reconstructed_buildings_cnt,
-                                          &reconstructed_buildings_mutex] {
+                                          &reconstructed_buildings_mutex,
+                                          &scratch_capacity] {
+            // Each worker keeps its own reconstruction stages and scratch
+            // arena, which are reused for every building.
+            thread_local ReconstructionContext ctx;
+            thread_local size_t scratch_traced = 0;
             // TODO: It seems that I need to assign the moved 'building_ref' to
             // a
             //  new variable with an explicit type here, because 'bref' contains
@@ -857,7 +1171,11 @@ int main(int argc, const char* argv[]) {
               auto start = std::chrono::high_resolution_clock::now();
               logger.debug("[reconstructor] start: {}",
                            building_object_ref.building.jsonl_path.string());
-              reconstruct_building(building_object_ref.building, &roofer_cfg);
+              // unchanged buildings are copied from the previous output
+              if (!building_object_ref.building.previous_feature) {
+                reconstruct_building(building_object_ref.building, &roofer_cfg,
+                                     ctx);
+              }
               logger.debug("[reconstructor] finish: {}",
                            building_object_ref.building.jsonl_path.string());
               // TODO: These two seem to be redundant
@@ -880,6 +1198,9 @@ int main(int argc, const char* argv[]) {
               ++reconstructed_buildings_cnt;
               reconstructed_buildings.push_back(std::move(building_object_ref));
             }
+            ctx.scratch.release();
+            scratch_capacity += ctx.scratch.capacity() - scratch_traced;
+            scratch_traced = ctx.scratch.capacity();
           });
         }
       }
@@ -970,8 +1291,65 @@ int main(int argc, const char* argv[]) {
       logger.debug("[sorter] Finished sorter");
     });
 
+    // Serialisation has two steps per tile. First the buildings are encoded
+    // in parallel on the serializer pool, each into its own buffer; in
+    // split_cjseq mode each task also writes its own file. Then the encoded
+    // features are written to the tile file in the original order. This is a
+    // separate pool because the reconstructor pool has all cropped buildings
+    // queued up front, and encode tasks would have to wait behind them.
+    BS::thread_pool serializer_pool(nthreads_reconstructor_pool);
     serializer_thread = std::thread([&]() {
       logger.info("[serializer] Writing output to {}", roofer_cfg.output_path);
+      // A serialized tile is journaled once the output writer has written
+      // its per-building files, without waiting for these in the meantime.
+      // Its manifest entries are written at the same time, those of a
+      // per-building file only when that file was written.
+      struct UnjournaledTile {
+        struct Write {
+          std::string bid;
+          std::future<void> done;
+          // empty if the building is not in the manifest
+          std::string manifest_line;
+        };
+        size_t id;
+        std::vector<Write> writes;
+        std::vector<std::string> manifest_lines;
+        std::vector<std::pair<std::string, std::string>> failed;
+      };
+      std::deque<UnjournaledTile> unjournaled_tiles;
+      // the metadata file of split_cjseq output covers all tiles written so
+      // far, not only the last one
+      roofer::TBox<double> metadata_extent;
+      auto journal_tiles = [&](bool wait) {
+        while (!unjournaled_tiles.empty()) {
+          auto& tile = unjournaled_tiles.front();
+          if (!wait && std::ranges::any_of(tile.writes, [](auto& write) {
+                return write.done.wait_for(std::chrono::seconds(0)) !=
+                       std::future_status::ready;
+              })) {
+            break;
+          }
+          for (auto& write : tile.writes) {
+            try {
+              write.done.get();
+              if (!write.manifest_line.empty()) {
+                tile.manifest_lines.push_back(std::move(write.manifest_line));
+              }
+            } catch (const std::exception&) {
+              tile.failed.emplace_back(write.bid, "write");
+            }
+          }
+          // the manifest entries of a journaled tile must be on disk
+          if (manifest_writer.write(tile.manifest_lines)) {
+            journal.finish_tile(tile.id, tile.failed);
+          } else {
+            logger.error("[serializer] Failed to write the manifest entries "
+                         "of tile {}",
+                         tile.id);
+          }
+          unjournaled_tiles.pop_front();
+        }
+      };
       while (sorting_running.load() || !sorted_tiles.empty()) {
         logger.debug("[serializer] before lock sorted_tiles_mutex");
         std::unique_lock lock{sorted_tiles_mutex};
@@ -1004,50 +1382,81 @@ int main(int argc, const char* argv[]) {
           for (auto& building : building_tile.buildings) {
             attr_time.push_back(building.reconstruction_time);
           }
-          // output reconstructed buildings
-          auto CityJsonWriter =
-              roofer::io::createCityJsonWriter(*building_tile.proj_helper);
-          CityJsonWriter->written_features_count = serialized_buildings_cnt;
-          CityJsonWriter->identifier_attribute = roofer_cfg.id_attribute;
-          // user provided offset
-          if (roofer_cfg.cj_translate.has_value()) {
-            CityJsonWriter->translate_x_ = (*roofer_cfg.cj_translate)[0];
-            CityJsonWriter->translate_y_ = (*roofer_cfg.cj_translate)[1];
-            CityJsonWriter->translate_z_ = (*roofer_cfg.cj_translate)[2];
-            // auto offset from data
-          } else if (building_tile.proj_helper->data_offset.has_value()) {
-            CityJsonWriter->translate_x_ =
-                (*building_tile.proj_helper->data_offset)[0];
-            CityJsonWriter->translate_y_ =
-                (*building_tile.proj_helper->data_offset)[1];
-            CityJsonWriter->translate_z_ =
-                (*building_tile.proj_helper->data_offset)[2];
-          } else {
-            throw std::runtime_error(fmt::format(
-                "Tile {} has no data offset, cannot write to cityjson",
-                building_tile.id));
-          }
-          if (roofer_cfg.cj_scale.has_value()) {
-            CityJsonWriter->scale_x_ = (*roofer_cfg.cj_scale)[0];
-            CityJsonWriter->scale_y_ = (*roofer_cfg.cj_scale)[1];
-            CityJsonWriter->scale_z_ = (*roofer_cfg.cj_scale)[2];
-          } else {
-            CityJsonWriter->scale_x_ = 0.001;
-            CityJsonWriter->scale_y_ = 0.001;
-            CityJsonWriter->scale_z_ = 0.001;
+          // output reconstructed buildings, with one writer per pool thread
+          auto configure_writer = [&](auto& writer) {
+            writer->identifier_attribute = roofer_cfg.id_attribute;
+            // user provided offset
+            if (roofer_cfg.cj_translate.has_value()) {
+              writer->translate_x_ = (*roofer_cfg.cj_translate)[0];
+              writer->translate_y_ = (*roofer_cfg.cj_translate)[1];
+              writer->translate_z_ = (*roofer_cfg.cj_translate)[2];
+              // auto offset from data
+            } else if (building_tile.proj_helper->data_offset.has_value()) {
+              writer->translate_x_ =
+                  (*building_tile.proj_helper->data_offset)[0];
+              writer->translate_y_ =
+                  (*building_tile.proj_helper->data_offset)[1];
+              writer->translate_z_ =
+                  (*building_tile.proj_helper->data_offset)[2];
+            } else {
+              throw std::runtime_error(fmt::format(
+                  "Tile {} has no data offset, cannot write to cityjson",
+                  building_tile.id));
+            }
+            if (roofer_cfg.cj_scale.has_value()) {
+              writer->scale_x_ = (*roofer_cfg.cj_scale)[0];
+              writer->scale_y_ = (*roofer_cfg.cj_scale)[1];
+              writer->scale_z_ = (*roofer_cfg.cj_scale)[2];
+            } else {
+              writer->scale_x_ = 0.001;
+              writer->scale_y_ = 0.001;
+              writer->scale_z_ = 0.001;
+            }
+          };
+          // the json writer is also used for the metadata in binary output
+          const bool binary_output = roofer_cfg.output_format == "cjb";
+          std::vector<std::unique_ptr<roofer::io::CityJsonWriterInterface>>
+              writers;
+          std::vector<
+              std::unique_ptr<roofer::io::CityJsonBinaryWriterInterface>>
+              binary_writers;
+          for (size_t i = 0; i < serializer_pool.get_thread_count(); ++i) {
+            writers.push_back(
+                roofer::io::createCityJsonWriter(*building_tile.proj_helper));
+            configure_writer(writers.back());
+            if (binary_output) {
+              binary_writers.push_back(roofer::io::createCityJsonBinaryWriter(
+                  *building_tile.proj_helper));
+              configure_writer(binary_writers.back());
+            }
           }
 
           std::ofstream ofs;
+          fs::path tile_path;
           if (!roofer_cfg.split_cjseq) {
-            auto jsonl_tile_path =
-                fs::path(roofer_cfg.output_path) / "tiles" /
-                fmt::format("tile_{:05d}.city.jsonl", building_tile.id);
-            fs::create_directories(jsonl_tile_path.parent_path());
-            ofs.open(jsonl_tile_path);
-            if (!roofer_cfg.omit_metadata)
-              CityJsonWriter->write_metadata(
-                  ofs, project_srs.get(), building_tile.extent,
-                  {.identifier = std::to_string(building_tile.id)});
+            tile_path = fs::path(roofer_cfg.output_path) / "tiles" /
+                        fmt::format("tile_{:05d}.city.{}", building_tile.id,
+                                    binary_output ? "cjb" : "jsonl");
+            fs::create_directories(tile_path.parent_path());
+            if (binary_output) {
+              ofs.open(tile_path, std::ios::binary);
+              std::string metadata;
+              if (!roofer_cfg.omit_metadata) {
+                std::ostringstream metadata_stream;
+                writers.front()->write_metadata(
+                    metadata_stream, project_srs.get(), building_tile.extent,
+                    {.identifier = std::to_string(building_tile.id)});
+                metadata = metadata_stream.str();
+                if (metadata.ends_with('\n')) metadata.pop_back();
+              }
+              binary_writers.front()->write_header(ofs, metadata);
+            } else {
+              ofs.open(tile_path);
+              if (!roofer_cfg.omit_metadata)
+                writers.front()->write_metadata(
+                    ofs, project_srs.get(), building_tile.extent,
+                    {.identifier = std::to_string(building_tile.id)});
+            }
           } else {
             if (!roofer_cfg.omit_metadata) {
               std::string metadata_json_file =
@@ -1056,94 +1465,208 @@ int main(int argc, const char* argv[]) {
               fs::create_directories(
                   fs::path(metadata_json_file).parent_path());
               ofs.open(metadata_json_file);
-              CityJsonWriter->write_metadata(
-                  ofs, project_srs.get(), building_tile.extent,
+              metadata_extent.add(building_tile.extent);
+              writers.front()->write_metadata(
+                  ofs, project_srs.get(), metadata_extent,
                   {.identifier = std::to_string(building_tile.id)});
               ofs.close();
             }
           }
 
-          for (auto& building : building_tile.buildings) {
-            if (roofer_cfg.split_cjseq) {
-              fs::create_directories(building.jsonl_path.parent_path());
-              ofs.open(building.jsonl_path);
-            }
+          // Encode the buildings in parallel. Features without an
+          // identifier attribute are numbered in tile order, continuing from
+          // the buildings that were serialized before this tile.
+          const auto& n = roofer_cfg.n;
+          const size_t feature_id_offset = serialized_buildings_cnt;
+          std::vector<std::optional<std::string>> features(
+              building_tile.buildings.size());
+          std::vector<std::future<void>> writes(
+              roofer_cfg.split_cjseq ? building_tile.buildings.size() : 0);
+          std::vector<std::string> manifest_lines(
+              roofer_cfg.split_cjseq ? building_tile.buildings.size() : 0);
+          auto encode_building = [&](size_t i) {
+            auto& building = building_tile.buildings[i];
+            const size_t thread_index = *BS::this_thread::get_index();
             try {
-              auto attrow = roofer::AttributeMapRow(building_tile.attributes,
-                                                    building.attribute_index);
-
-              attrow.insert(roofer_cfg.n["h_ground"], building.h_ground);
-              attrow.insert(roofer_cfg.n["is_glass_roof"],
-                            building.is_glass_roof);
-              attrow.insert(roofer_cfg.n["pointcloud_unusable"],
-                            building.pointcloud_insufficient);
-              attrow.insert(roofer_cfg.n["roof_type"], building.roof_type);
-              attrow.insert_optional(roofer_cfg.n["h_roof_50p"],
-                                     building.roof_elevation_50p);
-              attrow.insert_optional(roofer_cfg.n["h_roof_70p"],
-                                     building.roof_elevation_70p);
-              attrow.insert_optional(roofer_cfg.n["h_roof_min"],
-                                     building.roof_elevation_min);
-              attrow.insert_optional(roofer_cfg.n["h_roof_max"],
-                                     building.roof_elevation_max);
-              attrow.insert_optional(roofer_cfg.n["roof_n_planes"],
-                                     building.roof_n_planes);
-              attrow.insert(roofer_cfg.n["extrusion_mode"],
-                            building.extrusion_mode);
-
-              std::unordered_map<int, roofer::Mesh>* ms12 = nullptr;
-              std::unordered_map<int, roofer::Mesh>* ms13 = nullptr;
-              std::unordered_map<int, roofer::Mesh>* ms22 = nullptr;
-              if (roofer_cfg.rec.lod == 0 || roofer_cfg.rec.lod == 12) {
-                ms12 = &building.multisolids_lod12;
-                attrow.insert_optional(roofer_cfg.n["rmse_lod12"],
-                                       building.rmse_lod12);
-                attrow.insert_optional(roofer_cfg.n["volume_lod12"],
-                                       building.volume_lod12);
+              std::string feature;
+              if (building.previous_feature) {
+                // unchanged since the previous run, copied as is
+                feature = previous_manifest->read_feature(
+                    *building.previous_feature);
+              } else {
+                auto attrow = roofer::AttributeMapRow(building_tile.attributes,
+                                                      building.attribute_index);
+
+                attrow.insert(n.at("h_ground"), building.h_ground);
+                attrow.insert(n.at("is_glass_roof"), building.is_glass_roof);
+                attrow.insert(n.at("pointcloud_unusable"),
+                              building.pointcloud_insufficient);
+                attrow.insert(n.at("roof_type"), building.roof_type);
+                attrow.insert_optional(n.at("h_roof_50p"),
+                                       building.roof_elevation_50p);
+                attrow.insert_optional(n.at("h_roof_70p"),
+                                       building.roof_elevation_70p);
+                attrow.insert_optional(n.at("h_roof_min"),
+                                       building.roof_elevation_min);
+                attrow.insert_optional(n.at("h_roof_max"),
+                                       building.roof_elevation_max);
+                attrow.insert_optional(n.at("roof_n_planes"),
+                                       building.roof_n_planes);
+                attrow.insert(n.at("extrusion_mode"), building.extrusion_mode);
+
+                std::unordered_map<int, roofer::Mesh>* ms12 = nullptr;
+                std::unordered_map<int, roofer::Mesh>* ms13 = nullptr;
+                std::unordered_map<int, roofer::Mesh>* ms22 = nullptr;
+                if (roofer_cfg.rec.lod == 0 || roofer_cfg.rec.lod == 12) {
+                  ms12 = &building.multisolids_lod12;
+                  attrow.insert_optional(n.at("rmse_lod12"),
+                                         building.rmse_lod12);
+                  attrow.insert_optional(n.at("volume_lod12"),
+                                         building.volume_lod12);
 #if RF_USE_VAL3DITY
-                attrow.insert_optional(roofer_cfg.n["val3dity_lod12"],
-                                       building.val3dity_lod12);
+                  attrow.insert_optional(n.at("val3dity_lod12"),
+                                         building.val3dity_lod12);
 #endif
-              }
-              if (roofer_cfg.rec.lod == 0 || roofer_cfg.rec.lod == 13) {
-                ms13 = &building.multisolids_lod13;
-                attrow.insert_optional(roofer_cfg.n["rmse_lod13"],
-                                       building.rmse_lod13);
-                attrow.insert_optional(roofer_cfg.n["volume_lod13"],
-                                       building.volume_lod13);
+                }
+                if (roofer_cfg.rec.lod == 0 || roofer_cfg.rec.lod == 13) {
+                  ms13 = &building.multisolids_lod13;
+                  attrow.insert_optional(n.at("rmse_lod13"),
+                                         building.rmse_lod13);
+                  attrow.insert_optional(n.at("volume_lod13"),
+                                         building.volume_lod13);
 #if RF_USE_VAL3DITY
-                attrow.insert_optional(roofer_cfg.n["val3dity_lod13"],
-                                       building.val3dity_lod13);
+                  attrow.insert_optional(n.at("val3dity_lod13"),
+                                         building.val3dity_lod13);
 #endif
-              }
-              if (roofer_cfg.rec.lod == 0 || roofer_cfg.rec.lod == 22) {
-                ms22 = &building.multisolids_lod22;
-                attrow.insert_optional(roofer_cfg.n["rmse_lod22"],
-                                       building.rmse_lod22);
-                attrow.insert_optional(roofer_cfg.n["volume_lod22"],
-                                       building.volume_lod22);
+                }
+                if (roofer_cfg.rec.lod == 0 || roofer_cfg.rec.lod == 22) {
+                  ms22 = &building.multisolids_lod22;
+                  attrow.insert_optional(n.at("rmse_lod22"),
+                                         building.rmse_lod22);
+                  attrow.insert_optional(n.at("volume_lod22"),
+                                         building.volume_lod22);
 #if RF_USE_VAL3DITY
-                attrow.insert_optional(roofer_cfg.n["val3dity_lod22"],
-                                       building.val3dity_lod22);
+                  attrow.insert_optional(n.at("val3dity_lod22"),
+                                         building.val3dity_lod22);
 #endif
+                }
+                if (binary_output) {
+                  binary_writers[thread_index]->encode_feature(
+                      feature, building.footprint, ms12, ms13, ms22, attrow,
+                      feature_id_offset + i + 1);
+                } else {
+                  writers[thread_index]->encode_feature(
+                      feature, building.footprint, ms12, ms13, ms22, attrow,
+                      feature_id_offset + i + 1);
+                }
               }
-              CityJsonWriter->write_feature(ofs, building.footprint, ms12, ms13,
-                                            ms22, attrow);
+              // failed buildings are not in the manifest, so that they are
+              // tried again in the next incremental run
+              const bool add_to_manifest =
+                  roofer_cfg.write_manifest &&
+                  building_tile.buildings_progresses[i] ==
+                      RECONSTRUCTION_SUCCEEDED;
               if (roofer_cfg.split_cjseq) {
-                ofs.close();
+                // every building has its own file, these are handed to the
+                // output writer
+                if (binary_output) {
+                  // the metadata is in the metadata json file
+                  std::ostringstream header;
+                  binary_writers[thread_index]->write_header(header);
+                  auto path =
+                      fs::path(building.jsonl_path).replace_extension(".cjb");
+                  if (add_to_manifest) {
+                    manifest_lines[i] = manifest_writer.line(
+                        building.bid, building.content_hash, path,
+                        header.tellp(), feature.size());
+                  }
+                  writes[i] = output_writer.write_file(
+                      path, header.str() + feature,
+                      std::ios::out | std::ios::binary);
+                } else {
+                  if (add_to_manifest) {
+                    manifest_lines[i] = manifest_writer.line(
+                        building.bid, building.content_hash,
+                        building.jsonl_path, 0, feature.size());
+                  }
+                  writes[i] = output_writer.write_file(building.jsonl_path,
+                                                       std::move(feature));
+                }
+                ++serialized_buildings_cnt;
+              } else {
+                features[i] = std::move(feature);
               }
-              ++serialized_buildings_cnt;
             } catch (const std::exception& e) {
               logger.error("[serializer] Failed to serialize {}. {}",
                            building.jsonl_path.string(), e.what());
             }
-          }
+          };
+          serializer_pool
+              .submit_loop(size_t(0), building_tile.buildings.size(),
+                           encode_building)
+              .wait();
+
+          // Commit the encoded features to the tile file in the original
+          // order
+          UnjournaledTile unjournaled{.id = building_tile.id};
           if (!roofer_cfg.split_cjseq) {
+            for (size_t i = 0; i < features.size(); ++i) {
+              auto& feature = features[i];
+              if (!feature.has_value()) continue;
+              auto& building = building_tile.buildings[i];
+              if (roofer_cfg.write_manifest &&
+                  building_tile.buildings_progresses[i] ==
+                      RECONSTRUCTION_SUCCEEDED) {
+                unjournaled.manifest_lines.push_back(
+                    manifest_writer.line(building.bid, building.content_hash,
+                                         tile_path, ofs.tellp(),
+                                         feature->size()));
+              }
+              ofs.write(feature->data(), feature->size());
+              ++serialized_buildings_cnt;
+            }
             ofs.close();
           }
+
+          // List the failed buildings, and journal the tile when its output
+          // is complete
+          auto id_vec = building_tile.attributes.get_if<std::string>(
+              roofer_cfg.id_attribute);
+          auto building_id = [&](const BuildingObject& building) {
+            if (!building.bid.empty()) return building.bid;
+            if (id_vec && (*id_vec)[building.attribute_index].has_value()) {
+              return *(*id_vec)[building.attribute_index];
+            }
+            return std::to_string(building.attribute_index);
+          };
+          for (size_t i = 0; i < building_tile.buildings.size(); ++i) {
+            auto& building = building_tile.buildings[i];
+            if (building_tile.buildings_progresses[i] ==
+                RECONSTRUCTION_FAILED) {
+              unjournaled.failed.emplace_back(building_id(building),
+                                              "reconstruct");
+            }
+            if (roofer_cfg.split_cjseq ? !writes[i].valid()
+                                       : !features[i].has_value()) {
+              unjournaled.failed.emplace_back(building_id(building),
+                                              "serialize");
+            } else if (roofer_cfg.split_cjseq) {
+              unjournaled.writes.push_back({building_id(building),
+                                            std::move(writes[i]),
+                                            std::move(manifest_lines[i])});
+            }
+          }
+          if (!roofer_cfg.split_cjseq && !ofs) {
+            logger.error("[serializer] Failed to write {}",
+                         tile_path.string());
+          } else {
+            unjournaled_tiles.push_back(std::move(unjournaled));
+          }
+          journal_tiles(false);
           pending_serialized.pop_front();
         }
       }
+      journal_tiles(true);
       serialization_running.store(false);
       logger.debug("[serializer] Finished serializer");
     });
@@ -1153,6 +1676,8 @@ int main(int argc, const char* argv[]) {
   }
 
   cropper_thread.join();
+  output_writer.wait();
+  manifest_writer.close();
 
   if (tracer_thread.has_value()) {
     tracer_thread->join();
@@ -0,0 +1,252 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+/**
+ * @brief Processing one region of interest with several roofer processes
+ *
+ * Each process gets a shard index i of N. All processes compute the same
+ * tiles and assign them to the shards, largest tiles first to the shard with
+ * the fewest footprints so far. A process first does the tiles of its own
+ * shard and then those of the other shards, so that processes that finish
+ * early take over work from slower ones.
+ *
+ * Before a tile is cropped it is claimed by creating a claim file with
+ * exclusive create, which only one process can do. The processes only share
+ * the output directory, no other communication is needed.
+ *
+ * The files that a run writes once for all tiles, like the journal and the
+ * manifest, are written per shard and combined afterwards with --merge.
+ */
+namespace shard {
+
+  // The spec of a file that is written per shard, eg. {path}/journal.txt
+  // becomes {path}/journal.shard2.txt
+  inline std::string spec_for(const std::string& spec, size_t index) {
+    fs::path path(spec);
+    path.replace_extension(
+        fmt::format(".shard{}{}", index, path.extension().string()));
+    return path.string();
+  }
+
+  // Shard of each tile, given the number of footprints per tile
+  inline std::vector<size_t> assign(const std::vector<size_t>& counts,
+                                    size_t n_shards) {
+    std::vector<size_t> order(counts.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&counts](size_t a, size_t b) {
+      return counts[a] > counts[b];
+    });
+    std::vector<size_t> load(n_shards, 0);
+    std::vector<size_t> shard_of(counts.size());
+    for (auto tile : order) {
+      auto least = std::min_element(load.begin(), load.end()) - load.begin();
+      shard_of[tile] = least;
+      // empty tiles are spread as well
+      load[least] += counts[tile] + 1;
+    }
+    return shard_of;
+  }
+
+  // Removes the claims in dir on the tiles that are not finished in journal,
+  // those of one shard or of all shards, returns the number of removed claims
+  inline size_t release_unfinished(const fs::path& dir, Journal& journal,
+                                   std::optional<size_t> index) {
+    if (!fs::is_directory(dir)) return 0;
+    size_t n_released = 0;
+    for (auto& entry : fs::directory_iterator(dir)) {
+      auto& claim_path = entry.path();
+      if (claim_path.extension() != ".claim") continue;
+      if (index) {
+        std::ifstream ifs(claim_path);
+        size_t claim_index;
+        if (!(ifs >> claim_index) || claim_index != *index) continue;
+      }
+      // tile_<id>.claim
+      size_t tile_id = std::stoull(claim_path.stem().string().substr(5));
+      if (!journal.is_finished(tile_id)) {
+        fs::remove(claim_path);
+        ++n_released;
+      }
+    }
+    return n_released;
+  }
+
+  /**
+   * @brief Claim files of the tiles in a shared output directory
+   */
+  class Claims {
+    fs::path dir_;
+    size_t index_;
+
+    fs::path path(size_t tile_id) const {
+      return dir_ / fmt::format("tile_{:05d}.claim", tile_id);
+    }
+
+   public:
+    Claims(fs::path dir, size_t index) : dir_(std::move(dir)), index_(index) {
+      fs::create_directories(dir_);
+    }
+
+    // Claims a tile for this shard, false if another shard was first
+    bool claim(size_t tile_id) {
+      auto claim_path = path(tile_id);
+      std::FILE* file = std::fopen(claim_path.string().c_str(), "wx");
+      if (file == nullptr) {
+        if (fs::exists(claim_path)) return false;
+        throw std::runtime_error("Failed to create " + claim_path.string());
+      }
+      auto content = fmt::format("{}\n", index_);
+      std::fwrite(content.data(), 1, content.size(), file);
+      std::fclose(file);
+      return true;
+    }
+
+    // Removes the claim of this shard on a tile that it failed to do, so that
+    // another shard can try it. Does not throw.
+    void release(size_t tile_id) {
+      std::error_code ec;
+      fs::remove(path(tile_id), ec);
+      if (ec) {
+        roofer::logger::Logger::get_logger().error(
+            "Failed to release the claim on tile {}. {}", tile_id,
+            ec.message());
+      }
+    }
+
+    // Removes the claims that this shard left on tiles it did not finish,
+    // returns the number of removed claims
+    size_t release_unfinished(Journal& journal) {
+      return shard::release_unfinished(dir_, journal, index_);
+    }
+  };
+
+  // Concatenates the lines of the per shard text files into path, the header
+  // lines starting with '#' are taken from the first file only
+  inline void concatenate(const fs::path& path,
+                          const std::vector<fs::path>& shard_paths) {
+    std::ofstream ofs(path);
+    bool first = true;
+    for (auto& shard_path : shard_paths) {
+      std::ifstream ifs(shard_path);
+      if (!ifs) continue;
+      std::string line;
+      while (std::getline(ifs, line)) {
+        if (!first && line.starts_with('#')) continue;
+        ofs << line << '\n';
+      }
+      first = false;
+    }
+    ofs.close();
+    if (!ofs) throw std::runtime_error("Failed to write " + path.string());
+  }
+
+  // Writes the metadata file of the merged output, that of the first shard
+  // that wrote one with the union of the geographicalExtent of all shards
+  inline void merge_metadata(const fs::path& path,
+                             const std::vector<fs::path>& shard_paths) {
+    nlohmann::json merged;
+    for (auto& shard_path : shard_paths) {
+      std::ifstream ifs(shard_path);
+      if (!ifs) continue;
+      auto metadata = nlohmann::json::parse(ifs);
+      if (merged.is_null()) {
+        merged = std::move(metadata);
+        continue;
+      }
+      auto& extent = metadata.at("metadata").at("geographicalExtent");
+      auto& merged_extent = merged.at("metadata").at("geographicalExtent");
+      for (size_t i = 0; i < 3; ++i) {
+        merged_extent[i] = std::min(merged_extent[i].get<double>(),
+                                    extent[i].get<double>());
+        merged_extent[i + 3] = std::max(merged_extent[i + 3].get<double>(),
+                                        extent[i + 3].get<double>());
+      }
+    }
+    if (merged.is_null()) return;
+    std::ofstream ofs(path);
+    ofs << merged << '\n';
+    ofs.close();
+    if (!ofs) throw std::runtime_error("Failed to write " + path.string());
+  }
+
+  /**
+   * @brief Combines the per shard files into the files of an unsharded run
+   *
+   * The journals, lists of failed buildings and manifests are combined. The
+   * metadata file is that of the first shard that wrote one, with the
+   * geographicalExtent of all shards. Index files and crop feature lists are
+   * left per shard.
+   *
+   * The claims on tiles that no shard finished are stale once all shards
+   * have stopped, eg. those of a shard that crashed. They are removed, so
+   * that a shard that is run again with --resume does these tiles.
+   *
+   * @return the number of tiles that no shard finished
+   */
+  inline size_t merge(const RooferConfig& cfg, size_t n_shards,
+                      uint64_t fingerprint,
+                      const std::deque<BuildingTile>& tiles) {
+    auto& logger = roofer::logger::Logger::get_logger();
+    auto file = [&cfg](const std::string& spec) {
+      return fs::path(fmt::format(fmt::runtime(spec),
+                                  fmt::arg("path", cfg.output_path)));
+    };
+    auto shard_files = [&](const std::string& spec) {
+      std::vector<fs::path> paths;
+      for (size_t i = 0; i < n_shards; ++i) {
+        paths.push_back(file(spec_for(spec, i)));
+      }
+      return paths;
+    };
+
+    Journal journal(file(cfg.journal_file_spec), file(cfg.failed_file_spec),
+                    fingerprint);
+    auto journals = shard_files(cfg.journal_file_spec);
+    auto failed = shard_files(cfg.failed_file_spec);
+    for (size_t i = 0; i < n_shards; ++i) {
+      journal.read(journals[i], failed[i]);
+    }
+    journal.write();
+
+    if (cfg.write_manifest) {
+      concatenate(file(cfg.manifest_file_spec),
+                  shard_files(cfg.manifest_file_spec));
+    }
+    merge_metadata(file(cfg.metadata_json_file_spec),
+                   shard_files(cfg.metadata_json_file_spec));
+
+    size_t n_unfinished = 0;
+    for (auto& tile : tiles) {
+      if (!journal.is_finished(tile.id)) {
+        logger.warning("Tile {} was not finished by any shard", tile.id);
+        ++n_unfinished;
+      }
+    }
+    if (size_t n_released = release_unfinished(
+            fs::path(cfg.output_path) / "claims", journal, std::nullopt)) {
+      logger.info("Released {} claims of unfinished tiles", n_released);
+    }
+    logger.info("Merged {} shards, {} of {} tiles are finished", n_shards,
+                tiles.size() - n_unfinished, tiles.size());
+    return n_unfinished;
+  }
+
+}  // namespace shard
@@ -0,0 +1,255 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace roofer::cjb {
+
+  /*
+   * Binary CityJSON feature stream
+   *
+   * A compact, length prefixed alternative to CityJSONSeq that can be read
+   * without parsing: every feature is a set of flat, aligned arrays that are
+   * used in place from a memory mapped file. All values are little endian.
+   *
+   * file    := FileHeader, metadata (padded to 8 bytes), record*
+   * record  := uint64 size, FeatureHeader, columns (size bytes in total)
+   *
+   * metadata holds the CityJSON metadata object as json text, it may be
+   * empty. Each column of a feature starts on an 8 byte boundary and is
+   * located by a Column in the FeatureHeader, with offsets relative to the
+   * start of the FeatureHeader. Records can be appended to a file without
+   * touching the rest of it.
+   *
+   * The geometry is stored like the CityJSON boundaries, flattened:
+   * a geometry is a range of surfaces, a surface a range of rings (exterior
+   * first) and a ring a range of vertex indices. Solids have only an
+   * exterior shell. Semantic surface objects are stored per geometry and
+   * every surface refers to one of them (or none). Attributes are stored for
+   * CityObjects and for semantic surfaces, sorted by key.
+   */
+
+  static_assert(std::endian::native == std::endian::little,
+                "Binary CityJSON is only supported on little endian systems");
+
+  inline constexpr std::array<char, 8> magic = {'R', 'F', 'C', 'J',
+                                                'B', 'I', 'N', '\0'};
+  inline constexpr uint32_t version = 1;
+
+  // location of an array in a feature, offset in bytes from the start of
+  // the FeatureHeader
+  struct Column {
+    uint32_t offset = 0;
+    uint32_t count = 0;
+  };
+
+  // range of elements in another array
+  struct Span {
+    uint32_t first = 0;
+    uint32_t count = 0;
+  };
+
+  // string in the strings column
+  struct StringRef {
+    uint32_t offset = 0;
+    uint32_t size = 0;
+  };
+
+  struct FileHeader {
+    std::array<char, 8> magic = cjb::magic;
+    uint32_t version = cjb::version;
+    // size of the metadata json that follows the header, without padding
+    uint32_t metadata_size = 0;
+    std::array<double, 3> scale = {1., 1., 1.};
+    std::array<double, 3> translate = {0., 0., 0.};
+  };
+
+  enum class ObjectType : uint32_t { Building = 0, BuildingPart = 1 };
+  enum class GeometryType : uint32_t { MultiSurface = 0, Solid = 1 };
+  enum class SemanticType : uint32_t {
+    GroundSurface = 0,
+    WallSurface = 1,
+    RoofSurface = 2
+  };
+  enum class AttributeType : uint32_t {
+    Null = 0,
+    Bool = 1,
+    Int = 2,
+    Float = 3,
+    String = 4
+  };
+
+  struct ObjectRecord {
+    StringRef id;
+    ObjectType type;
+    // index of the parent object in the feature, -1 if there is none
+    int32_t parent;
+    Span geometries;
+    Span attributes;
+  };
+
+  struct GeometryRecord {
+    GeometryType type;
+    uint32_t reserved = 0;
+    StringRef lod;
+    Span surfaces;
+    Span semantics;
+  };
+
+  struct SurfaceRecord {
+    Span rings;
+    // index in the semantics span of the geometry, -1 if there is none
+    int32_t semantic;
+  };
+
+  struct SemanticRecord {
+    SemanticType type;
+    Span attributes;
+  };
+
+  struct AttributeRecord {
+    StringRef key;
+    AttributeType type;
+    uint32_t reserved = 0;
+    union {
+      int64_t int_value;
+      double float_value;
+      StringRef string_value;
+    };
+  };
+
+  struct FeatureHeader {
+    StringRef id;
+    Column strings;
+    Column vertices;
+    Column objects;
+    Column geometries;
+    Column surfaces;
+    Column rings;
+    Column indices;
+    Column semantics;
+    Column attributes;
+  };
+
+  using Vertex = std::array<int32_t, 3>;
+
+  static_assert(sizeof(FileHeader) == 64);
+  static_assert(sizeof(ObjectRecord) == 32);
+  static_assert(sizeof(GeometryRecord) == 32);
+  static_assert(sizeof(SurfaceRecord) == 12);
+  static_assert(sizeof(SemanticRecord) == 12);
+  static_assert(sizeof(AttributeRecord) == 24);
+  static_assert(sizeof(FeatureHeader) == 80);
+
+  /**
+   * @brief View on one feature in a binary CityJSON buffer
+   *
+   * Does not own any data; it is valid for as long as the buffer it points
+   * into.
+   */
+  class FeatureView {
+    const std::byte* data_ = nullptr;
+
+    template <typename T>
+    std::span<const T> column(const Column& c) const {
+      return {reinterpret_cast<const T*>(data_ + c.offset), c.count};
+    }
+
+   public:
+    FeatureView() = default;
+    explicit FeatureView(const std::byte* data) : data_(data){};
+
+    const FeatureHeader& header() const {
+      return *reinterpret_cast<const FeatureHeader*>(data_);
+    }
+
+    std::string_view string(const StringRef& s) const {
+      return {reinterpret_cast<const char*>(data_ + header().strings.offset) +
+                  s.offset,
+              s.size};
+    }
+    std::string_view id() const { return string(header().id); }
+
+    std::span<const Vertex> vertices() const {
+      return column<Vertex>(header().vertices);
+    }
+    std::span<const ObjectRecord> objects() const {
+      return column<ObjectRecord>(header().objects);
+    }
+    std::span<const GeometryRecord> geometries() const {
+      return column<GeometryRecord>(header().geometries);
+    }
+    std::span<const SurfaceRecord> surfaces() const {
+      return column<SurfaceRecord>(header().surfaces);
+    }
+    std::span<const Span> rings() const {
+      return column<Span>(header().rings);
+    }
+    std::span<const uint32_t> indices() const {
+      return column<uint32_t>(header().indices);
+    }
+    std::span<const SemanticRecord> semantics() const {
+      return column<SemanticRecord>(header().semantics);
+    }
+    std::span<const AttributeRecord> attributes() const {
+      return column<AttributeRecord>(header().attributes);
+    }
+
+    // elements of one of the arrays above selected by a Span
+    template <typename T>
+    static std::span<const T> select(std::span<const T> all, const Span& s) {
+      return all.subspan(s.first, s.count);
+    }
+  };
+
+  /**
+   * @brief Reader for binary CityJSON files
+   *
+   * The file is memory mapped and the features are accessed in place.
+   */
+  struct ReaderInterface {
+    virtual ~ReaderInterface() = default;
+
+    // throws a rooferException when the file is not a binary CityJSON file
+    // or a feature in it is truncated or refers outside of its record
+    virtual void open(const std::string& path) = 0;
+    virtual void close() = 0;
+
+    virtual const FileHeader& header() const = 0;
+    // the CityJSON metadata object as json text, empty if there was none
+    virtual std::string_view metadata() const = 0;
+
+    virtual size_t size() const = 0;
+    virtual FeatureView feature(size_t i) const = 0;
+  };
+
+  std::unique_ptr<ReaderInterface> createReader();
+
+}  // namespace roofer::cjb
@@ -0,0 +1,73 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#pragma once
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+namespace roofer {
+
+  /**
+   * @brief Thrown by a stage that is still running when its deadline passed
+   */
+  struct DeadlineExceeded : std::runtime_error {
+    using std::runtime_error::runtime_error;
+  };
+
+  /**
+   * @brief Wall time budget that long running stages check in their loops
+   *
+   * The stages take a pointer to a deadline in their config and call check()
+   * once per iteration of their outer loops, which throws DeadlineExceeded
+   * when the budget is spent. The clock is read only every 64 checks, so
+   * that the checks are cheap enough for tight loops.
+   *
+   * A deadline is not thread safe; use one per building.
+   */
+  class Deadline {
+    using clock = std::chrono::steady_clock;
+    clock::time_point end_;
+    mutable unsigned countdown_ = 0;
+
+   public:
+    explicit Deadline(std::chrono::milliseconds budget)
+        : end_(clock::now() + budget) {}
+
+    bool expired() const { return clock::now() >= end_; }
+
+    /**
+     * @brief Throws DeadlineExceeded if the deadline has passed
+     *
+     * @param stage Name of the stage, used in the exception message
+     */
+    void check(const char* stage) const {
+      if (countdown_-- != 0) return;
+      countdown_ = 63;
+      if (expired()) {
+        throw DeadlineExceeded(std::string(stage) +
+                               " exceeded the time limit");
+      }
+    }
+  };
+
+}  // namespace roofer
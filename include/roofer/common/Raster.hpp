@@ -25,11 +25,14 @@
 #include <array>
 #include <cfloat>
 #include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <vector>
 
+#include <roofer/common/common.hpp>
+
 // #include <gdal_priv.h>
 // #include <cpl_string.h>
 // #include <cpl_conv.h>
@@ -37,14 +40,26 @@
 namespace roofer {
   namespace RasterTools {
     enum alg { MIN, MAX, ZERO };
+    /**
+     * A simple row-major raster with one float value band and an optional set
+     * of uint16 count bands.
+     *
+     * The values and the counts are each stored in a single contiguous
+     * buffer. The count bands are stored band after band, ie. the counts of
+     * band b start at b * dimx_ * dimy_. The raster is cheap to move, copies
+     * are deep copies.
+     */
     class Raster {
      public:
       typedef std::array<float, 3> point3d;
       typedef std::array<float, 2> point2d;
+      typedef uint16_t count_t;
       Raster(double cellsize, double min_x, double max_x, double min_y,
-             double max_y);
-      Raster(const Raster &);
-      void operator=(const Raster &r);
+             double max_y, size_t n_count_bands = 0);
+      Raster(const Raster &) = default;
+      Raster(Raster &&) noexcept = default;
+      Raster &operator=(const Raster &) = default;
+      Raster &operator=(Raster &&) noexcept = default;
       Raster(){};
       ~Raster(){};
       /**
@@ -54,6 +69,25 @@ namespace roofer {
        */
       void prefill_arrays(alg a);
       bool add_point(double x, double y, double z, alg a);
+      /**
+       * Composites a value into the cell at the given col and row, without
+       * converting from world coordinates.
+       * @param[in] col column of the cell
+       * @param[in] row row of the cell
+       * @param[in] z value to be composited
+       * @param[in] a compositing method: MIN or MAX
+       * @return True if the cell was nodata before this call.
+       */
+      bool add_cell_value(size_t col, size_t row, double z, alg a) {
+        float &v = vals_[col + row * dimx_];
+        bool first = v == noDataVal_;
+        if (a == MIN) {
+          if (v > z) v = z;
+        } else if (a == MAX) {
+          if (v < z) v = z;
+        }
+        return first;
+      }
       /**
        * Adds a value to the raster at the specified x and y coordinates.
        * @param[in] x x coordinate of the point
@@ -106,43 +140,81 @@ namespace roofer {
       bool isNoData(double &x, double &y);
       void set_nodata(double new_nodata_val);
       void fill_nn(size_t window_size);
+
+      /**
+       * Increments the count at the given x and y coordinates in the given
+       * count band. Counts saturate at the maximum value of count_t.
+       * @param[in] x x coordinate of the point
+       * @param[in] y y coordinate of the point
+       * @param[in] band index of the count band
+       */
+      void add_count(double x, double y, size_t band = 0);
+      count_t get_count(size_t col, size_t row, size_t band = 0) const {
+        return counts_[band * dimx_ * dimy_ + col + row * dimx_];
+      }
+      /**
+       * Returns a pointer to the first cell of the given count band.
+       */
+      const count_t *count_band(size_t band = 0) const {
+        return counts_.data() + band * dimx_ * dimy_;
+      }
+      size_t n_count_bands() const { return n_count_bands_; }
+
+      /**
+       * Converts the value band to an Image. The raster is moved from, so the
+       * values are not copied.
+       */
+      Image to_image() &&;
       // void write(const char* WKGCS, alg a, void * dataPtr, const char*
       // outFile);
 
-      // rasterise a polygon and return a list with points - one in the center
-      // of each pixel inside the polygon in the polygon first point is *not*
-      // repeated as last T should be a vector of arr<float,2> or arr<float,3>
-      template <typename T>
-      std::vector<point3d> rasterise_polygon(T &polygon,
-                                             std::array<double, 2> cr_min,
-                                             std::array<double, 2> cr_max,
-                                             bool returnNoData = true) const {
+      /**
+       * Rasterise a polygon and call a visitor for each cell whose center
+       * lies inside the polygon. The polygon first point is *not* repeated as
+       * last. T should be a vector of arr<float,2> or arr<float,3>.
+       *
+       * This avoids materialising a list of cell center points when the
+       * caller only needs to write into the raster.
+       *
+       * @param[in] polygon the polygon to rasterise
+       * @param[in] cr_min minimal col/row coordinate to consider
+       * @param[in] cr_max maximal col/row coordinate to consider
+       * @param[in] visit callable with signature (size_t col, size_t row,
+       * float x, float y), where x and y are the coordinates of the cell
+       * center
+       */
+      template <typename T, typename Visitor>
+      void visit_polygon_cells(T &polygon, std::array<double, 2> cr_min,
+                               std::array<double, 2> cr_max,
+                               Visitor &&visit) const {
         // code adapted from http://alienryderflex.com/polygon_fill/
         int n_nodes, pixelX, pixelY, i, j, swap;
         int n_vertices = polygon.size();
-        std::vector<point3d> result;
 
         // perhaps we can specialise these to the bounding box of the polygon
         int IMAGE_TOP = std::floor(cr_min[1]), IMAGE_BOT = std::ceil(cr_max[1]),
             IMAGE_LEFT = std::ceil(cr_min[0]),
             IMAGE_RIGHT = std::floor(cr_max[0]);
 
+        // vector to hold the x-coordinates where the scanline intersects the
+        // polygon
+        std::vector<int> intersect_x;
+        // polygon vertices in col/row coordinates, computed once
+        std::vector<std::array<double, 2>> cr(n_vertices);
+        for (i = 0; i < n_vertices; i++) {
+          cr[i] = getColRowCoord((double)polygon[i][0], (double)polygon[i][1]);
+        }
+
         // Loop through the rows of the image.
         for (pixelY = IMAGE_TOP; pixelY < IMAGE_BOT; pixelY++) {
-          std::vector<int>
-              intersect_x;  // vector to hold the x-coordinates where the
-                            // scanline intersects the polygon
+          intersect_x.clear();
 
           // Build a list of nodes.
           n_nodes = 0;
           j = n_vertices - 1;
           for (i = 0; i < n_vertices; i++) {
-            auto pi =
-                getColRowCoord((double)polygon[i][0], (double)polygon[i][1]);
-            auto pj =
-                getColRowCoord((double)polygon[j][0], (double)polygon[j][1]);
-            // std::cerr << pi[0] << " " << pi[1] << "\n";
-            // std::cerr << pj[0] << " " << pj[1] << "\n";
+            const auto &pi = cr[i];
+            const auto &pj = cr[j];
             if ((pi[1] < (double)pixelY && pj[1] >= (double)pixelY) ||
                 (pj[1] < (double)pixelY && pi[1] >= (double)pixelY)) {
               intersect_x.push_back(
@@ -167,6 +239,7 @@ namespace roofer {
           }
 
           // Fill the pixels between node pairs.
+          float y = miny_ + pixelY * cellSize_ + cellSize_ / 2;
           for (i = 0; i < n_nodes; i += 2) {
             if (intersect_x[i] >= IMAGE_RIGHT) break;
             if (intersect_x[i + 1] > IMAGE_LEFT) {
@@ -175,19 +248,31 @@ namespace roofer {
                 intersect_x[i + 1] = IMAGE_RIGHT;
               for (pixelX = intersect_x[i]; pixelX <= intersect_x[i + 1];
                    pixelX++) {
-                auto p = getPointFromRasterCoords(pixelX, pixelY);
-                if (p[2] == noDataVal_) {
-                  if (returnNoData) {
-                    result.push_back(p);
-                  }
-                } else {
-                  result.push_back(p);
-                }
+                float x = minx_ + pixelX * cellSize_ + cellSize_ / 2;
+                visit(size_t(pixelX), size_t(pixelY), x, y);
               }
             }
           }
         }
+      };
 
+      // rasterise a polygon and return a list with points - one in the center
+      // of each pixel inside the polygon in the polygon first point is *not*
+      // repeated as last T should be a vector of arr<float,2> or arr<float,3>
+      template <typename T>
+      std::vector<point3d> rasterise_polygon(T &polygon,
+                                             std::array<double, 2> cr_min,
+                                             std::array<double, 2> cr_max,
+                                             bool returnNoData = true) const {
+        std::vector<point3d> result;
+        visit_polygon_cells(
+            polygon, cr_min, cr_max,
+            [&](size_t col, size_t row, float x, float y) {
+              float z = vals_[col + row * dimx_];
+              if (returnNoData || z != noDataVal_) {
+                result.push_back({x, y, z});
+              }
+            });
         return result;
       };
       template <typename T>
@@ -203,10 +288,12 @@ namespace roofer {
       double cellSize_, minx_, miny_, maxx_, maxy_;
       size_t dimx_, dimy_;
       double noDataVal_;
-      // std::unique_ptr<std::vector<int16_t>> counts_;
-      std::unique_ptr<std::vector<float>> vals_;
+      std::vector<float> vals_;
 
      private:
+      size_t n_count_bands_ = 0;
+      std::vector<count_t> counts_;
+
       void avg(double &x, double &y, double &val);
       void min(double &x, double &y, double &val);
       void max(double &x, double &y, double &val);
@@ -218,7 +305,6 @@ namespace roofer {
        * @param[in] y y coordinate
        */
       void add(double &x, double &y, double &val);
-      // void cnt(double &x, double &y);
       // OGRSpatialReference oSRS;
     };
   }  // namespace RasterTools
@@ -0,0 +1,94 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace roofer {
+
+  /**
+   * @brief Monotonic arena for short lived scratch data
+   *
+   * Allocations are served by bumping a pointer in a buffer owned by the
+   * arena, deallocation is a no-op. All memory is reclaimed at once with
+   * release(). When the allocations of a cycle did not fit in the buffer, it
+   * is grown on release() to the size that was needed, so that after a few
+   * cycles the arena no longer touches the heap. The buffer does not grow
+   * beyond max_capacity; larger cycles take the rest from the heap and give
+   * it back on release(), so one very large building does not keep its peak
+   * memory for the rest of the run.
+   *
+   * A ScratchArena is not thread safe; use one arena per worker thread.
+   */
+  class ScratchArena : public std::pmr::memory_resource {
+    struct CountingResource : std::pmr::memory_resource {
+      size_t allocated = 0;
+
+     private:
+      void* do_allocate(size_t bytes, size_t alignment) override;
+      void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+      bool do_is_equal(
+          const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    size_t capacity_;
+    size_t max_capacity_;
+    std::unique_ptr<std::byte[]> buffer_;
+    CountingResource overflow_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+
+   public:
+    explicit ScratchArena(size_t initial_capacity = 1 << 20,
+                          size_t max_capacity = 1 << 26);
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    /**
+     * @brief Reclaim all memory handed out since the previous release()
+     *
+     * Any object that was allocated from the arena must be destroyed before
+     * calling this.
+     */
+    void release();
+
+    /**
+     * @brief Size of the buffer that is reused between cycles
+     */
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * @brief Bytes requested from the heap in the current cycle because the
+     * buffer was too small
+     */
+    size_t overflow() const { return overflow_.allocated; }
+
+   private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override;
+  };
+
+}  // namespace roofer
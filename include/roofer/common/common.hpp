@@ -244,6 +244,7 @@ namespace roofer {
 
     void push_back(TriangleCollection& trianglecollection);
     void push_back(AttributeMap& attributemap);
+    void clear();
     std::vector<TriangleCollection>& get_tricollections();
     const std::vector<TriangleCollection>& get_tricollections() const;
     std::vector<AttributeMap>& get_attributes();
@@ -0,0 +1,69 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+
+namespace roofer {
+
+  /**
+   * @brief Compute several percentiles of a range at once
+   *
+   * The percentile p is the element at index floor(p * (n - 1)) of the sorted
+   * range. The percentiles are selected in ascending order and each selection
+   * only looks at the part of the range after the previous one, so this is
+   * much cheaper than sorting or than one full selection per percentile.
+   *
+   * The range is reordered and must not be empty. The result is in the order
+   * of percentiles, which does not need to be sorted.
+   */
+  template <typename RandomIt, size_t N>
+  std::array<typename std::iterator_traits<RandomIt>::value_type, N>
+  compute_percentiles(RandomIt first, RandomIt last,
+                      const double (&percentiles)[N]) {
+    assert(first != last);
+    const size_t n = std::distance(first, last);
+
+    std::array<size_t, N> order;
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return percentiles[a] < percentiles[b];
+    });
+
+    std::array<typename std::iterator_traits<RandomIt>::value_type, N> result;
+    auto begin = first;
+    for (auto i : order) {
+      assert(percentiles[i] >= 0. && percentiles[i] <= 1.);
+      auto nth = first + size_t(std::floor(percentiles[i] * double(n - 1)));
+      std::nth_element(begin, nth, last);
+      result[i] = *nth;
+      begin = nth;
+    }
+    return result;
+  }
+
+}  // namespace roofer
@@ -0,0 +1,72 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <roofer/common/CityJsonBinary.hpp>
+#include <roofer/common/datastructures.hpp>
+#include <roofer/misc/projHelper.hpp>
+
+namespace roofer::io {
+
+  /*
+   * Writes the same features as the CityJsonWriter in the binary CityJSON
+   * format described in roofer/common/CityJsonBinary.hpp.
+   */
+  struct CityJsonBinaryWriterInterface {
+    // parameter variables
+    std::string identifier_attribute = "";
+
+    double translate_x_ = 0.;
+    double translate_y_ = 0.;
+    double translate_z_ = 0.;
+    double scale_x_ = 0.01;
+    double scale_y_ = 0.01;
+    double scale_z_ = 0.01;
+
+    roofer::misc::projHelperInterface& pjHelper;
+
+    CityJsonBinaryWriterInterface(roofer::misc::projHelperInterface& pjh)
+        : pjHelper(pjh){};
+    virtual ~CityJsonBinaryWriterInterface() = default;
+
+    // writes the file header with the transform, metadata is the CityJSON
+    // metadata object as json text and can be empty
+    virtual void write_header(std::ostream& output_stream,
+                              std::string_view metadata = {}) = 0;
+
+    // Encodes a feature as one length prefixed record into output (replacing
+    // its contents). feature_id is used as the id when there is no
+    // identifier_attribute.
+    virtual void encode_feature(
+        std::string& output, const LinearRing& footprint,
+        const std::unordered_map<int, Mesh>* geometry_lod12,
+        const std::unordered_map<int, Mesh>* geometry_lod13,
+        const std::unordered_map<int, Mesh>* geometry_lod22,
+        const AttributeMapRow& attributes, size_t feature_id) = 0;
+  };
+
+  std::unique_ptr<CityJsonBinaryWriterInterface> createCityJsonBinaryWriter(
+      roofer::misc::projHelperInterface& pjh);
+}  // namespace roofer::io
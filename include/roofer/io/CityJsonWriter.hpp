@@ -79,6 +79,19 @@ namespace roofer::io {
         const std::unordered_map<int, Mesh>* geometry_lod22,
         const AttributeMapRow attributes) = 0;
 
+    // Serialises a feature the same way as write_feature(), including the
+    // trailing newline, into output (replacing its contents). Instead of
+    // counting written_features_count, the id that is used when there is no
+    // identifier_attribute is given by feature_id. This is const with
+    // respect to the configuration, so features can be encoded in parallel
+    // with one writer per thread.
+    virtual void encode_feature(
+        std::string& output, const LinearRing& footprint,
+        const std::unordered_map<int, Mesh>* geometry_lod12,
+        const std::unordered_map<int, Mesh>* geometry_lod13,
+        const std::unordered_map<int, Mesh>* geometry_lod22,
+        const AttributeMapRow& attributes, size_t feature_id) = 0;
+
     // virtual void write(const std::string& source, const LinearRing&
     // footprints,
     //                    const std::unordered_map<int, Mesh>* geometry_lod12,
@@ -41,11 +41,21 @@ namespace roofer::io {
 
     virtual TBox<double> getExtent() = 0;
 
+    // Number of points in the header
+    virtual size_t getPointCount() = 0;
+
     virtual void readPointCloud(PointCollection& points,
                                 vec1i* classification = nullptr,
                                 vec1i* order = nullptr,
                                 vec1f* intensities = nullptr,
                                 vec3f* colors = nullptr) = 0;
+
+    // Reads count points starting at point index first, eg. one building
+    // from a tile packed crop output. Uncompressed LAS files are memory
+    // mapped so that only the requested points are touched.
+    virtual void readPointCloudSlice(size_t first, size_t count,
+                                     PointCollection& points,
+                                     vec1i* classification = nullptr) = 0;
   };
 
   std::unique_ptr<PointCloudReaderInterface> createPointCloudReaderLASlib(
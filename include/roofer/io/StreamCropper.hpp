@@ -37,6 +37,10 @@ namespace roofer::io {
     std::string wkt_ = "";
     bool handle_overlap_points = false;
     bool use_acquisition_year = true;
+    // threads that decode a LAZ file without spatial index in parallel
+    int decode_threads = 1;
+    // points that a decode thread reads at a time, rounded to whole LAZ chunks
+    int decode_range_points = 1 << 20;
   };
   struct PointCloudCropperInterface {
     roofer::misc::projHelperInterface& pjHelper;
@@ -35,6 +35,9 @@ namespace roofer::io {
     int layer_id = 0;
     std::string layer_name = "";
     std::string attribute_filter = "";
+    // attributes that readPolygons reads, all attributes if empty. The other
+    // fields are not fetched from the source.
+    std::vector<std::string> attributes_keep;
 
     VectorReaderInterface(roofer::misc::projHelperInterface& pjh)
         : pjHelper(pjh){};
@@ -43,11 +46,17 @@ namespace roofer::io {
     virtual void open(const std::string& source) = 0;
 
     virtual size_t get_feature_count() = 0;
+    // number of features whose bounding box intersects extent
+    virtual size_t get_feature_count(const roofer::TBox<double>& extent) = 0;
 
     virtual void get_crs(roofer::io::SpatialReferenceSystemInterface* srs) = 0;
 
     virtual void readPolygons(std::vector<LinearRing>&,
                               AttributeVecMap* attributes = nullptr) = 0;
+
+    // Centroids of the features in region_of_interest, in the coordinates of
+    // the layer. Cheaper than readPolygons, eg. to plan the tiles.
+    virtual void readCentroids(std::vector<arr3d>& centroids) = 0;
   };
 
   std::unique_ptr<VectorReaderInterface> createVectorReaderOGR(
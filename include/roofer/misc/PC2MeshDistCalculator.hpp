@@ -38,6 +38,14 @@ namespace roofer::misc {
     // add_output("m2pc_error_hist", typeid(std::string));
     // add_output("m2pc_error_max", typeid(float));
 
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      rms_error = 0;
+      point_errors.clear();
+      face_errors.clear();
+      mesh_error.clear();
+    }
+
     virtual ~PC2MeshDistCalculatorInterface() = default;
     virtual void compute(
         const IndexedPlanesWithPoints& points,
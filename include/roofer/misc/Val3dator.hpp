@@ -38,6 +38,13 @@ namespace roofer::misc {
     std::vector<LinearRing> error_faces;
     PointCollection error_locations;
 
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      errors.clear();
+      error_faces.clear();
+      error_locations.clear();
+    }
+
     virtual ~Val3datorInterface() = default;
     virtual void compute(const std::unordered_map<int, Mesh>& mesh,
                          Val3datorConfig config = Val3datorConfig()) = 0;
@@ -38,6 +38,11 @@ namespace roofer::misc {
 
     virtual arr3f coord_transform_fwd(const double& x, const double& y,
                                       const double& z) = 0;
+    // Transforms n points given as one array per coordinate, out must have
+    // room for n points
+    virtual void coord_transform_fwd(const double* x, const double* y,
+                                     const double* z, size_t n,
+                                     arr3f* out) = 0;
     virtual arr3d coord_transform_rev(const float& x, const float& y,
                                       const float& z) = 0;
     virtual arr3d coord_transform_rev(const arr3f& p) = 0;
@@ -21,6 +21,7 @@
 
 #pragma once
 #include <memory>
+#include <roofer/common/Deadline.hpp>
 #include <roofer/common/datastructures.hpp>
 #include <roofer/reconstruction/cgal_shared_definitions.hpp>
 
@@ -31,6 +32,10 @@ namespace roofer::reconstruction {
     bool extract_polygons = true;
     bool optimal_alpha = false;
     bool optimal_only_if_needed = true;
+    // also compute the debug outputs (edge_points, alpha_edges, segment_ids)
+    bool collect_debug = false;
+    // checked while growing regions and extracting rings, may be null
+    const Deadline* deadline = nullptr;
   };
 
   struct AlphaShaperInterface {
@@ -38,14 +43,28 @@ namespace roofer::reconstruction {
     TriangleCollection alpha_triangles;
     vec1i roofplane_ids;
 
-    // add_output("edge_points", typeid(PointCollection));
-    // add_output("alpha_edges", typeid(LineStringCollection));
-    // add_output("segment_ids", typeid(vec1i));
+    // debug outputs, only filled when config.collect_debug is set
+    PointCollection edge_points;
+    LineStringCollection alpha_edges;
+    vec1i segment_ids;
+
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      alpha_rings.clear();
+      alpha_triangles.clear();
+      roofplane_ids.clear();
+      edge_points.clear();
+      alpha_edges.clear();
+      segment_ids.clear();
+    }
 
     virtual ~AlphaShaperInterface() = default;
     virtual void compute(const IndexedPlanesWithPoints& pts_per_roofplane,
                          AlphaShaperConfig config = AlphaShaperConfig()) = 0;
   };
 
-  std::unique_ptr<AlphaShaperInterface> createAlphaShaper();
+  // scratch is used for the temporary data of compute(), it must outlive the
+  // alpha shaper
+  std::unique_ptr<AlphaShaperInterface> createAlphaShaper(
+      std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
 }  // namespace roofer::reconstruction
@@ -21,6 +21,7 @@
 
 #pragma once
 #include <memory>
+#include <roofer/common/Deadline.hpp>
 #include <roofer/common/datastructures.hpp>
 #include <roofer/reconstruction/cgal_shared_definitions.hpp>
 
@@ -32,6 +33,8 @@ namespace roofer::reconstruction {
     float fp_extension = 0.0;
     bool insert_with_snap = false;
     bool insert_lines = true;
+    // checked for every inserted segment, may be null
+    const Deadline* deadline = nullptr;
   };
 
   struct ArrangementBuilderInterface {
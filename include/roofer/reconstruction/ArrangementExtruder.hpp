@@ -22,6 +22,7 @@
 
 #pragma once
 #include <memory>
+#include <memory_resource>
 #include <roofer/common/datastructures.hpp>
 #include <roofer/reconstruction/ElevationProvider.hpp>
 #include <roofer/reconstruction/cgal_shared_definitions.hpp>
@@ -36,21 +37,25 @@ namespace roofer::reconstruction {
     // float base_elevation = 0;
     float nodata_elevation = 3;
     int snap_tolerance_exp = 4;
+    // also compute the debug outputs (labels, faces)
+    bool collect_debug = false;
   };
 
   struct ArrangementExtruderInterface {
-    vec1i labels;
-    std::vector<LinearRing> faces;
     std::vector<Mesh> meshes;
     std::unordered_map<int, Mesh> multisolid;
-    // add_input("arrangement", typeid(Arrangement_2));
-    // add_input("floor_elevation", typeid(float));
 
-    // // add_output("normals_vec3f", typeid(vec3f), true);
-    // add_vector_output("labels", typeid(int)); // 0==ground, 1==roof,
-    // 2==outerwall, 3==innerwall add_vector_output("faces",
-    // typeid(LinearRing)); add_vector_output("mesh", typeid(Mesh));
-    // add_output("multisolid", typeid(std::unordered_map<int, Mesh>));
+    // debug outputs, only filled when config.collect_debug is set
+    vec1i labels;  // 0==ground, 1==roof, 2==outerwall, 3==innerwall
+    std::vector<LinearRing> faces;
+
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      meshes.clear();
+      multisolid.clear();
+      labels.clear();
+      faces.clear();
+    }
 
     virtual ~ArrangementExtruderInterface() = default;
 
@@ -63,5 +68,8 @@ namespace roofer::reconstruction {
         ArrangementExtruderConfig config = ArrangementExtruderConfig()) = 0;
   };
 
-  std::unique_ptr<ArrangementExtruderInterface> createArrangementExtruder();
+  // scratch is used for the temporary data of compute(), it must outlive the
+  // extruder
+  std::unique_ptr<ArrangementExtruderInterface> createArrangementExtruder(
+      std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
 }  // namespace roofer::reconstruction
@@ -21,6 +21,7 @@
 
 #pragma once
 #include <memory>
+#include <roofer/common/Deadline.hpp>
 #include <roofer/common/Raster.hpp>
 #include <roofer/common/datastructures.hpp>
 #include <roofer/reconstruction/cgal_shared_definitions.hpp>
@@ -37,6 +38,9 @@ namespace roofer::reconstruction {
     bool use_ground = true;
     bool label_ground_outside_fp = true;
     float z_percentile = 0.9;
+    // checked while the costs are computed, the graph cut itself can not be
+    // interrupted. May be null.
+    const Deadline* deadline = nullptr;
   };
 
   struct ArrangementOptimiserInterface {
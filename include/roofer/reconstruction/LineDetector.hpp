@@ -36,21 +36,28 @@ namespace roofer::reconstruction {
     float line_extend = 0.05;
     bool perform_chaining = true;
     bool remove_overlap = true;
+    // also compute the debug outputs (lines3d, ring_idx, ring_id, ring_order,
+    // is_start)
+    bool collect_debug = false;
   };
 
   struct LineDetectorInterface {
     SegmentCollection edge_segments;
 
-    // add_vector_input("edge_points", {typeid(LinearRing)});
-    // add_input("roofplane_ids", typeid(vec1i));
-    // add_input("pts_per_roofplane", typeid(IndexedPlanesWithPoints ));
-    // add_output("lines3d", typeid(SegmentCollection));
-    // add_output("ring_edges", typeid(SegmentCollection));
-    // add_output("ring_idx",
-    // typeid(std::unordered_map<size_t,std::vector<size_t>>));
-    // add_output("ring_id", typeid(vec1i));
-    // add_output("ring_order", typeid(vec1i));
-    // add_output("is_start", typeid(vec1i));
+    // debug outputs, only filled when config.collect_debug is set
+    SegmentCollection lines3d;
+    std::unordered_map<size_t, std::vector<size_t>> ring_idx;
+    vec1i ring_id, ring_order, is_start;
+
+    // clears the outputs but keeps their capacity, called by detect()
+    virtual void reset() {
+      edge_segments.clear();
+      lines3d.clear();
+      ring_idx.clear();
+      ring_id.clear();
+      ring_order.clear();
+      is_start.clear();
+    }
 
     virtual ~LineDetectorInterface() = default;
     virtual void detect(const std::vector<LinearRing>& edge_points,
@@ -50,6 +50,12 @@ namespace roofer::reconstruction {
     // add_output("exact_footprint_out", typeid(linereg::Polygon_with_holes_2));
     // add_output("n_angle_clusters", typeid(int));
 
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      exact_regularised_edges.clear();
+      regularised_edges.clear();
+    }
+
     virtual ~LineRegulariserInterface() = default;
     virtual void compute(
         const SegmentCollection& edge_segments,
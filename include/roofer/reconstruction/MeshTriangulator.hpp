@@ -40,6 +40,15 @@ namespace roofer::reconstruction {
     vec1i ring_ids;
     vec1f volumes;
 
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      triangles.clear();
+      multitrianglecol.clear();
+      normals.clear();
+      ring_ids.clear();
+      volumes.clear();
+    }
+
     virtual ~MeshTriangulatorInterface() = default;
     virtual void compute(
         const std::vector<Mesh>& meshes,
@@ -21,6 +21,8 @@
 
 #pragma once
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <roofer/common/datastructures.hpp>
 
 #include "cgal_shared_definitions.hpp"
@@ -67,17 +69,36 @@ namespace roofer::reconstruction {
            unsegmented_pt_cnt = 0, total_plane_cnt = 0;
 
     std::string roof_type;
-    float roof_elevation_70p;
-    float roof_elevation_50p;
-    float roof_elevation_min;
-    float roof_elevation_max;
+    // empty when there were no roof points
+    std::optional<float> roof_elevation_70p;
+    std::optional<float> roof_elevation_50p;
+    std::optional<float> roof_elevation_min;
+    std::optional<float> roof_elevation_max;
+
+    // clears the outputs but keeps their capacity, called by detect()
+    virtual void reset() {
+      plane_id.clear();
+      pts_per_roofplane.clear();
+      plane_adjacencies.clear();
+      horiz_roofplane_cnt = slant_roofplane_cnt = 0;
+      horiz_pt_cnt = total_pt_cnt = wall_pt_cnt = unsegmented_pt_cnt =
+          total_plane_cnt = 0;
+      roof_type.clear();
+      roof_elevation_70p.reset();
+      roof_elevation_50p.reset();
+      roof_elevation_min.reset();
+      roof_elevation_max.reset();
+    }
 
     virtual ~PlaneDetectorInterface() = default;
     virtual void detect(const PointCollection& points,
                         PlaneDetectorConfig config = PlaneDetectorConfig()) = 0;
   };
 
-  std::unique_ptr<PlaneDetectorInterface> createPlaneDetector();
+  // scratch is used for the temporary data of detect(), it must outlive the
+  // detector
+  std::unique_ptr<PlaneDetectorInterface> createPlaneDetector(
+      std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
 
   struct ShapeDetectorInterface {
     virtual unsigned detectPlanes(PointCollection& point_collection,
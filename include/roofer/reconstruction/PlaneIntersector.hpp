@@ -36,6 +36,11 @@ namespace roofer::reconstruction {
   struct PlaneIntersectorInterface {
     SegmentCollection segments;
 
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      segments.clear();
+    }
+
     virtual ~PlaneIntersectorInterface() = default;
     virtual void compute(
         const IndexedPlanesWithPoints& pts_per_roofplane,
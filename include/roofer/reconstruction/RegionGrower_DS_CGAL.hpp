@@ -90,8 +90,8 @@ namespace roofer {
         for (size_t i = 0; i < size; ++i) {
           seeds.push_back(i);
         }
-        std::random_device rd;
-        std::mt19937 g(rd());
+        // fixed seed, so that reruns detect the same planes
+        std::mt19937 g(5489u);
         std::shuffle(seeds.begin(), seeds.end(), g);
         return seeds;
       }
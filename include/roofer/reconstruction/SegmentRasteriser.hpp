@@ -34,10 +34,17 @@ namespace roofer::reconstruction {
     int megapixel_limit = 600;
     bool fill_nodata_ = true;
     int fill_nodata_window_size_ = 5;
+    // also compute the debug outputs (grid_points, values)
+    bool collect_debug = false;
   };
 
   struct SegmentRasteriserInterface {
     RasterTools::Raster heightfield;
+    float data_area = 0;
+
+    // debug outputs, only filled when config.collect_debug is set
+    PointCollection grid_points;
+    vec1f values;
 
     // add_vector_input("triangles", typeid(TriangleCollection));
     // add_vector_input("ground_triangles", typeid(TriangleCollection));
@@ -46,10 +53,12 @@ namespace roofer::reconstruction {
     // add_input("pts_per_roofplane", typeid(IndexedPlanesWithPoints));
     // add_output("heightfield", typeid(RasterTools::Raster));
 
-    // add_output("heightfield", typeid(RasterTools::Raster));
-    // add_output("grid_points", typeid(PointCollection));
-    // add_output("values", typeid(vec1f));
-    // add_output("data_area", typeid(float));
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      data_area = 0;
+      grid_points.clear();
+      values.clear();
+    }
 
     virtual ~SegmentRasteriserInterface() = default;
     virtual void compute(
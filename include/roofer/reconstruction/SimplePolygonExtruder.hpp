@@ -38,6 +38,13 @@ namespace roofer::reconstruction {
     // add_vector_output("3d_polygons", typeid(LinearRing));
     // add_output("surface_types", typeid(vec1i));
 
+    // clears the outputs but keeps their capacity, called by compute()
+    virtual void reset() {
+      polygons_3d.clear();
+      surface_types.clear();
+      multisolid.clear();
+    }
+
     virtual ~SimplePolygonExtruderInterface() = default;
     virtual void compute(
         LinearRing& footprint, float& floor_elevation, float& roof_elevation,
@@ -19,8 +19,10 @@
 // Author(s):
 // Ivan Paden
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <roofer/common/CityJsonBinary.hpp>
 #include <roofer/roofer.h>
 
 namespace py = pybind11;
@@ -152,6 +154,105 @@ namespace roofer {
     return std::make_tuple(vertices, faces);
   }
 
+  py::dict py_cjb_attributes(const cjb::FeatureView& f, cjb::Span span) {
+    py::dict attributes;
+    for (auto& a : f.select(f.attributes(), span)) {
+      auto key = py::str(f.string(a.key).data(), a.key.size);
+      switch (a.type) {
+        case cjb::AttributeType::Null:
+          attributes[key] = py::none();
+          break;
+        case cjb::AttributeType::Bool:
+          attributes[key] = bool(a.int_value);
+          break;
+        case cjb::AttributeType::Int:
+          attributes[key] = a.int_value;
+          break;
+        case cjb::AttributeType::Float:
+          attributes[key] = a.float_value;
+          break;
+        case cjb::AttributeType::String:
+          attributes[key] = py::str(f.string(a.string_value).data(),
+                                    a.string_value.size);
+          break;
+      }
+    }
+    return attributes;
+  }
+
+  // the CityObjects of a binary CityJSON feature, laid out as in CityJSON
+  py::dict py_cjb_city_objects(const cjb::FeatureView& f) {
+    static const char* semantic_types[] = {"GroundSurface", "WallSurface",
+                                           "RoofSurface"};
+    auto objects = f.objects();
+    py::dict city_objects;
+    for (auto& o : objects) {
+      py::dict object;
+      object["type"] =
+          o.type == cjb::ObjectType::Building ? "Building" : "BuildingPart";
+      if (o.attributes.count) {
+        object["attributes"] = py_cjb_attributes(f, o.attributes);
+      }
+      if (o.parent >= 0) {
+        py::list parents;
+        parents.append(std::string(f.string(objects[o.parent].id)));
+        object["parents"] = parents;
+      }
+      py::list geometries;
+      for (auto& g : f.select(f.geometries(), o.geometries)) {
+        py::dict geometry;
+        py::list surfaces, values;
+        for (auto& s : f.select(f.surfaces(), g.surfaces)) {
+          py::list rings;
+          for (auto& r : f.select(f.rings(), s.rings)) {
+            py::list ring;
+            for (auto i : f.select(f.indices(), r)) ring.append(i);
+            rings.append(ring);
+          }
+          surfaces.append(rings);
+          if (s.semantic < 0) {
+            values.append(py::none());
+          } else {
+            values.append(s.semantic);
+          }
+        }
+        geometry["lod"] = std::string(f.string(g.lod));
+        if (g.type == cjb::GeometryType::Solid) {
+          geometry["type"] = "Solid";
+          // Solids have only an exterior shell
+          py::list shells;
+          shells.append(surfaces);
+          geometry["boundaries"] = shells;
+        } else {
+          geometry["type"] = "MultiSurface";
+          geometry["boundaries"] = surfaces;
+        }
+        if (g.semantics.count) {
+          py::list semantic_surfaces;
+          for (auto& sem : f.select(f.semantics(), g.semantics)) {
+            auto surface = py_cjb_attributes(f, sem.attributes);
+            surface["type"] = semantic_types[size_t(sem.type)];
+            semantic_surfaces.append(surface);
+          }
+          py::dict semantics;
+          semantics["surfaces"] = semantic_surfaces;
+          if (g.type == cjb::GeometryType::Solid) {
+            py::list shell_values;
+            shell_values.append(values);
+            semantics["values"] = shell_values;
+          } else {
+            semantics["values"] = values;
+          }
+          geometry["semantics"] = semantics;
+        }
+        geometries.append(geometry);
+      }
+      object["geometry"] = geometries;
+      city_objects[py::str(f.string(o.id).data(), o.id.size)] = object;
+    }
+    return city_objects;
+  }
+
 }  // namespace roofer
 
 PYBIND11_MODULE(roofer, m) {
@@ -205,4 +306,70 @@ PYBIND11_MODULE(roofer, m) {
 
   m.def("triangulate_mesh", &roofer::py_triangulate_mesh, "Triangulate a mesh",
         py::arg("mesh"));
+
+  // Binary CityJSON. The vertices and indices arrays point directly into the
+  // memory mapped file, so they are read-only and only valid until the reader
+  // is closed.
+  py::class_<roofer::cjb::FeatureView>(m, "CityJsonBinaryFeature")
+      .def_property_readonly("id",
+                             [](const roofer::cjb::FeatureView& f) {
+                               return std::string(f.id());
+                             })
+      .def_property_readonly(
+          "vertices",
+          [](py::object self) {
+            auto vertices = self.cast<const roofer::cjb::FeatureView&>()
+                                .vertices();
+            py::array_t<int32_t> array(
+                {vertices.size(), size_t(3)},
+                {sizeof(roofer::cjb::Vertex), sizeof(int32_t)},
+                reinterpret_cast<const int32_t*>(vertices.data()), self);
+            array.attr("setflags")(py::arg("write") = false);
+            return array;
+          },
+          "Quantised vertices as an (n, 3) int32 array, apply the transform "
+          "of the reader to get coordinates")
+      .def_property_readonly(
+          "indices",
+          [](py::object self) {
+            auto indices =
+                self.cast<const roofer::cjb::FeatureView&>().indices();
+            py::array_t<uint32_t> array(indices.size(), indices.data(), self);
+            array.attr("setflags")(py::arg("write") = false);
+            return array;
+          },
+          "Vertex indices of all rings, as a flat uint32 array")
+      .def_property_readonly("city_objects", &roofer::py_cjb_city_objects,
+                             "The CityObjects as CityJSON dictionaries");
+
+  py::class_<roofer::cjb::ReaderInterface>(m, "CityJsonBinaryReader")
+      .def(py::init(&roofer::cjb::createReader))
+      .def(py::init([](const std::string& path) {
+             auto reader = roofer::cjb::createReader();
+             reader->open(path);
+             return reader;
+           }),
+           py::arg("path"))
+      .def("open", &roofer::cjb::ReaderInterface::open, py::arg("path"))
+      .def("close", &roofer::cjb::ReaderInterface::close)
+      .def("__len__", &roofer::cjb::ReaderInterface::size)
+      .def(
+          "__getitem__",
+          [](const roofer::cjb::ReaderInterface& reader, size_t i) {
+            if (i >= reader.size()) throw py::index_error();
+            return reader.feature(i);
+          },
+          py::keep_alive<0, 1>())
+      .def_property_readonly("metadata",
+                             [](const roofer::cjb::ReaderInterface& reader) {
+                               return std::string(reader.metadata());
+                             })
+      .def_property_readonly("scale",
+                             [](const roofer::cjb::ReaderInterface& reader) {
+                               return reader.header().scale;
+                             })
+      .def_property_readonly("translate",
+                             [](const roofer::cjb::ReaderInterface& reader) {
+                               return reader.header().translate;
+                             });
 }
@@ -0,0 +1,266 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <roofer/common/CityJsonBinary.hpp>
+#include <roofer/common/datastructures.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace roofer::cjb {
+
+  namespace {
+    constexpr size_t padded(size_t size) { return (size + 7) & ~size_t(7); }
+
+    // Checks that everything the FeatureView accessors can return lies in the
+    // record: every column and every string, span and index that refers into
+    // another column.
+    class FeatureValidator {
+      const std::byte* data_;
+      uint64_t size_;
+      FeatureHeader h_;
+
+      template <typename T>
+      bool column_ok(const Column& c) const {
+        if (c.count == 0) return c.offset <= size_;
+        return c.offset % 8 == 0 && c.offset >= sizeof(FeatureHeader) &&
+               uint64_t(c.offset) + uint64_t(c.count) * sizeof(T) <= size_;
+      }
+
+      template <typename T>
+      std::span<const T> column(const Column& c) const {
+        return {reinterpret_cast<const T*>(data_ + c.offset), c.count};
+      }
+
+      static bool span_ok(const Span& s, uint64_t count) {
+        return uint64_t(s.first) + s.count <= count;
+      }
+
+      bool string_ok(const StringRef& s) const {
+        return uint64_t(s.offset) + s.size <= h_.strings.count;
+      }
+
+      bool attributes_ok(const Span& s) const {
+        if (!span_ok(s, h_.attributes.count)) return false;
+        auto attributes = column<AttributeRecord>(h_.attributes);
+        for (auto& a : FeatureView::select(attributes, s)) {
+          if (!string_ok(a.key)) return false;
+          if (a.type > AttributeType::String) return false;
+          if (a.type == AttributeType::String && !string_ok(a.string_value))
+            return false;
+        }
+        return true;
+      }
+
+     public:
+      FeatureValidator(const std::byte* data, uint64_t size)
+          : data_(data), size_(size) {
+        std::memcpy(&h_, data_, sizeof(FeatureHeader));
+      }
+
+      bool valid() const {
+        if (!column_ok<char>(h_.strings) || !column_ok<Vertex>(h_.vertices) ||
+            !column_ok<ObjectRecord>(h_.objects) ||
+            !column_ok<GeometryRecord>(h_.geometries) ||
+            !column_ok<SurfaceRecord>(h_.surfaces) ||
+            !column_ok<Span>(h_.rings) || !column_ok<uint32_t>(h_.indices) ||
+            !column_ok<SemanticRecord>(h_.semantics) ||
+            !column_ok<AttributeRecord>(h_.attributes))
+          return false;
+        if (!string_ok(h_.id)) return false;
+
+        for (auto& o : column<ObjectRecord>(h_.objects)) {
+          if (!string_ok(o.id) || o.type > ObjectType::BuildingPart ||
+              o.parent < -1 || o.parent >= int64_t(h_.objects.count) ||
+              !span_ok(o.geometries, h_.geometries.count) ||
+              !attributes_ok(o.attributes))
+            return false;
+        }
+        auto surfaces = column<SurfaceRecord>(h_.surfaces);
+        for (auto& g : column<GeometryRecord>(h_.geometries)) {
+          if (g.type > GeometryType::Solid || !string_ok(g.lod) ||
+              !span_ok(g.surfaces, h_.surfaces.count) ||
+              !span_ok(g.semantics, h_.semantics.count))
+            return false;
+          for (auto& surface : FeatureView::select(surfaces, g.surfaces)) {
+            if (surface.semantic < -1 ||
+                surface.semantic >= int64_t(g.semantics.count))
+              return false;
+          }
+        }
+        for (auto& surface : surfaces) {
+          if (!span_ok(surface.rings, h_.rings.count)) return false;
+        }
+        for (auto& ring : column<Span>(h_.rings)) {
+          if (!span_ok(ring, h_.indices.count)) return false;
+        }
+        for (auto& index : column<uint32_t>(h_.indices)) {
+          if (index >= h_.vertices.count) return false;
+        }
+        for (auto& semantic : column<SemanticRecord>(h_.semantics)) {
+          if (semantic.type > SemanticType::RoofSurface ||
+              !attributes_ok(semantic.attributes))
+            return false;
+        }
+        return true;
+      }
+    };
+  }  // namespace
+
+  class Reader : public ReaderInterface {
+    const std::byte* data_ = nullptr;
+    size_t size_ = 0;
+    FileHeader header_;
+    // offset of the FeatureHeader of each record
+    std::vector<size_t> features_;
+
+#if defined(_WIN32)
+    // no mmap here, the file is read into an 8 byte aligned buffer instead
+    std::unique_ptr<uint64_t[]> buffer_;
+#else
+    void* map_ = nullptr;
+#endif
+
+    void map_file(const std::string& path) {
+#if defined(_WIN32)
+      size_ = std::filesystem::file_size(path);
+      buffer_ = std::make_unique_for_overwrite<uint64_t[]>(padded(size_) / 8);
+      std::ifstream ifs(path, std::ios::binary);
+      ifs.read(reinterpret_cast<char*>(buffer_.get()), size_);
+      if (!ifs) throw rooferException("Failed to read " + path);
+      data_ = reinterpret_cast<const std::byte*>(buffer_.get());
+#else
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) throw rooferException("Failed to open " + path);
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw rooferException("Failed to stat " + path);
+      }
+      size_ = st.st_size;
+      if (size_) {
+        map_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+      ::close(fd);
+      if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        throw rooferException("Failed to map " + path);
+      }
+      data_ = static_cast<const std::byte*>(map_);
+#endif
+    }
+
+    void unmap_file() {
+#if defined(_WIN32)
+      buffer_.reset();
+#else
+      if (map_) ::munmap(map_, size_);
+      map_ = nullptr;
+#endif
+      data_ = nullptr;
+      size_ = 0;
+    }
+
+   public:
+    ~Reader() override { unmap_file(); }
+
+    void open(const std::string& path) override {
+      close();
+      map_file(path);
+
+      if (size_ < sizeof(FileHeader)) {
+        close();
+        throw rooferException(path + " is not a binary CityJSON file");
+      }
+      std::memcpy(&header_, data_, sizeof(FileHeader));
+      if (header_.magic != magic) {
+        close();
+        throw rooferException(path + " is not a binary CityJSON file");
+      }
+      if (header_.version != version) {
+        close();
+        throw rooferException(path +
+                              " has unsupported binary CityJSON version " +
+                              std::to_string(header_.version));
+      }
+
+      if (sizeof(FileHeader) + size_t(header_.metadata_size) > size_) {
+        close();
+        throw rooferException(path + " contains truncated metadata");
+      }
+
+      // index the records, so that features can be accessed directly
+      size_t offset = sizeof(FileHeader) + padded(header_.metadata_size);
+      while (offset + sizeof(uint64_t) <= size_) {
+        uint64_t record_size;
+        std::memcpy(&record_size, data_ + offset, sizeof(uint64_t));
+        offset += sizeof(uint64_t);
+        if (record_size < sizeof(FeatureHeader) ||
+            record_size > size_ - offset) {
+          close();
+          throw rooferException(path + " contains a truncated feature");
+        }
+        if (record_size % 8 != 0 ||
+            !FeatureValidator(data_ + offset, record_size).valid()) {
+          close();
+          throw rooferException(path + " contains a corrupt feature");
+        }
+        features_.push_back(offset);
+        offset += record_size;
+      }
+    }
+
+    void close() override {
+      unmap_file();
+      features_.clear();
+      header_ = FileHeader();
+    }
+
+    const FileHeader& header() const override { return header_; }
+
+    std::string_view metadata() const override {
+      if (!data_) return {};
+      return {reinterpret_cast<const char*>(data_ + sizeof(FileHeader)),
+              header_.metadata_size};
+    }
+
+    size_t size() const override { return features_.size(); }
+
+    FeatureView feature(size_t i) const override {
+      return FeatureView(data_ + features_.at(i));
+    }
+  };
+
+  std::unique_ptr<ReaderInterface> createReader() {
+    return std::make_unique<Reader>();
+  }
+
+}  // namespace roofer::cjb
@@ -26,42 +26,17 @@ namespace roofer {
   namespace RasterTools {
 
     Raster::Raster(double cellsize, double min_x, double max_x, double min_y,
-                   double max_y)
+                   double max_y, size_t n_count_bands)
         : cellSize_(cellsize),
           minx_(min_x),
           maxx_(max_x),
           miny_(min_y),
-          maxy_(max_y) {
+          maxy_(max_y),
+          n_count_bands_(n_count_bands) {
       dimx_ = (maxx_ - minx_) / cellSize_ + 1;
       dimy_ = (maxy_ - miny_) / cellSize_ + 1;
-      vals_ = std::make_unique<std::vector<float>>();
-      vals_->resize(dimx_ * dimy_);
-      // counts_ = std::make_unique<std::vector<int16_t>>();
-      // counts_->resize(dimx_*dimy_);
-    }
-    Raster::Raster(const Raster &r) {
-      cellSize_ = r.cellSize_;
-      maxx_ = r.maxx_;
-      minx_ = r.minx_;
-      maxy_ = r.maxy_;
-      miny_ = r.miny_;
-      noDataVal_ = r.noDataVal_;
-      dimx_ = (maxx_ - minx_) / cellSize_ + 1;
-      dimy_ = (maxy_ - miny_) / cellSize_ + 1;
-      vals_ = std::make_unique<std::vector<float>>(*r.vals_);
-      // counts_ = std::make_unique<std::vector<int16_t>>(*r.counts_);
-    }
-    void Raster::operator=(const Raster &r) {
-      cellSize_ = r.cellSize_;
-      maxx_ = r.maxx_;
-      minx_ = r.minx_;
-      maxy_ = r.maxy_;
-      miny_ = r.miny_;
-      noDataVal_ = r.noDataVal_;
-      dimx_ = (maxx_ - minx_) / cellSize_ + 1;
-      dimy_ = (maxy_ - miny_) / cellSize_ + 1;
-      vals_ = std::make_unique<std::vector<float>>(*r.vals_);
-      // counts_ = std::make_unique<std::vector<int16_t>>(*r.counts_);
+      vals_.resize(dimx_ * dimy_);
+      counts_.resize(n_count_bands_ * dimx_ * dimy_);
     }
 
     void Raster::prefill_arrays(alg a) {
@@ -73,12 +48,12 @@ namespace roofer {
         noDataVal_ = 0;
       }
 
-      std::fill(vals_->begin(), vals_->end(), noDataVal_);
-      // std::fill(counts_->begin(), counts_->end(), 0);
+      std::fill(vals_.begin(), vals_.end(), noDataVal_);
+      std::fill(counts_.begin(), counts_.end(), 0);
     }
 
     bool Raster::add_point(double x, double y, double z, alg a) {
-      bool first = (*vals_)[getLinearCoord(x, y)] == noDataVal_;
+      bool first = vals_[getLinearCoord(x, y)] == noDataVal_;
       if (a == MIN) {
         min(x, y, z);
       } else if (a == MAX) {
@@ -88,7 +63,7 @@ namespace roofer {
     }
 
     bool Raster::add_value(double x, double y, double val) {
-      bool first = (*vals_)[getLinearCoord(x, y)] == noDataVal_;
+      bool first = vals_[getLinearCoord(x, y)] == noDataVal_;
       add(x, y, val);
       return first;
     }
@@ -104,30 +79,41 @@ namespace roofer {
     // inline void Raster::avg(double &x, double &y, double &val)
     // {
     //   size_t c = getLinearCoord(x,y);
-    //   (*vals_)[c]= ((*vals_)[c]*(*counts_)[c]+val)/((*counts_)[c]+1);
+    //   vals_[c]= (vals_[c]*(*counts_)[c]+val)/((*counts_)[c]+1);
     //   ++(*counts_)[c];
     // }
 
     inline void Raster::min(double &x, double &y, double &val) {
       size_t c = getLinearCoord(x, y);
-      if ((*vals_)[c] > val) (*vals_)[c] = val;
+      if (vals_[c] > val) vals_[c] = val;
     }
 
     inline void Raster::max(double &x, double &y, double &val) {
       size_t c = getLinearCoord(x, y);
-      if ((*vals_)[c] < val) (*vals_)[c] = val;
+      if (vals_[c] < val) vals_[c] = val;
     }
 
     inline void Raster::add(double &x, double &y, double &val) {
       size_t c = getLinearCoord(x, y);
-      (*vals_)[c] = (*vals_)[c] + val;
+      vals_[c] = vals_[c] + val;
     }
 
-    // inline void Raster::cnt(double &x, double &y)
-    // {
-    //   size_t c = getLinearCoord(x,y);
-    //   ++(*counts_)[c];
-    // }
+    void Raster::add_count(double x, double y, size_t band) {
+      auto &c = counts_[band * dimx_ * dimy_ + getLinearCoord(x, y)];
+      if (c < std::numeric_limits<count_t>::max()) ++c;
+    }
+
+    Image Raster::to_image() && {
+      Image image;
+      image.dim_x = dimx_;
+      image.dim_y = dimy_;
+      image.min_x = minx_;
+      image.min_y = miny_;
+      image.cellsize = cellSize_;
+      image.nodataval = noDataVal_;
+      image.array = std::move(vals_);
+      return image;
+    }
 
     std::array<double, 2> Raster::getColRowCoord(double x, double y) const {
       double r = (y - miny_) / cellSize_;
@@ -159,33 +145,33 @@ namespace roofer {
       std::array<float, 3> p;
       p[0] = minx_ + col * cellSize_ + cellSize_ / 2;
       p[1] = miny_ + row * cellSize_ + cellSize_ / 2;
-      p[2] = (*vals_)[col + row * dimx_];
+      p[2] = vals_[col + row * dimx_];
       return p;
     }
 
     double Raster::sample(double &x, double &y) {
-      return (*vals_)[getLinearCoord(x, y)];
+      return vals_[getLinearCoord(x, y)];
     }
 
     void Raster::set_val(size_t col, size_t row, double val) {
-      (*vals_)[col + row * dimx_] = val;
+      vals_[col + row * dimx_] = val;
     }
 
     double Raster::get_val(size_t col, size_t row) {
-      return (*vals_)[col + row * dimx_];
+      return vals_[col + row * dimx_];
     }
 
     bool Raster::isNoData(size_t col, size_t row) {
       return get_val(col, row) == noDataVal_;
     }
     bool Raster::isNoData(double &x, double &y) {
-      return (*vals_)[getLinearCoord(x, y)] == noDataVal_;
+      return vals_[getLinearCoord(x, y)] == noDataVal_;
     }
 
     void Raster::set_nodata(double new_nodata_val) {
       for (size_t i = 0; i < dimx_ * dimy_; ++i) {
-        if ((*vals_)[i] == noDataVal_) {
-          (*vals_)[i] = new_nodata_val;
+        if (vals_[i] == noDataVal_) {
+          vals_[i] = new_nodata_val;
         }
       }
       noDataVal_ = new_nodata_val;
@@ -197,8 +183,8 @@ namespace roofer {
 
       set_nodata(std::numeric_limits<float>::max());
       // iterate though raster pixels
-      for (size_t col = 0; col < dimx_; ++col) {
-        for (size_t row = 0; row < dimy_; ++row) {
+      for (size_t row = 0; row < dimy_; ++row) {
+        for (size_t col = 0; col < dimx_; ++col) {
           // if there is nodata here
           if (get_val(col, row) == noDataVal_) {
             // look in window of size radius around this pixel and collect the
@@ -219,7 +205,7 @@ namespace roofer {
           }
         }
       }
-      (*vals_) = new_vals;
+      vals_ = std::move(new_vals);
     }
 
     // void Raster::write(const char* WKGCS, alg a, void * dataPtr, const char*
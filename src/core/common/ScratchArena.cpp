@@ -0,0 +1,77 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <algorithm>
+#include <roofer/common/ScratchArena.hpp>
+
+namespace roofer {
+
+  void* ScratchArena::CountingResource::do_allocate(size_t bytes,
+                                                    size_t alignment) {
+    allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void ScratchArena::CountingResource::do_deallocate(void* p, size_t bytes,
+                                                     size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool ScratchArena::CountingResource::do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+  }
+
+  ScratchArena::ScratchArena(size_t initial_capacity, size_t max_capacity)
+      : capacity_(std::min(initial_capacity, max_capacity)),
+        max_capacity_(max_capacity),
+        buffer_(std::make_unique_for_overwrite<std::byte[]>(capacity_)) {
+    resource_.emplace(buffer_.get(), capacity_, &overflow_);
+  }
+
+  void ScratchArena::release() {
+    // rewinds to the start of buffer_ and frees the overflow blocks
+    resource_->release();
+    const size_t needed = capacity_ + overflow_.allocated;
+    overflow_.allocated = 0;
+    if (capacity_ < max_capacity_ && needed > capacity_) {
+      // grow the buffer so that next time everything fits in one block
+      capacity_ = std::min(needed, max_capacity_);
+      resource_.reset();
+      buffer_ = std::make_unique_for_overwrite<std::byte[]>(capacity_);
+      resource_.emplace(buffer_.get(), capacity_, &overflow_);
+    }
+  }
+
+  void* ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+    return resource_->allocate(bytes, alignment);
+  }
+
+  void ScratchArena::do_deallocate(void*, size_t, size_t) {
+    // memory is reclaimed in release()
+  }
+
+  bool ScratchArena::do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+  }
+
+}  // namespace roofer
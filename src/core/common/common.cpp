@@ -435,6 +435,12 @@ namespace roofer {
     attributes_.push_back(attributemap);
   }
 
+  void MultiTriangleCollection::clear() {
+    trianglecollections_.clear();
+    attributes_.clear();
+    building_part_ids_.clear();
+  }
+
   size_t MultiTriangleCollection::tri_size() const {
     return trianglecollections_.size();
   }
@@ -29,6 +29,11 @@
 #include <CGAL/Projection_traits_xy_3.h>
 #include <CGAL/Triangulation_face_base_with_info_2.h>
 
+#include <deque>
+#include <memory_resource>
+#include <stack>
+#include <unordered_map>
+
 namespace roofer::reconstruction {
   static const int EXTERIOR = -1, NEVER_VISITED = -2, HOLE = -3;
 
@@ -55,7 +60,11 @@ namespace roofer::reconstruction {
   typedef Alpha_shape_2::Edge_circulator Edge_circulator;
 
   class AlphaShapeRegionGrower {
+    typedef std::stack<Face_handle, std::pmr::deque<Face_handle>> FaceStack;
+
     Alpha_shape_2& A;
+    std::pmr::memory_resource* scratch_;
+    const Deadline* deadline_;
     enum Mode {
       LABEL_INFINITE_FACE,  // stop at alpha boundary
       LABEL_INTERIOR_FACE,  // stop at faces labels as exterior
@@ -66,8 +75,16 @@ namespace roofer::reconstruction {
     int hole_cnt = HOLE;
 
    public:
-    std::unordered_map<int, LinearRing> region_map;  // label: (boundary vertex)
-    AlphaShapeRegionGrower(Alpha_shape_2& as) : A(as){};
+    std::pmr::unordered_map<int, LinearRing>
+        region_map;  // label: (boundary vertex)
+    AlphaShapeRegionGrower(Alpha_shape_2& as,
+                           std::pmr::memory_resource* scratch,
+                           const Deadline* deadline = nullptr)
+        : A(as), scratch_(scratch), deadline_(deadline), region_map(scratch){};
+
+    void check_deadline() const {
+      if (deadline_) deadline_->check("AlphaShaper");
+    }
 
     template <typename RingType>
     void extract_ring(Vertex_handle v_start, int label_region, int label_other,
@@ -92,6 +109,8 @@ namespace roofer::reconstruction {
       bool firstv = true;
       Face_handle f_prev;
       do {
+        // the walk may not return to v_start, see the TODO above
+        check_deadline();
         Edge_circulator ec, done;
         if (firstv) {
           ec = A.incident_edges(v_cur);
@@ -181,7 +200,7 @@ namespace roofer::reconstruction {
     }
 
     void grow(bool extract_polygons) {
-      std::stack<Face_handle> interior_seeds, hole_seeds;
+      FaceStack interior_seeds(scratch_), hole_seeds(scratch_);
       // label triangles reachable from inf face as -1; ie exterior
       auto inf_face = A.infinite_face();
       inf_face->info().label = EXTERIOR;
@@ -222,10 +241,11 @@ namespace roofer::reconstruction {
 
     void grow_region(Face_handle face_handle, Mode mode,
                      bool extract_polygons = false) {
-      std::stack<Face_handle> candidates;
+      FaceStack candidates(scratch_);
       candidates.push(face_handle);
 
       while (candidates.size() > 0) {
+        check_deadline();
         auto fh = candidates.top();
         candidates.pop();
         // check the 3 neighbors of this face
@@ -298,20 +318,21 @@ namespace roofer::reconstruction {
   };
 
   class AlphaShaper : public AlphaShaperInterface {
+    std::pmr::memory_resource* scratch_;
+
+   public:
+    AlphaShaper(std::pmr::memory_resource* scratch) : scratch_(scratch) {}
+
     void compute(const IndexedPlanesWithPoints& pts_per_roofplane,
                  AlphaShaperConfig cfg) override {
+      reset();
       std::cout << std::fixed << std::setprecision(4);
 
-      PointCollection edge_points;
-      LineStringCollection alpha_edges;
-
-      std::vector<Triangulation_2> alpha_dts;
-      vec1i segment_ids;
       for (auto& it : pts_per_roofplane) {
         if (it.first == -1)
           continue;  // skip points if they put at index -1 (eg if we care not
                      // about slanted surfaces for ring extraction)
-        auto points = it.second.second;
+        const auto& points = it.second.second;
         if (points.size() < 3) continue;
         Triangulation_2 T;
         T.insert(points.begin(), points.end());
@@ -325,23 +346,25 @@ namespace roofer::reconstruction {
         }
         A.set_alpha(FT(alpha));
 
-        for (auto it = A.alpha_shape_vertices_begin();
-             it != A.alpha_shape_vertices_end(); it++) {
-          auto p = (*it)->point();
-          edge_points.push_back({float(p.x()), float(p.y()), float(p.z())});
-        }
-        for (auto it = A.alpha_shape_edges_begin();
-             it != A.alpha_shape_edges_end(); it++) {
-          auto p1 = it->first->vertex(A.cw(it->second))->point();
-          auto p2 = it->first->vertex(A.ccw(it->second))->point();
-
-          alpha_edges.push_back(
-              {{float(p1.x()), float(p1.y()), float(p1.z())},
-               {float(p2.x()), float(p2.y()), float(p2.z())}});
+        if (cfg.collect_debug) {
+          for (auto it = A.alpha_shape_vertices_begin();
+               it != A.alpha_shape_vertices_end(); it++) {
+            auto p = (*it)->point();
+            edge_points.push_back({float(p.x()), float(p.y()), float(p.z())});
+          }
+          for (auto it = A.alpha_shape_edges_begin();
+               it != A.alpha_shape_edges_end(); it++) {
+            auto p1 = it->first->vertex(A.cw(it->second))->point();
+            auto p2 = it->first->vertex(A.ccw(it->second))->point();
+
+            alpha_edges.push_back(
+                {{float(p1.x()), float(p1.y()), float(p1.z())},
+                 {float(p2.x()), float(p2.y()), float(p2.z())}});
+          }
         }
 
         // flood filling
-        auto grower = AlphaShapeRegionGrower(A);
+        auto grower = AlphaShapeRegionGrower(A, scratch_, cfg.deadline);
         grower.grow(cfg.extract_polygons);
 
         // collect triangles
@@ -360,30 +383,28 @@ namespace roofer::reconstruction {
                         float(fh->vertex(2)->point().y()),
                         float(fh->vertex(2)->point().z())};
             alpha_triangles.push_back({p0, p1, p2});
-            segment_ids.push_back(fh->info().label);
-            segment_ids.push_back(fh->info().label);
-            segment_ids.push_back(fh->info().label);
+            if (cfg.collect_debug) {
+              segment_ids.push_back(fh->info().label);
+              segment_ids.push_back(fh->info().label);
+              segment_ids.push_back(fh->info().label);
+            }
           }
         }
 
         for (auto& kv : grower.region_map) {
           // finally, store the ring
           if (kv.second.size() > 2) {
-            alpha_rings.push_back(kv.second);
+            alpha_rings.push_back(std::move(kv.second));
             roofplane_ids.push_back(it.first);
           }
-          // alpha_dts.push_back(T);
         }
       }
-
-      // output("alpha_edges").set(alpha_edges);
-      // output("segment_ids").set(segment_ids);
-      // output("edge_points").set(edge_points);
     }
   };
 
-  std::unique_ptr<AlphaShaperInterface> createAlphaShaper() {
-    return std::make_unique<AlphaShaper>();
+  std::unique_ptr<AlphaShaperInterface> createAlphaShaper(
+      std::pmr::memory_resource* scratch) {
+    return std::make_unique<AlphaShaper>(scratch);
   };
 
 }  // namespace roofer::reconstruction
@@ -348,6 +348,7 @@ namespace roofer::reconstruction {
 
         // if (lines_term.is_connected_type(typeid(linereg::Segment_2))) {
         for (size_t i = 0; i < input_edges.size(); ++i) {
+          if (cfg.deadline) cfg.deadline->check("ArrangementBuilder");
           auto& s = input_edges[i];
           if (cfg.insert_with_snap)
             arr_insert(arrangement, s, cfg.dist_threshold_exp);
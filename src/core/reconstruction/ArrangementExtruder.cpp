@@ -22,6 +22,9 @@
 #include <roofer/reconstruction/ArrangementBase.hpp>
 #include <roofer/reconstruction/ArrangementExtruder.hpp>
 
+#include <memory_resource>
+#include <unordered_map>
+
 namespace roofer::reconstruction {
 
   // typedef CGAL::Cartesian<float>           AK;
@@ -37,7 +40,12 @@ namespace roofer::reconstruction {
   }
 
   typedef std::pair<float, Face_handle> hf_pair;
-  vec3f get_heights(std::vector<hf_pair>& vertex_column, Vertex_handle v,
+  typedef std::pmr::vector<hf_pair> VertexColumn;
+  typedef std::pmr::unordered_map<Vertex_handle, VertexColumn> VertexColumnMap;
+  typedef std::pmr::unordered_map<Halfedge_handle, EPECK::Point_3>
+      ExtraWallPointMap;
+
+  vec3f get_heights(VertexColumn& vertex_column, Vertex_handle v,
                     Face_handle f_a, Face_handle f_b, float& h_a, float& h_b) {
     vec3f v_other;
     float h_prev = -999999;
@@ -72,11 +80,9 @@ namespace roofer::reconstruction {
   }
 
   template <typename T>
-  void push_ccb(
-      T& ring, Halfedge_handle hedge,
-      std::unordered_map<Vertex_handle, std::vector<hf_pair>>& vertex_columns,
-      std::unordered_map<Halfedge_handle, EPECK::Point_3>& extra_wall_points,
-      float& snap_tolerance) {
+  void push_ccb(T& ring, Halfedge_handle hedge,
+                VertexColumnMap& vertex_columns,
+                ExtraWallPointMap& extra_wall_points, float& snap_tolerance) {
     auto first = hedge;
     do {
       auto v = hedge->source();
@@ -101,10 +107,24 @@ namespace roofer::reconstruction {
   }
 
   class ArrangementExtruder : public ArrangementExtruderInterface {
+    std::pmr::memory_resource* scratch_;
+
+    void push_debug_face(const LinearRing& face, int label,
+                         const ArrangementExtruderConfig& cfg) {
+      if (cfg.collect_debug) {
+        faces.push_back(face);
+        labels.push_back(label);
+      }
+    }
+
    public:
+    ArrangementExtruder(std::pmr::memory_resource* scratch)
+        : scratch_(scratch) {}
+
     void compute(Arrangement_2& arr,
                  const ElevationProvider& elevation_provider,
                  ArrangementExtruderConfig cfg) override {
+      reset();
       typedef Arrangement_2::Traits_2 AT;
       float snap_tolerance = std::pow(10, -cfg.snap_tolerance_exp);
 
@@ -139,8 +159,7 @@ namespace roofer::reconstruction {
             he = he->next();
           } while (he != first);
 
-          faces.push_back(floor);
-          labels.push_back(int(0));
+          push_debug_face(floor, int(0), cfg);
 
           // create a mesh
           Mesh mesh;
@@ -188,12 +207,12 @@ namespace roofer::reconstruction {
       }
 
       // compute all heights for each vertex
-      std::unordered_map<Vertex_handle, std::vector<hf_pair>> vertex_columns;
+      VertexColumnMap vertex_columns(scratch_);
       for (auto& v : arr.vertex_handles()) {
         auto& p = v->point();
         auto he = v->incident_halfedges();
         auto first = he;
-        std::vector<hf_pair> heights;
+        VertexColumn heights(scratch_);
         do {
           auto f = he->face();
           float h;
@@ -231,13 +250,13 @@ namespace roofer::reconstruction {
           h_ref = h;
         }
 
-        vertex_columns[v] = heights;
+        vertex_columns[v] = std::move(heights);
       }
 
       // walls
       // store points that need to be created to do the walls right. We need
       // them later for the roofs
-      std::unordered_map<Halfedge_handle, EPECK::Point_3> extra_wall_points;
+      ExtraWallPointMap extra_wall_points(scratch_);
       if (cfg.do_walls) {
         for (auto edge : arr.edge_handles()) {
           auto e_a = edge->twin();
@@ -300,8 +319,7 @@ namespace roofer::reconstruction {
             wall_face_1.insert(wall_face_1.end(), v2_other.begin(),
                                v2_other.end());
             wall_face_1.push_back(v2p(v2, h2b));
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           } else if ((h1a > h1b) and (h2a > h2b)) {
@@ -315,8 +333,7 @@ namespace roofer::reconstruction {
             wall_face_1.insert(wall_face_1.end(), v1_other.begin(),
                                v1_other.end());
             wall_face_1.push_back(v2p(v1, h1a));
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           } else if ((h1a < h1b) and (h2a > h2b)) {
@@ -356,12 +373,10 @@ namespace roofer::reconstruction {
             wall_face_2.push_back(v2p(v2, h2b));
             wall_face_2.push_back(p2p(px));
 
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
-            faces.push_back(wall_face_2);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_2, wall_label, cfg);
             mesh.push_polygon(wall_face_2, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           } else if ((h1a > h1b) and (h2a < h2b)) {
@@ -401,12 +416,10 @@ namespace roofer::reconstruction {
             wall_face_2.push_back(v2p(v2, h2b));
             wall_face_2.push_back(p2p(px));
 
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
-            faces.push_back(wall_face_2);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_2, wall_label, cfg);
             mesh.push_polygon(wall_face_2, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           } else if ((h1a > h1b) and (h2a == h2b)) {
@@ -416,8 +429,7 @@ namespace roofer::reconstruction {
                                v1_other.end());
             wall_face_1.push_back(v2p(v1, h1a));
             wall_face_1.push_back(v2p(v2, h2a));
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           } else if ((h1a < h1b) and (h2a == h2b)) {
@@ -427,8 +439,7 @@ namespace roofer::reconstruction {
                                v1_other.rend());
             wall_face_1.push_back(v2p(v1, h1a));
             wall_face_1.push_back(v2p(v2, h2a));
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           } else if ((h2b > h2a) and (h1a == h1b)) {
@@ -438,8 +449,7 @@ namespace roofer::reconstruction {
                                v2_other.end());
             wall_face_1.push_back(v2p(v2, h2b));
             wall_face_1.push_back(v2p(v1, h1a));
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           } else if ((h2b < h2a) and (h1a == h1b)) {
@@ -449,8 +459,7 @@ namespace roofer::reconstruction {
                                v2_other.rend());
             wall_face_1.push_back(v2p(v2, h2b));
             wall_face_1.push_back(v2p(v1, h1a));
-            faces.push_back(wall_face_1);
-            labels.push_back(wall_label);
+            push_debug_face(wall_face_1, wall_label, cfg);
             mesh.push_polygon(wall_face_1, wall_label);
             // mesh.push_attribute("surface_type", wall_label);
           }
@@ -479,8 +488,7 @@ namespace roofer::reconstruction {
             }
 
             if (roofpart.size() > 2) {
-              faces.push_back(roofpart);
-              labels.push_back(int(1));
+              push_debug_face(roofpart, int(1), cfg);
               multisolid[face->data().part_id].push_polygon(roofpart, int(1));
               // mesh.push_attribute("surface_type", int(1));
             }
@@ -504,7 +512,8 @@ namespace roofer::reconstruction {
     }
   };
 
-  std::unique_ptr<ArrangementExtruderInterface> createArrangementExtruder() {
-    return std::make_unique<ArrangementExtruder>();
+  std::unique_ptr<ArrangementExtruderInterface> createArrangementExtruder(
+      std::pmr::memory_resource* scratch) {
+    return std::make_unique<ArrangementExtruder>(scratch);
   }
 }  // namespace roofer::reconstruction
@@ -243,6 +243,7 @@ namespace roofer::reconstruction {
       double cell_area = heightfield.cellSize_ * heightfield.cellSize_;
       std::vector<Face_handle> faces;
       for (auto face : arr.face_handles()) {
+        if (cfg.deadline) cfg.deadline->check("ArrangementOptimiser");
         if (face->data().in_footprint) {
           vec2f polygon;
           arrangementface_to_polygon(face, polygon);
@@ -285,6 +286,7 @@ namespace roofer::reconstruction {
       double max_weight = 0;
       std::vector<Halfedge_handle> edges;
       for (auto edge : arr.edge_handles()) {
+        if (cfg.deadline) cfg.deadline->check("ArrangementOptimiser");
         bool fp_u = edge->twin()->face()->data().in_footprint;
         bool fp_l = edge->face()->data().in_footprint;
         if (fp_u && fp_l) {  // only edges with both neighbour faces inside the
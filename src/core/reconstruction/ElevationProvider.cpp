@@ -19,6 +19,7 @@
 // Author(s):
 // Ivan Paden
 
+#include <roofer/common/percentile.hpp>
 #include <roofer/reconstruction/ElevationProvider.hpp>
 #include <roofer/reconstruction/cdt_util.hpp>
 
@@ -51,26 +52,10 @@ namespace roofer::reconstruction {
 
     virtual float get_percentile(float percentile) const override {
       std::vector<float> elevations;
-      // insert vertex elevation into the sorted vector
-      auto insertSorted = [&elevations](float elevation) {
-        auto position =
-            std::lower_bound(elevations.begin(), elevations.end(), elevation);
-        elevations.insert(position, elevation);
-      };
-      // iterate over all vertices and insert elevation
-      for (auto& pt : base_cdt_ptr_->points()) insertSorted(pt.z());
-      // return percentile
-      return compute_percentile(elevations, percentile);
-    }
-
-   private:
-    float compute_percentile(std::vector<float>& z_vec,
-                             float percentile) const {
-      assert(percentile <= 1.);
-      assert(percentile >= 0.);
-      size_t n = (z_vec.size() - 1) * percentile;
-      std::nth_element(z_vec.begin(), z_vec.begin() + n, z_vec.end());
-      return z_vec[n];
+      elevations.reserve(base_cdt_ptr_->number_of_vertices());
+      for (auto& pt : base_cdt_ptr_->points()) elevations.push_back(pt.z());
+      return compute_percentiles(elevations.begin(), elevations.end(),
+                                 {double(percentile)})[0];
     }
   };
 
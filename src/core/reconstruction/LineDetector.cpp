@@ -180,6 +180,19 @@ namespace roofer::reconstruction {
   }
 
   class LineDetector : public LineDetectorInterface {
+    void collect_ring_debug(size_t plane_id, size_t n_detected,
+                            size_t& seg_cntr) {
+      for (size_t j = 0; j < n_detected; ++j) {
+        ring_idx[plane_id].push_back(seg_cntr++);
+        ring_order.push_back(j);
+        ring_id.push_back(plane_id);
+        ring_order.push_back(j);
+        ring_id.push_back(plane_id);
+        is_start.push_back(1);
+        is_start.push_back(0);
+      }
+    }
+
    public:
     using LineDetectorInterface::LineDetectorInterface;
 
@@ -187,10 +200,7 @@ namespace roofer::reconstruction {
                 const vec1i& roofplane_ids,
                 const IndexedPlanesWithPoints& pts_per_roofplane,
                 LineDetectorConfig cfg) override {
-      SegmentCollection lines3d;
-      vec1i ring_order, ring_id, is_start;
-      std::unordered_map<size_t, std::vector<size_t>> ring_idx;
-
+      reset();
       int n = cfg.k;
 
       size_t seg_cntr = 0, plane_id;
@@ -206,17 +216,9 @@ namespace roofer::reconstruction {
         // SegmentCollection ring_edges;
         auto n_detected = detect_lines_ring(
             LD, pts_per_roofplane.at(plane_id).first, edge_segments, cfg);
-        LD.get_bounded_edges(lines3d);
-
-        for (size_t j = 0; j < n_detected; ++j) {
-          // edge_segments.push_back(ring_edges[j]);
-          ring_idx[plane_id].push_back(seg_cntr++);
-          ring_order.push_back(j);
-          ring_id.push_back(plane_id);
-          ring_order.push_back(j);
-          ring_id.push_back(plane_id);
-          is_start.push_back(1);
-          is_start.push_back(0);
+        if (cfg.collect_debug) {
+          LD.get_bounded_edges(lines3d);
+          collect_ring_debug(plane_id, n_detected, seg_cntr);
         }
 
         // also check the holes
@@ -230,31 +232,14 @@ namespace roofer::reconstruction {
           // SegmentCollection ring_edges;
           auto n_detected = detect_lines_ring(
               LD, pts_per_roofplane.at(plane_id).first, edge_segments, cfg);
-          LD.get_bounded_edges(lines3d);
-
-          for (size_t j = 0; j < n_detected; ++j) {
-            // edge_segments.push_back(ring_edges[j]);
-            ring_idx[plane_id].push_back(seg_cntr++);
-            ring_order.push_back(j);
-            ring_id.push_back(plane_id);
-            ring_order.push_back(j);
-            ring_id.push_back(plane_id);
-            is_start.push_back(1);
-            is_start.push_back(0);
+          if (cfg.collect_debug) {
+            LD.get_bounded_edges(lines3d);
+            collect_ring_debug(plane_id, n_detected, seg_cntr);
           }
         }
         // std::cout << "number of shapes: " << LD.segment_shapes.size() <<"\n";
         // std::cout << "number of segments: " << order_cnt <<"\n";
       }
-      // }
-
-      // output("edge_segments").set(edge_segments);
-      // output("lines3d").set(lines3d);
-      // // output("ring_edges").set(ring_edges);
-      // output("ring_idx").set(ring_idx);
-      // output("ring_id").set(ring_id);
-      // output("ring_order").set(ring_order);
-      // output("is_start").set(is_start);
     }
   };
 
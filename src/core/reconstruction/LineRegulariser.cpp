@@ -28,6 +28,7 @@ namespace roofer::reconstruction {
     void compute(const SegmentCollection& edge_segments,
                  const SegmentCollection& ints_segments,
                  LineRegulariserConfig cfg) override {
+      reset();
       // get clusters from line regularisation
       auto LR = linereg::LineRegulariser();
       LR.add_segments(0, edge_segments);
@@ -166,6 +166,7 @@ namespace roofer::reconstruction {
    public:
     void compute(const std::vector<Mesh>& meshes,
                  MeshTriangulatorConfig cfg) override {
+      reset();
       typedef uint32_t N;
 
       roofer::MultiTriangleCollection multitranglecol;
@@ -195,6 +196,7 @@ namespace roofer::reconstruction {
     }
     void compute(const std::vector<LinearRing>& polygons,
                  MeshTriangulatorConfig cfg) override {
+      reset();
       // const auto &values_in = input("valuesf").get<vec1f>();
       typedef uint32_t N;
 
@@ -209,6 +211,7 @@ namespace roofer::reconstruction {
 
     void compute(const std::unordered_map<int, Mesh>& multisolid,
                  MeshTriangulatorConfig cfg) override {
+      reset();
       // const auto &values_in = input("valuesf").get<vec1f>();
       typedef uint32_t N;
 
@@ -29,6 +29,7 @@
 #include <boost/container_hash/hash_fwd.hpp>
 #include <cstddef>
 #include <functional>
+#include <roofer/common/percentile.hpp>
 #include <roofer/reconstruction/PlaneDetector.hpp>
 #include <roofer/reconstruction/PlaneDetectorBase.hpp>
 #include <utility>
@@ -61,7 +62,7 @@ namespace roofer {
   typedef CGAL::Nth_of_tuple_property_map<7, PNL> JumpEle_map;
   typedef CGAL::Nth_of_tuple_property_map<8, PNL> Id_map;
   typedef CGAL::Nth_of_tuple_property_map<9, PNL> IsHorizontal_map;
-  typedef std::vector<PNL> PNL_vector;
+  typedef std::pmr::vector<PNL> PNL_vector;
 
   struct AdjacencyFinder {
     typedef CGAL::Search_traits_3<EPICK> Traits_base;
@@ -105,14 +106,6 @@ namespace roofer {
     };
   };
 
-  float compute_percentile(std::vector<float>& z_vec, float percentile) {
-    assert(percentile <= 1.);
-    assert(percentile >= 0.);
-    size_t n = (z_vec.size() - 1) * percentile;
-    std::nth_element(z_vec.begin(), z_vec.begin() + n, z_vec.end());
-    return z_vec[n];
-  }
-
   namespace reconstruction {
 
 // Concurrency
@@ -204,13 +197,17 @@ namespace roofer {
     };
 
     class PlaneDetector : public PlaneDetectorInterface {
+      std::pmr::memory_resource* scratch_;
+
      public:
-      using PlaneDetectorInterface::PlaneDetectorInterface;
+      PlaneDetector(std::pmr::memory_resource* scratch) : scratch_(scratch) {}
 
       void detect(const PointCollection& points,
                   const PlaneDetectorConfig cfg) override {
+        reset();
         // convert to cgal points with attributes
-        PNL_vector pnl_points;
+        PNL_vector pnl_points(scratch_);
+        pnl_points.reserve(points.size());
         for (auto& p : points) {
           PNL pv;
           boost::get<0>(pv) = Point(p[0], p[1], p[2]);
@@ -242,7 +239,8 @@ namespace roofer {
         // size_t slant_roofplane_cnt=0;
         // size_t horiz_pt_cnt=0, total_pt_cnt=0, wall_pt_cnt=0,
         // unsegmented_pt_cnt=0, total_plane_cnt=0;
-        vec1f roof_elevations;
+        std::pmr::vector<float> roof_elevations(scratch_);
+        roof_elevations.reserve(points.size());
 
         std::vector<Plane> planes;
 
@@ -296,7 +294,8 @@ namespace roofer {
             if (!is_wall) {
               ++shape_id;
               planes.push_back(plane);
-              std::vector<Point> segpts;
+              auto& [seg_plane, segpts] = pts_per_roofplane[shape_id];
+              seg_plane = plane;
               for (auto& i : region.inliers) {
                 segpts.push_back(boost::get<0>(pnl_points[i]));
                 roof_elevations.push_back(
@@ -306,8 +305,6 @@ namespace roofer {
                 boost::get<9>(pnl_points[i]) = is_horizontal;
               }
               total_pt_cnt += segpts.size();
-              pts_per_roofplane[shape_id].second = segpts;
-              pts_per_roofplane[shape_id].first = plane;
 
               if (is_horizontal) {
                 horiz_pt_cnt += segpts.size();
@@ -363,7 +360,8 @@ namespace roofer {
             if (!is_wall) {
               ++shape_id;
               planes.push_back(plane);
-              std::vector<Point> segpts;
+              auto& [seg_plane, segpts] = pts_per_roofplane[shape_id];
+              seg_plane = plane;
               for (auto& i : shape->indices_of_assigned_points()) {
                 segpts.push_back(boost::get<0>(pnl_points[i]));
                 roof_elevations.push_back(
@@ -373,8 +371,6 @@ namespace roofer {
                 boost::get<9>(pnl_points[i]) = is_horizontal;
               }
               total_pt_cnt += segpts.size();
-              pts_per_roofplane[shape_id].second = segpts;
-              pts_per_roofplane[shape_id].first = plane;
 
               if (is_horizontal) {
                 horiz_pt_cnt += segpts.size();
@@ -484,16 +480,20 @@ namespace roofer {
         }
 
         if (roof_elevations.size()) {
-          roof_elevation_70p = compute_percentile(roof_elevations, 0.7);
-          roof_elevation_50p = compute_percentile(roof_elevations, 0.5);
-          roof_elevation_min = compute_percentile(roof_elevations, 0.0);
-          roof_elevation_max = compute_percentile(roof_elevations, 1.0);
+          auto [h70, h50, hmin, hmax] =
+              compute_percentiles(roof_elevations.begin(),
+                                  roof_elevations.end(), {0.7, 0.5, 0.0, 1.0});
+          roof_elevation_70p = h70;
+          roof_elevation_50p = h50;
+          roof_elevation_min = hmin;
+          roof_elevation_max = hmax;
         }
       }
     };
 
-    std::unique_ptr<PlaneDetectorInterface> createPlaneDetector() {
-      return std::make_unique<PlaneDetector>();
+    std::unique_ptr<PlaneDetectorInterface> createPlaneDetector(
+        std::pmr::memory_resource* scratch) {
+      return std::make_unique<PlaneDetector>(scratch);
     };
 
   }  // namespace reconstruction
@@ -64,6 +64,7 @@ namespace roofer::reconstruction {
     void compute(const IndexedPlanesWithPoints& pts_per_roofplane,
                  const std::map<size_t, std::map<size_t, size_t>>& plane_adj,
                  PlaneIntersectorConfig cfg) override {
+      reset();
       float min_dist_to_line_sq = cfg.min_dist_to_line * cfg.min_dist_to_line;
       float sq_min_length = cfg.min_length * cfg.min_length;
 
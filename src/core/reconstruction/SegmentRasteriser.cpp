@@ -42,16 +42,18 @@ namespace roofer::reconstruction {
         auto cr_min = r.getColRowCoord(bb_min[0], bb_min[1]);
         auto cr_max = r.getColRowCoord(bb_max[0], bb_max[1]);
 
-        auto points_inside = r.rasterise_polygon(triangle, cr_min, cr_max);
-        for (auto& p : points_inside) {
-          double z_interpolate = -plane.a() / plane.c() * p[0] -
-                                 plane.b() / plane.c() * p[1] -
-                                 plane.d() / plane.c();
-          if (r.add_point(p[0], p[1], z_interpolate, RasterTools::MAX)) {
-            ++data_pixel_cnt;  // only count new cells (that were not written to
-                               // before)
-          }
-        }
+        double a = -plane.a() / plane.c(), b = -plane.b() / plane.c(),
+               d = -plane.d() / plane.c();
+        r.visit_polygon_cells(
+            triangle, cr_min, cr_max,
+            [&](size_t col, size_t row, float x, float y) {
+              double z_interpolate = a * x + b * y + d;
+              if (r.add_cell_value(col, row, z_interpolate,
+                                   RasterTools::MAX)) {
+                ++data_pixel_cnt;  // only count new cells (that were not
+                                   // written to before)
+              }
+            });
         // do plane projection
         // auto& plane = pts_per_roofplane[roofplane_ids[i]].first;
         // double z_interpolate = -plane.a()/plane.c() * p[0] -
@@ -62,6 +64,7 @@ namespace roofer::reconstruction {
     void compute(TriangleCollection& roof_triangles,
                  TriangleCollection& ground_triangles,
                  SegmentRasteriserConfig cfg) override {
+      reset();
       // spdlog::debug("roof_triangles has {} triangles",
       // roof_triangles.size()); spdlog::debug("ground_triangles has {}
       // triangles", ground_triangles.size());
@@ -95,23 +98,20 @@ namespace roofer::reconstruction {
 
       if (cfg.fill_nodata_) heightfield.fill_nn(cfg.fill_nodata_window_size_);
 
-      PointCollection grid_points;
-      vec1f values;
-      double nodata = heightfield.getNoDataVal();
-      for (size_t i = 0; i < heightfield.dimx_; ++i) {
+      data_area = float(roofdata_area_cnt) * cellsize_ * cellsize_;
+
+      if (cfg.collect_debug) {
+        double nodata = heightfield.getNoDataVal();
         for (size_t j = 0; j < heightfield.dimy_; ++j) {
-          auto p = heightfield.getPointFromRasterCoords(i, j);
-          if (p[2] != nodata) {
-            grid_points.push_back(p);
-            values.push_back(p[2]);
+          for (size_t i = 0; i < heightfield.dimx_; ++i) {
+            auto p = heightfield.getPointFromRasterCoords(i, j);
+            if (p[2] != nodata) {
+              grid_points.push_back(p);
+              values.push_back(p[2]);
+            }
           }
         }
       }
-      // spdlog::debug("heightfield has {} values", values.size());
-      // output("data_area").set(float(roofdata_area_cnt)*cellsize_*cellsize_);
-      // output("heightfield").set(r);
-      // output("values").set(values);
-      // output("grid_points").set(grid_points);
     }
   };
 
@@ -27,6 +27,7 @@ namespace roofer::reconstruction {
   class SimplePolygonExtruder : public SimplePolygonExtruderInterface {
     void compute(LinearRing& ring, float& h_floor, float& h_roof,
                  SimplePolygonExtruderConfig cfg) override {
+      reset();
       // assume ring is CCW oriented
       Mesh mesh;
 
@@ -0,0 +1,371 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <algorithm>
+#include <cstring>
+#include <roofer/io/CityJsonBinaryWriter.hpp>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+
+namespace roofer::io {
+
+  using namespace roofer::cjb;
+
+  class CityJsonBinaryWriter : public CityJsonBinaryWriterInterface {
+    using MeshMap = std::unordered_map<int, Mesh>;
+
+    struct VertexHash {
+      size_t operator()(const arr3d& v) const {
+        size_t h = std::hash<double>{}(v[0]);
+        h ^= std::hash<double>{}(v[1]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<double>{}(v[2]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+      }
+    };
+
+    // the columns of the feature that is being encoded, reused between
+    // features
+    std::string strings_;
+    std::unordered_map<std::string, StringRef> string_map_;
+    std::unordered_map<arr3d, uint32_t, VertexHash> vertex_map_;
+    std::vector<Vertex> vertices_;
+    std::vector<ObjectRecord> objects_;
+    std::vector<GeometryRecord> geometries_;
+    std::vector<SurfaceRecord> surfaces_;
+    std::vector<Span> rings_;
+    std::vector<uint32_t> indices_;
+    std::vector<SemanticRecord> semantics_;
+    std::vector<AttributeRecord> attributes_;
+    std::vector<AttributeMapRow::amrmap::const_pointer> sorted_attributes_;
+
+    void clear() {
+      strings_.clear();
+      string_map_.clear();
+      vertex_map_.clear();
+      vertices_.clear();
+      objects_.clear();
+      geometries_.clear();
+      surfaces_.clear();
+      rings_.clear();
+      indices_.clear();
+      semantics_.clear();
+      attributes_.clear();
+    }
+
+    StringRef add_string(const std::string& s) {
+      auto [it, did_insert] = string_map_.try_emplace(s);
+      if (did_insert) {
+        it->second = {uint32_t(strings_.size()), uint32_t(s.size())};
+        strings_.append(s);
+      }
+      return it->second;
+    }
+
+    uint32_t add_vertex(const arr3d& vertex) {
+      auto [it, did_insert] =
+          vertex_map_.try_emplace(vertex, uint32_t(vertices_.size()));
+      if (did_insert) {
+        vertices_.push_back({int((vertex[0] - translate_x_) / scale_x_),
+                             int((vertex[1] - translate_y_) / scale_y_),
+                             int((vertex[2] - translate_z_) / scale_z_)});
+      }
+      return it->second;
+    }
+
+    // attribute values are stored as they are written to CityJSON, so
+    // date/time values become strings
+    AttributeRecord make_attribute(
+        const std::string& key,
+        const AttributeMapRow::amrmap::mapped_type& value) {
+      AttributeRecord a{};
+      a.key = add_string(key);
+      a.type = AttributeType::Null;
+      if (auto val = std::get_if<bool>(&value)) {
+        a.type = AttributeType::Bool;
+        a.int_value = *val;
+      } else if (auto val = std::get_if<float>(&value)) {
+        a.type = AttributeType::Float;
+        a.float_value = *val;
+      } else if (auto val = std::get_if<int>(&value)) {
+        a.type = AttributeType::Int;
+        a.int_value = *val;
+      } else if (auto val = std::get_if<std::string>(&value)) {
+        a.type = AttributeType::String;
+        a.string_value = add_string(*val);
+      } else if (auto val = std::get_if<Date>(&value)) {
+        auto t = *val;
+        a.type = AttributeType::String;
+        a.string_value = add_string(t.format_to_ietf());
+      } else if (auto val = std::get_if<Time>(&value)) {
+        auto t = *val;
+        a.type = AttributeType::String;
+        a.string_value = add_string(
+            std::to_string(t.hour) + ":" + std::to_string(t.minute) + ":" +
+            std::to_string(t.second) + "Z");
+      } else if (auto val = std::get_if<DateTime>(&value)) {
+        auto t = *val;
+        a.type = AttributeType::String;
+        a.string_value = add_string(t.format_to_ietf());
+      }
+      return a;
+    }
+
+    // adds the attributes sorted by key, arr3f attributes are left out like
+    // in the json output
+    Span add_attributes(const AttributeMapRow& attributes) {
+      sorted_attributes_.clear();
+      for (const auto& attribute : attributes) {
+        if (std::holds_alternative<arr3f>(attribute.second)) continue;
+        sorted_attributes_.push_back(&attribute);
+      }
+      std::sort(sorted_attributes_.begin(), sorted_attributes_.end(),
+                [](auto a, auto b) { return a->first < b->first; });
+
+      Span span{uint32_t(attributes_.size()), 0};
+      for (auto attribute : sorted_attributes_) {
+        attributes_.push_back(
+            make_attribute(attribute->first, attribute->second));
+      }
+      span.count = attributes_.size() - span.first;
+      return span;
+    }
+
+    template <typename T>
+    Span add_ring(const T& ring) {
+      Span span{uint32_t(indices_.size()), uint32_t(ring.size())};
+      for (auto& vertex : ring) {
+        indices_.push_back(add_vertex(pjHelper.coord_transform_rev(vertex)));
+      }
+      return span;
+    }
+
+    void add_surface(const LinearRing& polygon, int32_t semantic) {
+      Span rings{uint32_t(rings_.size()),
+                 uint32_t(1 + polygon.interior_rings().size())};
+      rings_.push_back(add_ring(polygon));
+      for (auto& iring : polygon.interior_rings()) {
+        rings_.push_back(add_ring(iring));
+      }
+      surfaces_.push_back({rings, semantic});
+    }
+
+    void add_footprint(const LinearRing& footprint) {
+      GeometryRecord g{};
+      g.type = GeometryType::MultiSurface;
+      g.lod = add_string("0");
+      g.surfaces = {uint32_t(surfaces_.size()), 1};
+      g.semantics = {uint32_t(semantics_.size()), 0};
+      add_surface(footprint, -1);
+      geometries_.push_back(g);
+    }
+
+    void add_solid(const Mesh& mesh, const std::string& lod) {
+      auto& polygons = mesh.get_polygons();
+      auto& labels = mesh.get_labels();
+      bool has_attributes = mesh.get_attributes().size();
+      // check the mesh first so that nothing needs to be undone on failure
+      for (size_t i = 0; i < polygons.size(); ++i) {
+        if (labels[i] < 0 || labels[i] > 3)
+          throw rooferException("Unknown label in mesh");
+        if (labels[i] == 1 && has_attributes) mesh.get_attributes().at(i);
+      }
+
+      GeometryRecord g{};
+      g.type = GeometryType::Solid;
+      g.lod = add_string(lod);
+      g.surfaces = {uint32_t(surfaces_.size()), uint32_t(polygons.size())};
+      g.semantics.first = semantics_.size();
+
+      // the same fixed semantic surfaces as in the json output, followed by
+      // one per roof surface
+      semantics_.push_back({SemanticType::GroundSurface, {}});
+      for (bool on_footprint_edge : {true, false}) {
+        AttributeRecord a{};
+        a.key = add_string("on_footprint_edge");
+        a.type = AttributeType::Bool;
+        a.int_value = on_footprint_edge;
+        semantics_.push_back({SemanticType::WallSurface,
+                              {uint32_t(attributes_.size()), 1}});
+        attributes_.push_back(a);
+      }
+      int32_t roof_cntr = 3;
+      for (size_t i = 0; i < polygons.size(); ++i) {
+        int32_t semantic;
+        if (labels[i] == 0) {  // GroundSurface
+          semantic = 0;
+        } else if (labels[i] == 1) {  // RoofSurface
+          Span attributes;
+          if (has_attributes) {
+            attributes = add_attributes(mesh.get_attributes().at(i));
+          }
+          semantics_.push_back({SemanticType::RoofSurface, attributes});
+          semantic = roof_cntr++;
+        } else if (labels[i] == 2) {  // WallSurface on footprint edge
+          semantic = 1;
+        } else {  // WallSurface not on footprint edge
+          semantic = 2;
+        }
+        add_surface(polygons[i], semantic);
+      }
+      g.semantics.count = semantics_.size() - g.semantics.first;
+      geometries_.push_back(g);
+    }
+
+    void add_building_part(const std::string& b_id, int sid,
+                           const MeshMap* multisolid_lod12,
+                           const MeshMap* multisolid_lod13,
+                           const MeshMap* multisolid_lod22) {
+      ObjectRecord part{};
+      part.id = add_string(b_id + "-" + std::to_string(sid));
+      part.type = ObjectType::BuildingPart;
+      part.parent = 0;
+      part.geometries.first = geometries_.size();
+
+      // like in the json output, LoD 1.2 and 1.3 solids are skipped when the
+      // sid's between the lod's do not line up. add_solid() throws before it
+      // adds anything, so there is nothing to roll back.
+      auto add_lod = [&](const MeshMap* meshmap, const char* lod) {
+        try {
+          add_solid(meshmap->at(sid), lod);
+        } catch (const std::exception& e) {
+        }
+      };
+      if (multisolid_lod12) add_lod(multisolid_lod12, "1.2");
+      if (multisolid_lod13) add_lod(multisolid_lod13, "1.3");
+      if (multisolid_lod22) {
+        add_solid(multisolid_lod22->at(sid), "2.2");
+      }
+
+      part.geometries.count = geometries_.size() - part.geometries.first;
+      objects_.push_back(part);
+    }
+
+    std::string building_id(const AttributeMapRow& attributes,
+                            std::string b_id) {
+      if (!attributes.has_name(identifier_attribute)) return b_id;
+      if (auto val = attributes.get_if<float>(identifier_attribute)) {
+        b_id = std::to_string(*val);
+      } else if (auto val = attributes.get_if<int>(identifier_attribute)) {
+        b_id = std::to_string(*val);
+      } else if (auto val =
+                     attributes.get_if<std::string>(identifier_attribute)) {
+        b_id = *val;
+      }
+      return b_id;
+    }
+
+    static void pad(std::string& output) {
+      output.resize((output.size() + 7) & ~size_t(7), '\0');
+    }
+
+    template <typename T>
+    static void append_column(std::string& output, size_t header_offset,
+                              const T* data, size_t count, Column& column) {
+      pad(output);
+      column.offset = output.size() - header_offset;
+      column.count = count;
+      output.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+    }
+
+   public:
+    using CityJsonBinaryWriterInterface::CityJsonBinaryWriterInterface;
+
+    void write_header(std::ostream& output_stream,
+                      std::string_view metadata) override {
+      FileHeader header;
+      header.metadata_size = metadata.size();
+      header.scale = {scale_x_, scale_y_, scale_z_};
+      header.translate = {translate_x_, translate_y_, translate_z_};
+
+      std::string output(reinterpret_cast<const char*>(&header),
+                         sizeof(FileHeader));
+      output.append(metadata);
+      pad(output);
+      output_stream.write(output.data(), output.size());
+    }
+
+    void encode_feature(std::string& output, const LinearRing& footprint,
+                        const MeshMap* multisolid_lod12,
+                        const MeshMap* multisolid_lod13,
+                        const MeshMap* multisolid_lod22,
+                        const AttributeMapRow& attributes,
+                        size_t feature_id) override {
+      clear();
+      auto b_id = building_id(attributes, std::to_string(feature_id));
+
+      FeatureHeader header{};
+      header.id = add_string(b_id);
+
+      // the Building, with the footprint first to get the same vertex order
+      // as the json output
+      ObjectRecord building{};
+      building.id = header.id;
+      building.type = ObjectType::Building;
+      building.parent = -1;
+      building.geometries = {0, 1};
+      add_footprint(footprint);
+      building.attributes = add_attributes(attributes);
+      objects_.push_back(building);
+
+      const MeshMap* meshmap = multisolid_lod22   ? multisolid_lod22
+                               : multisolid_lod13 ? multisolid_lod13
+                                                  : multisolid_lod12;
+      if (meshmap) {
+        for (const auto& [sid, solid_lodx] : *meshmap) {
+          add_building_part(b_id, sid, multisolid_lod12, multisolid_lod13,
+                            multisolid_lod22);
+        }
+      }
+
+      output.clear();
+      output.resize(sizeof(uint64_t) + sizeof(FeatureHeader));
+      const size_t h = sizeof(uint64_t);
+      append_column(output, h, strings_.data(), strings_.size(),
+                    header.strings);
+      append_column(output, h, vertices_.data(), vertices_.size(),
+                    header.vertices);
+      append_column(output, h, objects_.data(), objects_.size(),
+                    header.objects);
+      append_column(output, h, geometries_.data(), geometries_.size(),
+                    header.geometries);
+      append_column(output, h, surfaces_.data(), surfaces_.size(),
+                    header.surfaces);
+      append_column(output, h, rings_.data(), rings_.size(), header.rings);
+      append_column(output, h, indices_.data(), indices_.size(),
+                    header.indices);
+      append_column(output, h, semantics_.data(), semantics_.size(),
+                    header.semantics);
+      append_column(output, h, attributes_.data(), attributes_.size(),
+                    header.attributes);
+      pad(output);
+
+      uint64_t record_size = output.size() - h;
+      std::memcpy(output.data(), &record_size, sizeof(uint64_t));
+      std::memcpy(output.data() + h, &header, sizeof(FeatureHeader));
+    }
+  };
+
+  std::unique_ptr<CityJsonBinaryWriterInterface> createCityJsonBinaryWriter(
+      roofer::misc::projHelperInterface& pjh) {
+    return std::make_unique<CityJsonBinaryWriter>(pjh);
+  };
+}  // namespace roofer::io
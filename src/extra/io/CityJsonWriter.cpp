@@ -20,129 +20,483 @@
 // Ravi Peters
 // Balazs Dukai
 
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <roofer/io/CityJsonWriter.hpp>
-#include <set>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
 
 namespace roofer::io {
 
   namespace fs = std::filesystem;
 
   class CityJsonWriter : public CityJsonWriterInterface {
+    using MeshMap = std::unordered_map<int, Mesh>;
+    using Buffer = fmt::memory_buffer;
+
+    struct VertexHash {
+      size_t operator()(const arr3d& v) const {
+        size_t h = std::hash<double>{}(v[0]);
+        h ^= std::hash<double>{}(v[1]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<double>{}(v[2]) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+      }
+    };
+
+    // a serialised CityObject in parts_buffer_
+    struct ObjectSpan {
+      std::string id;
+      size_t begin;
+      size_t end;
+    };
+
+    // These are reused between features so that after the first few features
+    // serialisation no longer allocates.
+    Buffer buffer_;
+    Buffer parts_buffer_;
+    Buffer geometry_buffer_;
+    Buffer values_buffer_;
+    std::vector<ObjectSpan> parts_;
+    std::unordered_map<arr3d, size_t, VertexHash> vertex_map_;
+    std::vector<std::array<int, 3>> vertices_;
+    std::vector<AttributeMapRow::amrmap::const_pointer> sorted_attributes_;
+    // set when a string that is not valid UTF-8 was written, this fails the
+    // feature once it is complete
+    std::optional<std::string> utf8_error_;
+
+    // The output below follows what nlohmann::json::dump() produced for the
+    // same feature: object keys are written in sorted order, floats are laid
+    // out the same way and strings are escaped the same way.
+
+    static void write_raw(Buffer& buf, std::string_view s) {
+      buf.append(s.data(), s.data() + s.size());
+    }
+
+    // Goes through nlohmann's serializer, so the digits are exactly those of
+    // json::dump(). Its Grisu2 does not always pick the same shortest digits
+    // as std::to_chars.
+    static void write_double(Buffer& buf, double value) {
+      write_raw(buf, nlohmann::json(value).dump());
+    }
+
     template <typename T>
-    void add_vertices_ring(std::map<arr3d, size_t>& vertex_map,
-                           std::vector<arr3d>& vertex_vec,
-                           std::set<arr3d>& vertex_set, const T& ring,
-                           TBox<double>& bbox) {
-      size_t v_cntr = vertex_vec.size();
-      for (auto& vertex_ : ring) {
-        auto vertex = pjHelper.coord_transform_rev(vertex_);
-        bbox.add(vertex);
-        auto [it, did_insert] = vertex_set.insert(vertex);
-        if (did_insert) {
-          vertex_map[vertex] = v_cntr++;
-          vertex_vec.push_back(vertex);
+    static void write_int(Buffer& buf, T value) {
+      fmt::format_to(fmt::appender(buf), "{}", value);
+    }
+
+    static void write_escaped_codepoint(Buffer& buf, uint32_t codepoint) {
+      switch (codepoint) {
+        case 0x08:
+          write_raw(buf, "\\b");
+          break;
+        case 0x09:
+          write_raw(buf, "\\t");
+          break;
+        case 0x0A:
+          write_raw(buf, "\\n");
+          break;
+        case 0x0C:
+          write_raw(buf, "\\f");
+          break;
+        case 0x0D:
+          write_raw(buf, "\\r");
+          break;
+        case 0x22:
+          write_raw(buf, "\\\"");
+          break;
+        case 0x5C:
+          write_raw(buf, "\\\\");
+          break;
+        default:
+          fmt::format_to(fmt::appender(buf), "\\u{:04x}", codepoint);
+      }
+    }
+
+    // length of the valid UTF-8 sequence that starts at s[i], 0 if invalid
+    static size_t utf8_sequence_length(std::string_view s, size_t i) {
+      auto byte = [&](size_t j) -> uint8_t {
+        return j < s.size() ? uint8_t(s[j]) : 0;
+      };
+      auto cont = [&](size_t j, uint8_t lo = 0x80, uint8_t hi = 0xBF) {
+        return byte(j) >= lo && byte(j) <= hi;
+      };
+      uint8_t b = byte(i);
+      if (b >= 0xC2 && b <= 0xDF) return cont(i + 1) ? 2 : 0;
+      if (b == 0xE0) return cont(i + 1, 0xA0) && cont(i + 2) ? 3 : 0;
+      if (b == 0xED) return cont(i + 1, 0x80, 0x9F) && cont(i + 2) ? 3 : 0;
+      if (b >= 0xE1 && b <= 0xEF) return cont(i + 1) && cont(i + 2) ? 3 : 0;
+      if (b == 0xF0)
+        return cont(i + 1, 0x90) && cont(i + 2) && cont(i + 3) ? 4 : 0;
+      if (b == 0xF4)
+        return cont(i + 1, 0x80, 0x8F) && cont(i + 2) && cont(i + 3) ? 4 : 0;
+      if (b >= 0xF1 && b <= 0xF3)
+        return cont(i + 1) && cont(i + 2) && cont(i + 3) ? 4 : 0;
+      return 0;
+    }
+
+    void write_string(Buffer& buf, std::string_view s) {
+      buf.push_back('"');
+      size_t i = 0;
+      while (i < s.size()) {
+        // copy runs of characters that need no escaping in one go
+        size_t run = i;
+        while (run < s.size()) {
+          auto c = uint8_t(s[run]);
+          if (c < 0x20 || c == '"' || c == '\\' || c >= 0x80) break;
+          ++run;
+        }
+        buf.append(s.data() + i, s.data() + run);
+        i = run;
+        if (i == s.size()) break;
+
+        auto c = uint8_t(s[i]);
+        if (c < 0x80) {
+          write_escaped_codepoint(buf, c);
+          ++i;
+        } else if (auto len = utf8_sequence_length(s, i)) {
+          buf.append(s.data() + i, s.data() + i + len);
+          i += len;
+        } else {
+          if (!utf8_error_)
+            utf8_error_ = fmt::format(
+                "invalid UTF-8 byte at index {}: 0x{:02X}", i, c);
+          buf.push_back(s[i]);
+          ++i;
         }
       }
+      buf.push_back('"');
     }
 
-    TBox<double> add_vertices_polygon(std::map<arr3d, size_t>& vertex_map,
-                                      std::vector<arr3d>& vertex_vec,
-                                      std::set<arr3d>& vertex_set,
-                                      const LinearRing& polygon) {
-      TBox<double> bbox;
-      add_vertices_ring(vertex_map, vertex_vec, vertex_set, polygon, bbox);
-      for (auto& iring : polygon.interior_rings()) {
-        add_vertices_ring(vertex_map, vertex_vec, vertex_set, iring, bbox);
+    static bool is_json_attribute(
+        const AttributeMapRow::amrmap::value_type& a) {
+      // arr3f attributes have no json representation and are left out
+      return !std::holds_alternative<arr3f>(a.second);
+    }
+
+    void write_attribute_value(
+        Buffer& buf, const AttributeMapRow::amrmap::mapped_type& value) {
+      if (std::holds_alternative<std::monostate>(value)) {
+        write_raw(buf, "null");
+      } else if (auto val = std::get_if<bool>(&value)) {
+        write_raw(buf, *val ? "true" : "false");
+      } else if (auto val = std::get_if<float>(&value)) {
+        write_double(buf, *val);
+      } else if (auto val = std::get_if<int>(&value)) {
+        write_int(buf, *val);
+      } else if (auto val = std::get_if<std::string>(&value)) {
+        write_string(buf, *val);
+        // for date/time we follow https://en.wikipedia.org/wiki/ISO_8601
+      } else if (auto val = std::get_if<Date>(&value)) {
+        auto t = *val;
+        write_string(buf, t.format_to_ietf());
+      } else if (auto val = std::get_if<Time>(&value)) {
+        auto t = *val;
+        std::string time = std::to_string(t.hour) + ":" +
+                           std::to_string(t.minute) + ":" +
+                           std::to_string(t.second) + "Z";
+        write_string(buf, time);
+      } else if (auto val = std::get_if<DateTime>(&value)) {
+        auto t = *val;
+        write_string(buf, t.format_to_ietf());
       }
-      return bbox;
     }
 
-    TBox<double> add_vertices_mesh(std::map<arr3d, size_t>& vertex_map,
-                                   std::vector<arr3d>& vertex_vec,
-                                   std::set<arr3d>& vertex_set,
-                                   const Mesh& mesh) {
-      TBox<double> bbox;
-      for (auto& face : mesh.get_polygons()) {
-        bbox.add(
-            add_vertices_polygon(vertex_map, vertex_vec, vertex_set, face));
+    // Writes the attributes as a json object with sorted keys. If type is
+    // given it is added as the "type" member, replacing any attribute with
+    // that name.
+    void write_attributes(Buffer& buf, const AttributeMapRow& attributes,
+                          const char* type = nullptr) {
+      sorted_attributes_.clear();
+      for (const auto& attribute : attributes) {
+        if (!is_json_attribute(attribute)) continue;
+        if (type && attribute.first == "type") continue;
+        sorted_attributes_.push_back(&attribute);
       }
-      return bbox;
+      std::sort(sorted_attributes_.begin(), sorted_attributes_.end(),
+                [](auto a, auto b) { return a->first < b->first; });
+
+      buf.push_back('{');
+      bool first = true;
+      bool type_written = !type;
+      auto write_type = [&]() {
+        if (!first) buf.push_back(',');
+        write_raw(buf, "\"type\":");
+        write_string(buf, type);
+        type_written = true;
+        first = false;
+      };
+      for (auto attribute : sorted_attributes_) {
+        if (!type_written && attribute->first > "type") write_type();
+        if (!first) buf.push_back(',');
+        write_string(buf, attribute->first);
+        buf.push_back(':');
+        write_attribute_value(buf, attribute->second);
+        first = false;
+      }
+      if (!type_written) write_type();
+      buf.push_back('}');
     }
 
-    std::vector<std::vector<size_t>> LinearRing2jboundary(
-        std::map<arr3d, size_t>& vertex_map, const LinearRing& face) {
-      std::vector<std::vector<size_t>> jface;
-      std::vector<size_t> exterior_ring;
-      for (auto& vertex_ : face) {
-        auto vertex = pjHelper.coord_transform_rev(vertex_);
-        exterior_ring.push_back(vertex_map[vertex]);
+    size_t add_vertex(const arr3d& vertex) {
+      auto [it, did_insert] = vertex_map_.try_emplace(vertex, vertices_.size());
+      if (did_insert) {
+        vertices_.push_back({int((vertex[0] - translate_x_) / scale_x_),
+                             int((vertex[1] - translate_y_) / scale_y_),
+                             int((vertex[2] - translate_z_) / scale_z_)});
       }
-      jface.emplace_back(std::move(exterior_ring));
-      for (auto& iring : face.interior_rings()) {
-        std::vector<size_t> interior_ring;
-        for (auto& vertex_ : iring) {
-          auto vertex = pjHelper.coord_transform_rev(vertex_);
-          interior_ring.push_back(vertex_map[vertex]);
-        }
-        jface.emplace_back(std::move(interior_ring));
+      return it->second;
+    }
+
+    template <typename T>
+    void write_ring(Buffer& buf, const T& ring, TBox<double>& bbox) {
+      buf.push_back('[');
+      bool first = true;
+      for (auto& vertex_ : ring) {
+        auto vertex = pjHelper.coord_transform_rev(vertex_);
+        bbox.add(vertex);
+        if (!first) buf.push_back(',');
+        write_int(buf, add_vertex(vertex));
+        first = false;
       }
-      return jface;
+      buf.push_back(']');
     }
 
-    nlohmann::json::object_t mesh2jSolid(const Mesh& mesh, const char* lod,
-                                         std::map<arr3d, size_t>& vertex_map) {
-      auto geometry = nlohmann::json::object();
-      geometry["type"] = "Solid";
-      geometry["lod"] = lod;
-      std::vector<std::vector<std::vector<size_t>>> exterior_shell;
+    // writes the polygon as a list of rings and returns its bounding box
+    TBox<double> write_polygon(Buffer& buf, const LinearRing& polygon) {
+      TBox<double> bbox;
+      buf.push_back('[');
+      write_ring(buf, polygon, bbox);
+      for (auto& iring : polygon.interior_rings()) {
+        buf.push_back(',');
+        write_ring(buf, iring, bbox);
+      }
+      buf.push_back(']');
+      return bbox;
+    }
 
+    void write_solid(Buffer& buf, const Mesh& mesh, const char* lod,
+                     TBox<double>& building_bbox) {
+      TBox<double> bbox;
+      write_raw(buf, "{\"boundaries\":[[");
+      bool first = true;
       for (auto& face : mesh.get_polygons()) {
-        exterior_shell.emplace_back(LinearRing2jboundary(vertex_map, face));
+        if (!first) buf.push_back(',');
+        bbox.add(write_polygon(buf, face));
+        first = false;
       }
-      geometry["boundaries"] = {exterior_shell};
-
-      auto semantic_objects = nlohmann::json::array();
-      // 0
-      semantic_objects.push_back(
-          nlohmann::json::object({{"type", "GroundSurface"}}));
-      // 1
-      semantic_objects.push_back(nlohmann::json::object(
-          {{"type", "WallSurface"}, {"on_footprint_edge", true}}));
-      // 2
-      semantic_objects.push_back(nlohmann::json::object(
-          {{"type", "WallSurface"}, {"on_footprint_edge", false}}));
-
-      std::vector<int> sem_values;
-      size_t wallSurface_cntr = semantic_objects.size();
+      write_raw(buf, "]],\"lod\":");
+      write_string(buf, lod);
+      building_bbox = bbox;
+
+      write_raw(buf,
+                ",\"semantics\":{\"surfaces\":["
+                "{\"type\":\"GroundSurface\"},"
+                "{\"on_footprint_edge\":true,\"type\":\"WallSurface\"},"
+                "{\"on_footprint_edge\":false,\"type\":\"WallSurface\"}");
+      // the semantic values are written after the surfaces, keep them aside
+      auto& values = values_buffer_;
+      values.clear();
+      size_t wallSurface_cntr = 3;
       for (size_t i = 0; i < mesh.get_polygons().size(); ++i) {
+        if (i) values.push_back(',');
         auto& label = mesh.get_labels()[i];
         if (label == 0) {  // GroundSurface
-          sem_values.push_back(0);
+          values.push_back('0');
         } else if (label == 1) {  // RoofSurface
-          nlohmann::json::object_t semantic_object;
+          buf.push_back(',');
           if (mesh.get_attributes().size()) {
-            semantic_object = attributes2json(mesh.get_attributes().at(i));
+            write_attributes(buf, mesh.get_attributes().at(i), "RoofSurface");
+          } else {
+            write_raw(buf, "{\"type\":\"RoofSurface\"}");
           }
-          semantic_object["type"] = "RoofSurface";
-          semantic_objects.push_back(semantic_object);
-          sem_values.push_back(wallSurface_cntr++);
+          write_int(values, wallSurface_cntr++);
         } else if (label == 2) {  // WallSurface on footprint edge
-          sem_values.push_back(1);
+          values.push_back('1');
         } else if (label == 3) {  // WallSurface not on footprint edge
-          sem_values.push_back(2);
+          values.push_back('2');
         } else {
           throw rooferException("Unknown label in mesh");
         }
       }
-      geometry["semantics"] = {{"surfaces", semantic_objects},
-                               {"values", {sem_values}}};
-      return geometry;
+      write_raw(buf, "],\"values\":[[");
+      buf.append(values.data(), values.data() + values.size());
+      write_raw(buf, "]]},\"type\":\"Solid\"}");
+    }
+
+    // Writes a BuildingPart into parts_buffer_ and records it in parts_
+    void write_building_part(const std::string& b_id, int sid,
+                             const MeshMap* multisolid_lod12,
+                             const MeshMap* multisolid_lod13,
+                             const MeshMap* multisolid_lod22,
+                             TBox<double>& building_bbox) {
+      auto& buf = parts_buffer_;
+      auto begin = buf.size();
+      auto& geometry = geometry_buffer_;
+      geometry.clear();
+
+      // Use try-except here for some rare cases when the sid's between
+      // different lod's do not line up (eg for very fragmented buildings
+      // from poor dim pointcloud).
+      // a solid that fails after its mesh was found still leaves a null
+      // geometry member behind, as it did when this was built with nlohmann
+      bool has_geometry_member = false;
+      auto write_lod = [&](const MeshMap* meshmap, const char* lod) {
+        auto mark = geometry.size();
+        auto utf8_error = utf8_error_;
+        try {
+          auto& mesh = meshmap->at(sid);
+          has_geometry_member = true;
+          if (mark) geometry.push_back(',');
+          write_solid(geometry, mesh, lod, building_bbox);
+        } catch (const std::exception& e) {
+          geometry.resize(mark);
+          utf8_error_ = utf8_error;
+        }
+      };
+      if (multisolid_lod12) write_lod(multisolid_lod12, "1.2");
+      if (multisolid_lod13) write_lod(multisolid_lod13, "1.3");
+      if (multisolid_lod22) {
+        auto& mesh = multisolid_lod22->at(sid);
+        if (geometry.size()) geometry.push_back(',');
+        write_solid(geometry, mesh, "2.2", building_bbox);
+      }
+
+      buf.push_back('{');
+      if (geometry.size()) {
+        write_raw(buf, "\"geometry\":[");
+        buf.append(geometry.data(), geometry.data() + geometry.size());
+        write_raw(buf, "],");
+      } else if (has_geometry_member) {
+        write_raw(buf, "\"geometry\":null,");
+      }
+      write_raw(buf, "\"parents\":[");
+      write_string(buf, b_id);
+      write_raw(buf, "],\"type\":\"BuildingPart\"}");
+
+      parts_.push_back({b_id + "-" + std::to_string(sid), begin, buf.size()});
+    }
+
+    std::string building_id(const AttributeMapRow& attributes,
+                            std::string b_id) {
+      if (!attributes.has_name(identifier_attribute)) return b_id;
+      if (auto val = attributes.get_if<float>(identifier_attribute)) {
+        b_id = std::to_string(*val);
+      } else if (auto val = attributes.get_if<int>(identifier_attribute)) {
+        b_id = std::to_string(*val);
+      } else if (auto val =
+                     attributes.get_if<std::string>(identifier_attribute)) {
+        b_id = *val;
+      }
+      return b_id;
+    }
+
+    // Serialises one CityJSONFeature into buffer_, including the trailing
+    // newline.
+    void encode_to_buffer(const LinearRing& footprint,
+                          const MeshMap* multisolid_lod12,
+                          const MeshMap* multisolid_lod13,
+                          const MeshMap* multisolid_lod22,
+                          const AttributeMapRow& attributes,
+                          std::string feature_id) {
+      buffer_.clear();
+      parts_buffer_.clear();
+      parts_.clear();
+      vertex_map_.clear();
+      vertices_.clear();
+      utf8_error_.reset();
+
+      auto b_id = building_id(attributes, std::move(feature_id));
+
+      // footprint geometry, this goes first to get the same vertex order as
+      // before
+      write_polygon(parts_buffer_, footprint);
+      auto fp_end = parts_buffer_.size();
+
+      // we expect at least one of the geomtry inputs is set
+      bool has_solids = false;
+      if (multisolid_lod12) has_solids = multisolid_lod12->size();
+      if (multisolid_lod13) has_solids = multisolid_lod13->size();
+      if (multisolid_lod22) has_solids = multisolid_lod22->size();
+
+      TBox<double> building_bbox;
+      if (has_solids) {
+        const MeshMap* meshmap;
+        if (multisolid_lod22) {
+          meshmap = multisolid_lod22;
+        } else if (multisolid_lod13) {
+          meshmap = multisolid_lod13;
+        } else {
+          meshmap = multisolid_lod12;
+        }
+        for (const auto& [sid, solid_lodx] : *meshmap) {
+          write_building_part(b_id, sid, multisolid_lod12, multisolid_lod13,
+                              multisolid_lod22, building_bbox);
+        }
+      }
+
+      auto& buf = buffer_;
+      write_raw(buf, "{\"CityObjects\":{");
+
+      // the Building
+      write_string(buf, b_id);
+      write_raw(buf, ":{\"attributes\":");
+      write_attributes(buf, attributes);
+      // children are listed in the order they were written
+      write_raw(buf, ",\"children\":[");
+      for (size_t i = 0; i < parts_.size(); ++i) {
+        if (i) buf.push_back(',');
+        write_string(buf, parts_[i].id);
+      }
+      write_raw(buf, "],\"geographicalExtent\":[");
+      auto minp = building_bbox.min();
+      auto maxp = building_bbox.max();
+      for (size_t i = 0; i < 6; ++i) {
+        if (i) buf.push_back(',');
+        write_double(buf, i < 3 ? minp[i] : maxp[i - 3]);
+      }
+      write_raw(buf, "],\"geometry\":[{\"boundaries\":[");
+      buf.append(parts_buffer_.data(), parts_buffer_.data() + fp_end);
+      write_raw(buf,
+                "],\"lod\":\"0\",\"type\":\"MultiSurface\"}],"
+                "\"type\":\"Building\"}");
+
+      // the BuildingParts, CityObjects are sorted by id
+      std::sort(parts_.begin(), parts_.end(),
+                [](auto& a, auto& b) { return a.id < b.id; });
+      for (auto& part : parts_) {
+        buf.push_back(',');
+        write_string(buf, part.id);
+        buf.push_back(':');
+        buf.append(parts_buffer_.data() + part.begin,
+                   parts_buffer_.data() + part.end);
+      }
+
+      write_raw(buf, "},\"id\":");
+      write_string(buf, b_id);
+      write_raw(buf, ",\"type\":\"CityJSONFeature\",\"vertices\":[");
+      for (size_t i = 0; i < vertices_.size(); ++i) {
+        if (i) buf.push_back(',');
+        buf.push_back('[');
+        write_int(buf, vertices_[i][0]);
+        buf.push_back(',');
+        write_int(buf, vertices_[i][1]);
+        buf.push_back(',');
+        write_int(buf, vertices_[i][2]);
+        buf.push_back(']');
+      }
+      write_raw(buf, "]}\n");
+
+      if (utf8_error_) throw rooferException(*utf8_error_);
     }
 
     void write_to_stream(const nlohmann::json& outputJSON,
@@ -169,181 +523,6 @@ namespace roofer::io {
       return {minp[0], minp[1], minp[2], maxp[0], maxp[1], maxp[2]};
     }
 
-    nlohmann::json::object_t attributes2json(
-        const AttributeMapRow& attributes) {
-      nlohmann::json::object_t jattributes;
-      nlohmann::json j_null;
-      for (const auto& [name, val] : attributes) {
-        if (attributes.is_null(name)) {
-          jattributes[name] = j_null;
-        } else if (auto val = attributes.get_if<bool>(name)) {
-          jattributes[name] = *val;
-        } else if (auto val = attributes.get_if<float>(name)) {
-          jattributes[name] = *val;
-        } else if (auto val = attributes.get_if<int>(name)) {
-          jattributes[name] = *val;
-        } else if (auto val = attributes.get_if<std::string>(name)) {
-          jattributes[name] = *val;
-          // for date/time we follow https://en.wikipedia.org/wiki/ISO_8601
-        } else if (auto val = attributes.get_if<Date>(name)) {
-          auto t = *val;
-          std::string date = t.format_to_ietf();
-          jattributes[name] = date;
-        } else if (auto val = attributes.get_if<Time>(name)) {
-          auto t = *val;
-          std::string time = std::to_string(t.hour) + ":" +
-                             std::to_string(t.minute) + ":" +
-                             std::to_string(t.second) + "Z";
-          jattributes[name] = time;
-        } else if (auto val = attributes.get_if<DateTime>(name)) {
-          auto t = *val;
-          std::string datetime = t.format_to_ietf();
-          jattributes[name] = datetime;
-        }
-      }
-      return jattributes;
-    }
-
-    using MeshMap = std::unordered_map<int, Mesh>;
-    void write_cityobject(
-        const LinearRing& footprint, const MeshMap* multisolid_lod12,
-        const MeshMap* multisolid_lod13, const MeshMap* multisolid_lod22,
-        const AttributeMapRow& attributes, nlohmann::json& outputJSON,
-        std::vector<arr3d>& vertex_vec, std::string& identifier_attribute,
-        std::string building_id) {
-      std::map<arr3d, size_t> vertex_map;
-      std::set<arr3d> vertex_set;
-      size_t bp_counter = 0;
-
-      // we expect at least one of the geomtry inputs is set
-      bool export_lod12 = multisolid_lod12;
-      bool export_lod13 = multisolid_lod13;
-      bool export_lod22 = multisolid_lod22;
-
-      {
-        auto building = nlohmann::json::object();
-        auto b_id = building_id;
-        building["type"] = "Building";
-
-        // Building atributes
-        // bool id_from_attr = false;
-        building["attributes"] = attributes2json(attributes);
-        for (const auto& [name, val] : attributes) {
-          if (name == identifier_attribute) {
-            if (auto val = attributes.get_if<float>(name)) {
-              b_id = std::to_string(*val);
-            } else if (auto val = attributes.get_if<int>(name)) {
-              b_id = std::to_string(*val);
-            } else if (auto val = attributes.get_if<std::string>(name)) {
-              b_id = *val;
-            }
-          }
-        }
-
-        // footprint geometry
-        auto fp_geometry = nlohmann::json::object();
-        fp_geometry["lod"] = "0";
-        fp_geometry["type"] = "MultiSurface";
-
-        add_vertices_polygon(vertex_map, vertex_vec, vertex_set, footprint);
-        fp_geometry["boundaries"] = {
-            LinearRing2jboundary(vertex_map, footprint)};
-        building["geometry"].push_back(fp_geometry);
-
-        std::vector<std::string> buildingPartIds;
-
-        bool has_solids = false;
-        if (export_lod12) has_solids = multisolid_lod12->size();
-        if (export_lod13) has_solids = multisolid_lod13->size();
-        if (export_lod22) has_solids = multisolid_lod22->size();
-
-        TBox<double> building_bbox;
-        if (has_solids) {
-          const MeshMap* meshmap;
-          if (export_lod22) {
-            meshmap = multisolid_lod22;
-          } else if (export_lod13) {
-            meshmap = multisolid_lod13;
-          } else if (export_lod12) {
-            meshmap = multisolid_lod12;
-          }
-          for (const auto& [sid, solid_lodx] : *meshmap) {
-            auto buildingPart = nlohmann::json::object();
-            auto bp_id = b_id + "-" + std::to_string(sid);
-
-            buildingPartIds.push_back(bp_id);
-            buildingPart["type"] = "BuildingPart";
-            buildingPart["parents"] = {b_id};
-
-            // Use try-except here for some rare cases when the sid's between
-            // different lod's do not line up (eg for very fragmented buildings
-            // from poor dim pointcloud).
-            if (export_lod12) {
-              try {
-                building_bbox =
-                    add_vertices_mesh(vertex_map, vertex_vec, vertex_set,
-                                      multisolid_lod12->at(sid));
-                buildingPart["geometry"].push_back(
-                    mesh2jSolid(multisolid_lod12->at(sid), "1.2", vertex_map));
-              } catch (const std::exception& e) {
-                // std::cout << "skipping lod 12 building part\n";
-              }
-            }
-            if (export_lod13) {
-              try {
-                building_bbox =
-                    add_vertices_mesh(vertex_map, vertex_vec, vertex_set,
-                                      multisolid_lod13->at(sid));
-                buildingPart["geometry"].push_back(
-                    mesh2jSolid(multisolid_lod13->at(sid), "1.3", vertex_map));
-              } catch (const std::exception& e) {
-                // std::cout << "skipping lod 13 building part\n";
-              }
-            }
-            if (export_lod22) {
-              building_bbox =
-                  add_vertices_mesh(vertex_map, vertex_vec, vertex_set,
-                                    multisolid_lod22->at(sid));
-              buildingPart["geometry"].push_back(
-                  mesh2jSolid(multisolid_lod22->at(sid), "2.2", vertex_map));
-            }
-
-            // attributes
-            //  auto jattributes = nlohmann::json::object();
-            //  for (auto& term : part_attributes.sub_terminals()) {
-            //    auto tname = term->get_full_name();
-            //    if (!term->get_data_vec()[i].has_value()) {
-            //      nlohmann::json j_null;
-            //      jattributes[tname] = j_null;
-            //      continue;
-            //    }
-
-            //   if (term->accepts_type(typeid(bool))) {
-            //     jattributes[tname] = term->get<const bool&>(bp_counter);
-            //   } else if (term->accepts_type(typeid(float))) {
-            //     jattributes[tname] = term->get<const float&>(bp_counter);
-            //   } else if (term->accepts_type(typeid(int))) {
-            //     jattributes[tname] = term->get<const int&>(bp_counter);
-            //   } else if (term->accepts_type(typeid(std::string))) {
-            //     jattributes[tname] = term->get<const
-            //     std::string&>(bp_counter);
-            //   }
-            // }
-            // ++bp_counter;
-            // buildingPart["attributes"] = jattributes;
-
-            outputJSON["CityObjects"][bp_id] = buildingPart;
-          }
-        }
-
-        building["children"] = buildingPartIds;
-        building["geographicalExtent"] =
-            compute_geographical_extent(building_bbox);
-
-        outputJSON["CityObjects"][b_id] = building;
-      }
-    }
-
    public:
     using CityJsonWriterInterface::CityJsonWriterInterface;
 
@@ -421,36 +600,27 @@ namespace roofer::io {
                        const MeshMap* multisolid_lod13,
                        const MeshMap* multisolid_lod22,
                        const AttributeMapRow attributes) override {
-      nlohmann::json outputJSON;
-
-      outputJSON["type"] = "CityJSONFeature";
-      outputJSON["CityObjects"] = nlohmann::json::object();
-
-      std::vector<arr3d> vertex_vec;
-      write_cityobject(footprint, multisolid_lod12, multisolid_lod13,
-                       multisolid_lod22, attributes, outputJSON, vertex_vec,
-                       identifier_attribute,
+      encode_to_buffer(footprint, multisolid_lod12, multisolid_lod13,
+                       multisolid_lod22, attributes,
                        std::to_string(++written_features_count));
-
-      // The main Building is the parent object.
-      // Bit of a hack. Ideally we would know exactly which ID we set,
-      // instead of just iterating. But it is assumed that in case of writing to
-      // CityJSONFeature there is only one parent CityObject.
-      for (auto& el : outputJSON["CityObjects"].items()) {
-        if (!el.value().contains(std::string("parents"))) {
-          outputJSON["id"] = el.key();
-        }
-      };
-
-      std::vector<std::array<int, 3>> vertices_int;
-      for (auto& vertex : vertex_vec) {
-        vertices_int.push_back({int((vertex[0] - translate_x_) / scale_x_),
-                                int((vertex[1] - translate_y_) / scale_y_),
-                                int((vertex[2] - translate_z_) / scale_z_)});
+      if (prettyPrint_) {
+        // not used for CityJSONSeq output, so simply reformat with nlohmann
+        write_to_stream(nlohmann::json::parse(buffer_.begin(), buffer_.end()),
+                        output_stream, prettyPrint_);
+      } else {
+        output_stream.write(buffer_.data(), buffer_.size());
       }
-      outputJSON["vertices"] = vertices_int;
+    }
 
-      write_to_stream(outputJSON, output_stream, prettyPrint_);
+    void encode_feature(std::string& output, const LinearRing& footprint,
+                        const MeshMap* multisolid_lod12,
+                        const MeshMap* multisolid_lod13,
+                        const MeshMap* multisolid_lod22,
+                        const AttributeMapRow& attributes,
+                        size_t feature_id) override {
+      encode_to_buffer(footprint, multisolid_lod12, multisolid_lod13,
+                       multisolid_lod22, attributes, std::to_string(feature_id));
+      output.assign(buffer_.data(), buffer_.size());
     }
   };
 
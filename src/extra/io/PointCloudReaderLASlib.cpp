@@ -22,11 +22,19 @@
 #include <roofer/logger/logger.h>
 
 #include <array>
+#include <cstring>
 #include <iomanip>
 #include <lasreader.hpp>
 #include <laswriter.hpp>
 #include <roofer/io/PointCloudReader.hpp>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace roofer::io {
 
   struct PointCloudReaderLASlib : public PointCloudReaderInterface {
@@ -82,13 +90,50 @@ namespace roofer::io {
       // logger.debug("LAS Wkt: {}", wkt);
     }
 
-    LASreader* lasreader;
+    LASreader* lasreader = nullptr;
+    std::string source_;
+
+    // memory map of an uncompressed LAS file, created on the first slice read
+    const unsigned char* map_ = nullptr;
+    size_t map_size_ = 0;
+
+    bool map_file() {
+#if defined(_WIN32)
+      return false;
+#else
+      if (map_) return true;
+      // compressed points can not be addressed directly
+      if (lasreader->header.laszip) return false;
+      int fd = ::open(source_.c_str(), O_RDONLY);
+      if (fd < 0) return false;
+      struct stat st;
+      if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+      }
+      void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (map == MAP_FAILED) return false;
+      map_ = static_cast<const unsigned char*>(map);
+      map_size_ = st.st_size;
+      return true;
+#endif
+    }
+
+    void unmap_file() {
+#if !defined(_WIN32)
+      if (map_) ::munmap(const_cast<unsigned char*>(map_), map_size_);
+#endif
+      map_ = nullptr;
+      map_size_ = 0;
+    }
 
    public:
     using PointCloudReaderInterface::PointCloudReaderInterface;
 
     void open(const std::string& source) override {
-      if (!lasreader) close();
+      if (lasreader) close();
+      source_ = source;
       LASreadOpener lasreadopener;
       lasreadopener.set_file_name(source.c_str());
       lasreader = lasreadopener.open();
@@ -104,6 +149,7 @@ namespace roofer::io {
     }
 
     void close() override {
+      unmap_file();
       if (lasreader) {
         lasreader->close();
         delete lasreader;
@@ -117,6 +163,8 @@ namespace roofer::io {
               lasreader->get_max_y(), lasreader->get_max_z()};
     }
 
+    size_t getPointCount() override { return size_t(lasreader->npoints); }
+
     virtual void readPointCloud(PointCollection& points, vec1i* classification,
                                 vec1i* order, vec1f* intensities,
                                 vec3f* colors) override {
@@ -159,6 +207,54 @@ namespace roofer::io {
             lasreader->point.get_z()));
       }
     }
+
+    void readPointCloudSlice(size_t first, size_t count,
+                             PointCollection& points,
+                             vec1i* classification) override {
+      const auto& header = lasreader->header;
+      if (first + count > size_t(lasreader->npoints)) {
+        throw(rooferException("Point slice out of range in " + source_));
+      }
+
+      if (map_file()) {
+        const size_t record_length = header.point_data_record_length;
+        const size_t begin =
+            header.offset_to_point_data + first * record_length;
+        if (begin + count * record_length > map_size_) {
+          throw(rooferException("Point slice out of range in " + source_));
+        }
+        // the classification moved to its own byte in point format 6 and up
+        const bool extended = header.point_data_format >= 6;
+        points.reserve(points.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+          const unsigned char* record = map_ + begin + i * record_length;
+          std::array<int32_t, 3> xyz;
+          std::memcpy(xyz.data(), record, sizeof(xyz));
+          if (classification) {
+            classification->push_back(extended ? record[16]
+                                               : (record[15] & 0x1F));
+          }
+          points.push_back(pjHelper.coord_transform_fwd(
+              header.x_offset + header.x_scale_factor * xyz[0],
+              header.y_offset + header.y_scale_factor * xyz[1],
+              header.z_offset + header.z_scale_factor * xyz[2]));
+        }
+        return;
+      }
+
+      // compressed, or no mmap on this platform
+      if (!lasreader->seek(first)) {
+        throw(rooferException("Seek failed on " + source_));
+      }
+      for (size_t i = 0; i < count && lasreader->read_point(); ++i) {
+        if (classification) {
+          classification->push_back(lasreader->point.get_classification());
+        }
+        points.push_back(pjHelper.coord_transform_fwd(
+            lasreader->point.get_x(), lasreader->point.get_y(),
+            lasreader->point.get_z()));
+      }
+    }
   };
 
   std::unique_ptr<PointCloudReaderInterface> createPointCloudReaderLASlib(
@@ -80,6 +80,8 @@ namespace roofer::io {
           point_cloud.attributes.get_if<int>("classification");
       auto intensity = point_cloud.attributes.get_if<float>("intensity");
       auto colors = point_cloud.attributes.get_if<arr3f>("colors");
+      auto point_source_id =
+          point_cloud.attributes.get_if<int>("point_source_id");
 
       // todo throw warnings
       if (classification) {
@@ -97,6 +99,11 @@ namespace roofer::io {
           colors = nullptr;
         }
       }
+      if (point_source_id) {
+        if (point_source_id->size() != point_cloud.size()) {
+          point_source_id = nullptr;
+        }
+      }
 
       size_t i = 0;
       for (auto& p_ : point_cloud) {
@@ -110,6 +117,9 @@ namespace roofer::io {
         if (intensity) {
           laspoint.set_intensity((*intensity)[i].value());
         }
+        if (point_source_id) {
+          laspoint.set_point_source_ID((*point_source_id)[i].value());
+        }
         if (colors) {
           laspoint.set_R((*colors)[i].value()[0] * 65535);
           laspoint.set_G((*colors)[i].value()[1] * 65535);
@@ -21,10 +21,15 @@
 
 #include <roofer/logger/logger.h>
 
+#include <algorithm>
 #include <bitset>
+#include <condition_variable>
 #include <ctime>
 #include <filesystem>
+#include <future>
 #include <lasreader.hpp>
+#include <mutex>
+#include <thread>
 #include <roofer/common/Raster.hpp>
 #include <roofer/common/GridPIPTester.hpp>
 #include <roofer/io/StreamCropper.hpp>
@@ -40,15 +45,29 @@ namespace roofer::io {
     vec1i& acquisition_years;
     vec1b& pointcloud_insufficient;
 
-    // ground elevations
-    std::vector<std::vector<arr3f>> ground_buffer_points;
+    // classification column of each point cloud
+    std::vector<veco1i*> classifications;
+
     RasterTools::Raster pindex;
     std::vector<std::vector<size_t>> pindex_vals;
     std::vector<std::unique_ptr<GridPIPTester>> poly_grids, buf_poly_grids;
-    std::vector<vec1f> z_ground;
-    std::unordered_map<std::unique_ptr<arr3f>, std::vector<size_t>>
-        points_overlap;  // point, [poly id's], these are points that intersect
-                         // with multiple polygons
+
+    // ground points in the buffered polygons, for the ground elevations, and
+    // those in the buffer around the polygons, with the polygon of each point
+    std::vector<size_t> z_ground_polys;
+    vec1f z_ground;
+    std::vector<size_t> ground_buffer_polys;
+    std::vector<arr3f> ground_buffer_points;
+
+    // building points that intersect with multiple polygons. The polygons of
+    // a point are in overlap_polys from its polys_begin up to the polys_begin
+    // of the next point.
+    struct OverlapPoint {
+      arr3f point;
+      size_t polys_begin;
+    };
+    std::vector<OverlapPoint> points_overlap;
+    std::vector<size_t> overlap_polys;
 
     int ground_class, building_class;
     bool handle_overlap_points;
@@ -77,12 +96,11 @@ namespace roofer::io {
           handle_overlap_points(handle_overlap_points) {
       // point_clouds_ground.resize(polygons.size());
       point_clouds.resize(polygons.size());
-      z_ground.resize(polygons.size());
-      ground_buffer_points.resize(polygons.size());
       acquisition_years.resize(polygons.size(), 0);
 
       for (size_t i = 0; i < point_clouds.size(); ++i) {
-        point_clouds.at(i).attributes.insert_vec<int>("classification");
+        classifications.push_back(
+            &point_clouds.at(i).attributes.insert_vec<int>("classification"));
       }
 
       // make a vector of BOX2D for the set of input polygons
@@ -125,6 +143,20 @@ namespace roofer::io {
       }
     }
 
+    /**
+     * @brief Reserves room in the building point clouds for the points of a
+     * pointcloud with the given density (points per unit area)
+     */
+    void reserve(float point_density) {
+      for (size_t i = 0; i < polygons.size(); ++i) {
+        auto n = size_t(std::abs(polygons[i].signed_area()) * point_density);
+        if (n > point_clouds[i].capacity()) {
+          point_clouds[i].reserve(n);
+          classifications[i]->reserve(n);
+        }
+      }
+    }
+
     /**
      * @brief Find polygon that intersects point and add the point to the
      * corresponding building point cloud
@@ -151,47 +183,44 @@ namespace roofer::io {
       //    Thus a single ground height value per grid cell is good enough for
       //    representing the ground/floor elevation of the buildings in that
       //    grid cell.
-      std::vector<size_t> poly_intersect;
+      // the building polygons that intersect the point are collected at the
+      // end of overlap_polys
+      const size_t polys_begin = overlap_polys.size();
       for (size_t& poly_i : pindex_vals[lincoord]) {
         if (buf_poly_grids[poly_i]->test(point)) {
-          auto& point_cloud = point_clouds.at(poly_i);
-          auto classification =
-              point_cloud.attributes.get_if<int>("classification");
-
           if (point_class == ground_class) {
             min_ground_elevation = std::min(min_ground_elevation, point[2]);
-            z_ground[poly_i].push_back(point[2]);
+            z_ground_polys.push_back(poly_i);
+            z_ground.push_back(point[2]);
           }
 
           if (poly_grids[poly_i]->test(point)) {
             if (point_class == ground_class) {
-              point_cloud.push_back(point);
-              (*classification).push_back(2);
+              point_clouds[poly_i].push_back(point);
+              classifications[poly_i]->push_back(2);
             } else if (point_class == building_class) {
-              poly_intersect.push_back(poly_i);
+              overlap_polys.push_back(poly_i);
             }
             acquisition_years[poly_i] =
                 std::max(acqusition_year, acquisition_years[poly_i]);
           } else if (point_class == ground_class) {
-            ground_buffer_points[poly_i].push_back(point);
+            ground_buffer_polys.push_back(poly_i);
+            ground_buffer_points.push_back(point);
           }
         }
       }
 
-      if (point_class == building_class) {
-        if (poly_intersect.size() > 1 && handle_overlap_points) {
-          // decide later to which polygon to assign this point to
-          points_overlap[std::make_unique<arr3f>(point)] = poly_intersect;
-        } else {
-          // assign point to all intersecting polygons
-          for (auto& poly_i : poly_intersect) {
-            auto& point_cloud = point_clouds.at(poly_i);
-            auto classification =
-                point_cloud.attributes.get_if<int>("classification");
-            point_cloud.push_back(point);
-            (*classification).push_back(6);
-          }
+      const size_t n_polys = overlap_polys.size() - polys_begin;
+      if (n_polys > 1 && handle_overlap_points) {
+        // decide later to which polygon to assign this point to
+        points_overlap.push_back({point, polys_begin});
+      } else {
+        // assign point to all intersecting polygons
+        for (size_t j = polys_begin; j < overlap_polys.size(); ++j) {
+          point_clouds[overlap_polys[j]].push_back(point);
+          classifications[overlap_polys[j]]->push_back(6);
         }
+        overlap_polys.resize(polys_begin);
       }
     }
 
@@ -210,13 +239,15 @@ namespace roofer::io {
                          vec1i& poly_pt_counts_grd, vec1f& poly_densities) {
       // compute poly properties
       struct PolyInfo {
-        size_t pt_count_bld;
-        size_t pt_count_grd;
-        size_t pt_count_bld_overlap{0};
-        float avg_elevation;
-        float area;
+        size_t pt_count_bld = 0;
+        size_t pt_count_grd = 0;
+        size_t pt_count_bld_overlap = 0;
+        // lowest possible for polygons without building points, so that these
+        // lose when resolving overlap points
+        float avg_elevation = std::numeric_limits<float>::lowest();
+        float area = 0;
       };
-      std::unordered_map<size_t, PolyInfo> poly_info;
+      std::vector<PolyInfo> poly_info(polygons.size());
 
       auto& logger = logger::Logger::get_logger();
 
@@ -226,118 +257,125 @@ namespace roofer::io {
       // - count of building points
       // - average elevation of building points
       for (size_t poly_i = 0; poly_i < polygons.size(); poly_i++) {
-        auto& polygon = polygons.at(poly_i);
-        auto& point_cloud = point_clouds.at(poly_i);
-        auto classification =
-            point_cloud.attributes.get_if<int>("classification");
-        PolyInfo info;
-
-        info.area = polygon.signed_area();
-        size_t pt_cnt_bld = 0;
-        size_t pt_cnt_grd = 0;
+        auto& point_cloud = point_clouds[poly_i];
+        auto& classification = *classifications[poly_i];
+        auto& info = poly_info[poly_i];
+
+        info.area = polygons[poly_i].signed_area();
         float z_sum = 0;
         for (size_t pi = 0; pi < point_cloud.size(); ++pi) {
-          if ((*classification)[pi] == 6) {
-            ++pt_cnt_bld;
+          if (classification[pi] == 6) {
+            ++info.pt_count_bld;
             z_sum += point_cloud[pi][2];
-          } else if ((*classification)[pi] == 2) {
-            ++pt_cnt_grd;
+          } else if (classification[pi] == 2) {
+            ++info.pt_count_grd;
           }
         }
-        info.pt_count_bld = pt_cnt_bld;
-        info.pt_count_grd = pt_cnt_grd;
         if (info.pt_count_bld > 0) {
-          info.avg_elevation = z_sum / pt_cnt_bld;
+          info.avg_elevation = z_sum / info.pt_count_bld;
         }
-        poly_info.insert({poly_i, info});
       }
 
       // merge buffer ground points into regular point_clouds now that the
       // proper counts have been established
-      for (size_t poly_i; poly_i < polygons.size(); poly_i++) {
-        auto& point_cloud = point_clouds.at(poly_i);
-        auto classification =
-            point_cloud.attributes.get_if<int>("classification");
-        for (auto& p : ground_buffer_points[poly_i]) {
-          point_cloud.push_back(p);
-          (*classification).push_back(2);
-        }
+      for (size_t i = 0; i < ground_buffer_points.size(); ++i) {
+        point_clouds[ground_buffer_polys[i]].push_back(ground_buffer_points[i]);
+        classifications[ground_buffer_polys[i]]->push_back(2);
       }
-      ground_buffer_points.clear();
+      ground_buffer_polys = {};
+      ground_buffer_points = {};
 
       // assign points_overlap
       if (handle_overlap_points) {
-        for (auto& [p, polylist] : points_overlap) {
-          for (auto& poly_i : polylist) {
-            poly_info[poly_i].pt_count_bld_overlap++;
+        for (auto& poly_i : overlap_polys) {
+          poly_info[poly_i].pt_count_bld_overlap++;
+        }
+        // the maximum possible point density of each polygon (proxy for point
+        // coverage), updated as points are assigned
+        vec1f max_density(polygons.size());
+        for (size_t poly_i = 0; poly_i < polygons.size(); ++poly_i) {
+          auto& info = poly_info[poly_i];
+          max_density[poly_i] =
+              (info.pt_count_bld + info.pt_count_bld_overlap) / info.area;
+        }
+        // true if polygon d2 is more suitable than d1: the one with the
+        // higher density, or with the higher elevation if the densities differ
+        // less than max_density_delta
+        auto less_suitable = [&](size_t d1, size_t d2) {
+          float pd1 = max_density[d1];
+          float pd2 = max_density[d2];
+          if (std::abs(1 - pd1 / pd2) < max_density_delta) {
+            return poly_info[d1].avg_elevation < poly_info[d2].avg_elevation;
+          } else {
+            return pd1 < pd2;
           }
+        };
+        for (size_t j = 0; j < points_overlap.size(); ++j) {
+          const size_t polys_end = j + 1 < points_overlap.size()
+                                       ? points_overlap[j + 1].polys_begin
+                                       : overlap_polys.size();
+          // find best polygon to assign this point to, of equally suitable
+          // polygons the last one
+          size_t best_poly = overlap_polys[points_overlap[j].polys_begin];
+          for (size_t k = points_overlap[j].polys_begin + 1; k < polys_end;
+               ++k) {
+            if (!less_suitable(overlap_polys[k], best_poly)) {
+              best_poly = overlap_polys[k];
+            }
+          }
+          point_clouds[best_poly].push_back(points_overlap[j].point);
+          classifications[best_poly]->push_back(6);
+          auto& info = poly_info[best_poly];
+          info.pt_count_bld++;
+          max_density[best_poly] =
+              (info.pt_count_bld + info.pt_count_bld_overlap) / info.area;
         }
-        for (auto& [p, polylist] : points_overlap) {
-          // find best polygon to assign this point to
-          std::sort(polylist.begin(), polylist.end(),
-                    [&max_density_delta, &poly_info, this](auto& d1, auto& d2) {
-                      // we look at the maximim possible point density (proxy
-                      // for point coverage) and the average elevation compute
-                      // poitncloud density for both polygons
-                      float pd1 = (poly_info[d1].pt_count_bld +
-                                   poly_info[d1].pt_count_bld_overlap) /
-                                  poly_info[d1].area;
-                      float pd2 = (poly_info[d2].pt_count_bld +
-                                   poly_info[d2].pt_count_bld_overlap) /
-                                  poly_info[d2].area;
-
-                      // check if the difference in point densities is less than
-                      // 5%
-                      if (std::abs(1 - pd1 / pd2) < max_density_delta) {
-                        // if true, then look at the polygon with the highest
-                        // elevation point cloud
-                        return poly_info[d1].avg_elevation <
-                               poly_info[d2].avg_elevation;
-                      } else {
-                        // otherwise decide based on the density values
-                        return pd1 < pd2;
-                      }
-                    });
-
-          // now the most suitable polygon (footprint) is the last in the list.
-          // We will assign this point to that footprint.
-          auto& point_cloud = point_clouds.at(polylist.back());
-          auto classification =
-              point_cloud.attributes.get_if<int>("classification");
-          point_cloud.push_back(*p);
-          (*classification).push_back(6);
-          poly_info[polylist.back()].pt_count_bld++;
+      }
+      points_overlap = {};
+      overlap_polys = {};
+
+      // group the ground elevations by polygon
+      std::vector<size_t> z_ground_begin(polygons.size() + 1, 0);
+      for (auto poly_i : z_ground_polys) ++z_ground_begin[poly_i + 1];
+      for (size_t i = 0; i < polygons.size(); ++i) {
+        z_ground_begin[i + 1] += z_ground_begin[i];
+      }
+      vec1f z_ground_grouped(z_ground.size());
+      {
+        auto next = z_ground_begin;
+        for (size_t j = 0; j < z_ground.size(); ++j) {
+          z_ground_grouped[next[z_ground_polys[j]]++] = z_ground[j];
         }
       }
+      z_ground_polys = {};
+      z_ground = {};
 
       // Compute ground elevation per polygon (eg 5th percentile of all ground
-      // pts) std::cout <<"Computing the average ground elevation per
-      // polygon..." << std::endl;
-      for (size_t i = 0; i < z_ground.size(); ++i) {
+      // pts)
+      for (size_t i = 0; i < polygons.size(); ++i) {
         float ground_ele = min_ground_elevation;
-        if (z_ground[i].size() != 0) {
-          std::sort(z_ground[i].begin(), z_ground[i].end(),
-                    [](auto& z1, auto& z2) { return z1 < z2; });
-          int elevation_id =
-              std::floor(ground_percentile * float(z_ground[i].size() - 1));
-          ground_ele = z_ground[i][elevation_id];
-        } else {
-          // spdlog::info("no ground pts found for polygon");
+        auto z_begin = z_ground_grouped.begin() + z_ground_begin[i];
+        auto z_end = z_ground_grouped.begin() + z_ground_begin[i + 1];
+        if (z_begin != z_end) {
+          auto elevation_it =
+              z_begin +
+              int(std::floor(ground_percentile * float(z_end - z_begin - 1)));
+          std::nth_element(z_begin, elevation_it, z_end);
+          ground_ele = *elevation_it;
         }
-        // Assign the median ground elevation to each polygon
         ground_elevations.push_back(ground_ele);
       }
 
       // clear footprints with very low coverage (ie. underground footprints)
       // TODO: improve method for computing mean_density
       float total_cnt = 0, total_area = 0;
-      for (auto& [poly_i, info] : poly_info) {
+      for (auto& info : poly_info) {
         total_cnt += info.pt_count_bld + info.pt_count_grd;
         total_area += info.area;
       }
       float mean_density = total_cnt / total_area;
       float diff_sum = 0;
-      for (auto& [poly_i, info] : poly_info) {
+      for (auto& info : poly_info) {
         diff_sum += std::pow(mean_density - (info.pt_count_bld / info.area), 2);
       }
       float std_dev_density = std::sqrt(diff_sum / poly_info.size());
@@ -359,11 +397,9 @@ namespace roofer::io {
     }
   };
 
-  // Get the year-part from the GPS time of the point.
+  // Get the year-part from the GPS time of a point.
   // Assumes that the GPS time is Adjusted Standard GPS Time.
-  int getAcquisitionYearOfPoint(LASpoint* laspoint) {
-    // Adjusted Standard GPS Time
-    const auto adjusted_gps_time = (double)laspoint->get_gps_time();
+  int getAcquisitionYearOfPoint(double adjusted_gps_time) {
     // GPS epoch - UNIX epoch + 10^9
     // -10^9 is the adjustment in the gps time to lower the value
     auto gps_time_unix_epoch = (std::time_t)(adjusted_gps_time + 1315964800.0);
@@ -372,6 +408,49 @@ namespace roofer::io {
     return lt->tm_year + 1900;
   }
 
+  /**
+   * @brief Acquisition years of GPS times without a gmtime call per point
+   *
+   * Holds the Adjusted Standard GPS Times at which the years start, and
+   * gives the same year as getAcquisitionYearOfPoint. Consecutive points
+   * are usually acquired in the same year, so the year of the previous point
+   * is tested first.
+   */
+  class AcquisitionYearLookup {
+    static constexpr int first_year = 1970, last_year = 2200;
+    std::vector<double> year_starts;
+    double start = 0, end = -1;
+    int year = 0;
+
+    // days between 1970-01-01 and the first of January of y
+    static int64_t daysSinceEpoch(int64_t y) {
+      y -= 1;
+      return 365 * (y - 1969) + (y / 4 - 492) - (y / 100 - 19) +
+             (y / 400 - 4);
+    }
+
+   public:
+    AcquisitionYearLookup() {
+      for (int y = first_year; y <= last_year + 1; ++y) {
+        year_starts.push_back(double(daysSinceEpoch(y) * 86400) -
+                              1315964800.0);
+      }
+    }
+
+    int operator()(double adjusted_gps_time) {
+      if (adjusted_gps_time >= start && adjusted_gps_time < end) return year;
+      auto it = std::upper_bound(year_starts.begin(), year_starts.end(),
+                                 adjusted_gps_time);
+      if (it == year_starts.begin() || it == year_starts.end()) {
+        return getAcquisitionYearOfPoint(adjusted_gps_time);
+      }
+      start = *(it - 1);
+      end = *it;
+      year = first_year + int(it - year_starts.begin()) - 1;
+      return year;
+    }
+  };
+
   // If GPS Week Time is used on the points, then we use the 'file creation
   // year' as acquisition year.
   bool useFileCreationYear(LASreader* lasreader) {
@@ -395,6 +474,153 @@ namespace roofer::io {
     }
   }
 
+  /**
+   * @brief The attributes of a batch of points that the cropper needs, with
+   * one array per attribute
+   */
+  struct PointBatch {
+    static constexpr size_t capacity = 65536;
+
+    std::vector<double> x, y, z, gps_time;
+    std::vector<uint8_t> classification;
+
+    size_t size() const { return x.size(); }
+
+    void push_back(const LASpoint& point) {
+      x.push_back(point.get_x());
+      y.push_back(point.get_y());
+      z.push_back(point.get_z());
+      gps_time.push_back(point.get_gps_time());
+      classification.push_back(point.get_classification());
+    }
+  };
+
+  // Closes and deletes a LASreader
+  struct LASreaderCloser {
+    void operator()(LASreader* lasreader) const {
+      lasreader->close();
+      delete lasreader;
+    }
+  };
+  using LASreaderPtr = std::unique_ptr<LASreader, LASreaderCloser>;
+
+  // A range of points in a LAS file, aligned to the LAZ chunks
+  struct PointRange {
+    I64 begin, end;
+  };
+
+  // Ranges of about range_points points that start at a LAZ chunk. A file
+  // with a spatial index, without chunks, or with variable sized chunks is
+  // read as a single range.
+  std::vector<PointRange> splitInRanges(LASreader* lasreader,
+                                        I64 range_points) {
+    const I64 npoints = lasreader->npoints;
+    const LASzip* laszip = lasreader->header.laszip;
+    if (lasreader->get_index() != nullptr || laszip == nullptr ||
+        laszip->chunk_size == 0 || laszip->chunk_size == U32_MAX) {
+      return {{0, npoints}};
+    }
+    const I64 chunk_size = laszip->chunk_size;
+    const I64 range_size =
+        std::max<I64>(1, range_points / chunk_size) * chunk_size;
+    std::vector<PointRange> ranges;
+    for (I64 begin = 0; begin < npoints; begin += range_size) {
+      ranges.push_back({begin, std::min(begin + range_size, npoints)});
+    }
+    return ranges;
+  }
+
+  /**
+   * @brief Decodes the ranges of a LAS file with several threads and hands
+   * the points inside the aoi to consume in file order.
+   *
+   * Every thread opens its own reader on the file and seeks to the start of
+   * a range, which for LAZ files is the start of a chunk so that the chunks
+   * are decompressed independently. At most two ranges per thread are
+   * decoded ahead of the range that is consumed, which bounds the memory use.
+   */
+  template <typename Consume>
+  void decodeRanges(const std::string& lasfile,
+                    const std::vector<PointRange>& ranges, const arr3d& aoi_min,
+                    const arr3d& aoi_max, size_t n_threads, Consume&& consume) {
+    const size_t max_ahead = 2 * n_threads;
+    std::vector<std::promise<PointBatch>> promises(ranges.size());
+    size_t next_range = 0, n_consumed = 0;
+    bool stop = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    auto decode = [&]() {
+      while (true) {
+        size_t r;
+        {
+          std::unique_lock lock{mutex};
+          cv.wait(lock, [&] {
+            return stop || next_range >= ranges.size() ||
+                   next_range < n_consumed + max_ahead;
+          });
+          if (stop || next_range >= ranges.size()) return;
+          r = next_range++;
+        }
+        try {
+          LASreadOpener lasreadopener;
+          lasreadopener.set_file_name(lasfile.c_str());
+          LASreaderPtr lasreader(lasreadopener.open());
+          if (!lasreader) {
+            throw std::runtime_error("cannot read las file: " + lasfile);
+          }
+          if (!lasreader->seek(ranges[r].begin)) {
+            throw std::runtime_error(
+                fmt::format("cannot seek to point {} in las file: {}",
+                            ranges[r].begin, lasfile));
+          }
+          PointBatch batch;
+          while (lasreader->p_count < ranges[r].end &&
+                 lasreader->read_point()) {
+            const auto& point = lasreader->point;
+            const double x = point.get_x(), y = point.get_y();
+            // same test as LASreader::inside_rectangle
+            if (x >= aoi_min[0] && x < aoi_max[0] && y >= aoi_min[1] &&
+                y < aoi_max[1]) {
+              batch.push_back(point);
+            }
+          }
+          lasreader.reset();
+          promises[r].set_value(std::move(batch));
+        } catch (...) {
+          promises[r].set_exception(std::current_exception());
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(n_threads, ranges.size()); ++i) {
+      threads.emplace_back(decode);
+    }
+    auto join = [&]() {
+      {
+        std::scoped_lock lock{mutex};
+        stop = true;
+      }
+      cv.notify_all();
+      for (auto& thread : threads) thread.join();
+    };
+    try {
+      for (size_t r = 0; r < ranges.size(); ++r) {
+        consume(promises[r].get_future().get());
+        {
+          std::scoped_lock lock{mutex};
+          ++n_consumed;
+        }
+        cv.notify_all();
+      }
+    } catch (...) {
+      join();
+      throw;
+    }
+    join();
+  }
+
   void getOgcWkt(LASheader* lasheader, std::string& wkt) {
     auto& logger = logger::Logger::get_logger();
     for (int i = 0; i < (int)lasheader->number_of_variable_length_records;
@@ -458,18 +684,18 @@ namespace roofer::io {
       for (auto lasfile : lasfiles) {
         LASreadOpener lasreadopener;
         lasreadopener.set_file_name(lasfile.c_str());
-        LASreader* lasreader = lasreadopener.open();
-
-        std::string wkt = cfg.wkt_;
-        if (wkt.size() == 0) {
-          getOgcWkt(&lasreader->header, wkt);
-        }
+        LASreaderPtr lasreader(lasreadopener.open());
 
         if (!lasreader) {
           logger.warning("cannot read las file: {}", lasfile);
           continue;
         }
 
+        std::string wkt = cfg.wkt_;
+        if (wkt.size() == 0) {
+          getOgcWkt(&lasreader->header, wkt);
+        }
+
         Box file_bbox;
         file_bbox.add(pjHelper.coord_transform_fwd(lasreader->get_min_x(),
                                                    lasreader->get_min_y(),
@@ -501,24 +727,56 @@ namespace roofer::io {
         // last point in the AOI. Unless, GPS Week Time is used, in which case
         // we default to the 'file creation year'.
         int acqusition_year(0);
-        bool use_file_creation_year = useFileCreationYear(lasreader);
+        bool use_file_creation_year = useFileCreationYear(lasreader.get());
         if (use_file_creation_year) {
           acqusition_year = (int)lasreader->header.file_creation_year;
         }
+        const bool use_gps_time =
+            !use_file_creation_year && cfg.use_acquisition_year;
+        AcquisitionYearLookup acquisition_year_of;
+        std::vector<arr3f> points;
+        auto add_batch = [&](const PointBatch& batch) {
+          points.resize(batch.size());
+          pjHelper.coord_transform_fwd(batch.x.data(), batch.y.data(),
+                                       batch.z.data(), batch.size(),
+                                       points.data());
+          for (size_t i = 0; i < batch.size(); ++i) {
+            if (use_gps_time)
+              acqusition_year = acquisition_year_of(batch.gps_time[i]);
+            pip_collector.add_point(points[i], batch.classification[i],
+                                    acqusition_year);
+          }
+        };
+
+        // the building point clouds are mostly filled from one file, reserve
+        // room for them from the point density of the file
+        const double file_area =
+            (lasreader->get_max_x() - lasreader->get_min_x()) *
+            (lasreader->get_max_y() - lasreader->get_min_y());
+        if (file_area > 0) {
+          pip_collector.reserve(float(lasreader->npoints / file_area));
+        }
+
+        auto ranges =
+            splitInRanges(lasreader.get(), I64(cfg.decode_range_points));
+        if (cfg.decode_threads > 1 && ranges.size() > 1) {
+          lasreader.reset();
+          decodeRanges(lasfile, ranges, aoi_min, aoi_max,
+                       size_t(cfg.decode_threads), add_batch);
+          continue;
+        }
+
+        PointBatch batch;
         while (lasreader->read_point()) {
-          if (!use_file_creation_year && cfg.use_acquisition_year)
-            acqusition_year = getAcquisitionYearOfPoint(&lasreader->point);
-          pip_collector.add_point(
-              pjHelper.coord_transform_fwd(lasreader->point.get_x(),
-                                           lasreader->point.get_y(),
-                                           lasreader->point.get_z()),
-              lasreader->point.get_classification(), acqusition_year);
+          batch.push_back(lasreader->point);
+          if (batch.size() == PointBatch::capacity) {
+            add_batch(batch);
+            batch = PointBatch();
+          }
         }
+        add_batch(batch);
         // logger.info("Point cloud acquisition year: {}",
         // acqusition_year);  // just for debug
-
-        lasreader->close();
-        delete lasreader;
       }
 
       pip_collector.do_post_process(
@@ -22,6 +22,7 @@
 #include <ogrsf_frmts.h>
 #include <roofer/logger/logger.h>
 
+#include <algorithm>
 #include <array>
 #include <filesystem>
 #include <fstream>
@@ -44,70 +45,62 @@ namespace roofer::io {
     float base_elevation = 0;
     bool output_fid_ = false;
 
+    // Appends the value of one field of a feature to its attribute column
+    struct FieldReader {
+      // -1 for the feature id
+      int field_index;
+      std::variant<veco1b*, veco1i*, veco1f*, veco1s*, veco1D*, veco1T*,
+                   veco1DT*>
+          column;
+    };
+
     void push_attributes(const OGRFeature& poFeature,
-                         AttributeVecMap* attributes,
-                         std::unordered_map<std::string, int>& field_name_map) {
-      for (auto& [name, idx] : field_name_map) {
-        if (auto attr = attributes->get_if<bool>(name)) {
-          if (poFeature.IsFieldNull(idx)) {
-            attr->push_back(std::nullopt);
-          } else {
-            attr->push_back(bool(poFeature.GetFieldAsInteger(name.c_str())));
-          }
-        } else if (auto attr = attributes->get_if<int>(name)) {
-          if (poFeature.IsFieldNull(idx)) {
-            attr->push_back(std::nullopt);
-          } else {
-            if (name == "OGR_FID") {
-              attr->push_back(int(poFeature.GetFID()));
-            } else {
-              attr->push_back(int(poFeature.GetFieldAsInteger64(name.c_str())));
-            }
-          }
-        } else if (auto attr = attributes->get_if<float>(name)) {
-          if (poFeature.IsFieldNull(idx)) {
-            attr->push_back(std::nullopt);
-          } else {
-            attr->push_back(float(poFeature.GetFieldAsDouble(name.c_str())));
-          }
-        } else if (auto attr = attributes->get_if<std::string>(name)) {
-          if (poFeature.IsFieldNull(idx)) {
-            attr->push_back(std::nullopt);
-          } else {
-            attr->push_back(
-                (std::string)poFeature.GetFieldAsString(name.c_str()));
-          }
-        } else if (auto attr = attributes->get_if<Date>(name)) {
-          if (poFeature.IsFieldNull(idx)) {
-            attr->push_back(std::nullopt);
-          } else {
-            DateTime t;
-            poFeature.GetFieldAsDateTime(field_name_map[name], &t.date.year,
-                                         &t.date.month, &t.date.day, nullptr,
-                                         nullptr, &t.time.second, nullptr);
-            attr->push_back(t.date);
-          }
-        } else if (auto attr = attributes->get_if<Time>(name)) {
-          if (poFeature.IsFieldNull(idx)) {
-            attr->push_back(std::nullopt);
-          } else {
-            Time time;
-            poFeature.GetFieldAsDateTime(field_name_map[name], nullptr, nullptr,
-                                         nullptr, &time.hour, &time.minute,
-                                         &time.second, &time.timeZone);
-            attr->push_back(time);
-          }
-        } else if (auto attr = attributes->get_if<DateTime>(name)) {
-          if (poFeature.IsFieldNull(idx)) {
-            attr->push_back(std::nullopt);
-          } else {
-            DateTime t;
-            poFeature.GetFieldAsDateTime(
-                field_name_map[name], &t.date.year, &t.date.month, &t.date.day,
-                &t.time.hour, &t.time.minute, &t.time.second, &t.time.timeZone);
-            attr->push_back(t);
-          }
+                         const std::vector<FieldReader>& field_readers) {
+      for (auto& reader : field_readers) {
+        const int idx = reader.field_index;
+        if (idx == -1) {
+          std::get<veco1i*>(reader.column)->push_back(int(poFeature.GetFID()));
+          continue;
         }
+        if (poFeature.IsFieldNull(idx)) {
+          std::visit([](auto column) { column->push_back(std::nullopt); },
+                     reader.column);
+          continue;
+        }
+        std::visit(
+            [&poFeature, idx](auto column) {
+              using T = typename std::remove_pointer_t<
+                  decltype(column)>::value_type::value_type;
+              if constexpr (std::is_same_v<T, bool>) {
+                column->push_back(bool(poFeature.GetFieldAsInteger(idx)));
+              } else if constexpr (std::is_same_v<T, int>) {
+                column->push_back(int(poFeature.GetFieldAsInteger64(idx)));
+              } else if constexpr (std::is_same_v<T, float>) {
+                column->push_back(float(poFeature.GetFieldAsDouble(idx)));
+              } else if constexpr (std::is_same_v<T, std::string>) {
+                column->push_back(std::string(poFeature.GetFieldAsString(idx)));
+              } else if constexpr (std::is_same_v<T, Date>) {
+                DateTime t;
+                poFeature.GetFieldAsDateTime(idx, &t.date.year, &t.date.month,
+                                             &t.date.day, nullptr, nullptr,
+                                             &t.time.second, nullptr);
+                column->push_back(t.date);
+              } else if constexpr (std::is_same_v<T, Time>) {
+                Time time;
+                poFeature.GetFieldAsDateTime(idx, nullptr, nullptr, nullptr,
+                                             &time.hour, &time.minute,
+                                             &time.second, &time.timeZone);
+                column->push_back(time);
+              } else if constexpr (std::is_same_v<T, DateTime>) {
+                DateTime t;
+                poFeature.GetFieldAsDateTime(
+                    idx, &t.date.year, &t.date.month, &t.date.day,
+                    &t.time.hour, &t.time.minute, &t.time.second,
+                    &t.time.timeZone);
+                column->push_back(t);
+              }
+            },
+            reader.column);
       }
     }
 
@@ -189,6 +182,17 @@ namespace roofer::io {
       return poLayer->GetFeatureCount();
     }
 
+    size_t get_feature_count(const TBox<double>& extent) override {
+      if (poLayer == nullptr) {
+        throw(rooferException("[VectorReaderOGR] Layer is not open"));
+      }
+      poLayer->SetSpatialFilterRect(extent.pmin[0], extent.pmin[1],
+                                    extent.pmax[0], extent.pmax[1]);
+      auto count = poLayer->GetFeatureCount();
+      poLayer->SetSpatialFilter(nullptr);
+      return count;
+    }
+
     void get_crs(SpatialReferenceSystemInterface* srs) override {
       if (poLayer == nullptr) {
         throw(rooferException("[VectorReaderOGR] Layer is not open"));
@@ -241,6 +245,31 @@ namespace roofer::io {
       polygons.push_back(gf_polygon);
     }
 
+    void readCentroids(std::vector<arr3d>& centroids) override {
+      if (poLayer == nullptr) {
+        throw(rooferException("[VectorReaderOGR] Layer is not open"));
+      }
+      poLayer->ResetReading();
+      if (auto roi = this->region_of_interest) {
+        poLayer->SetSpatialFilterRect(roi->pmin[0], roi->pmin[1], roi->pmax[0],
+                                      roi->pmax[1]);
+      }
+      OGRFeature* poFeature;
+      while ((poFeature = poLayer->GetNextFeature()) != NULL) {
+        OGRGeometry* poGeometry = poFeature->GetGeometryRef();
+        OGRPoint poPoint;
+        if (poGeometry && poGeometry->Centroid(&poPoint) == OGRERR_NONE) {
+          arr3d p = {poPoint.getX(), poPoint.getY(), 0};
+          if (!region_of_interest || region_of_interest->intersects(p)) {
+            centroids.push_back(p);
+          }
+        }
+        OGRFeature::DestroyFeature(poFeature);
+      }
+      poLayer->SetSpatialFilter(nullptr);
+      poLayer->ResetReading();
+    }
+
     void readPolygons(std::vector<LinearRing>& polygons,
                       AttributeVecMap* attributes) override {
       auto& logger = logger::Logger::get_logger();
@@ -264,34 +293,77 @@ namespace roofer::io {
       // auto &is_valid = vector_output("is_valid");
       // auto &area = vector_output("area");
 
-      std::unordered_map<std::string, int> field_name_map;
+      // the columns are looked up once, the features are then read with the
+      // field indices
+      std::vector<FieldReader> field_readers;
+      std::vector<std::string> ignored_fields;
+      // fields that may be used in the attribute filter are never ignored
+      auto ignore = [this, &ignored_fields](const std::string& field_name) {
+        if (attribute_filter.find(field_name) == std::string::npos) {
+          ignored_fields.push_back(field_name);
+        }
+      };
       if (attributes) {
         if (output_fid_) {
-          attributes->insert_vec<int>("OGR_FID");
-          field_name_map["OGR_FID"] = -1;
+          field_readers.push_back(
+              {-1, &attributes->insert_vec<int>("OGR_FID")});
         }
-        for (size_t i = 0; i < field_count; ++i) {
+        for (int i = 0; i < field_count; ++i) {
           auto field_def = layer_def->GetFieldDefn(i);
           auto t = field_def->GetType();
           auto field_name = (std::string)field_def->GetNameRef();
-          field_name_map[field_name] = i;
+          if (!attributes_keep.empty() &&
+              std::find(attributes_keep.begin(), attributes_keep.end(),
+                        field_name) == attributes_keep.end()) {
+            ignore(field_name);
+            continue;
+          }
           if ((t == OFTInteger) && (field_def->GetSubType() == OFSTBoolean)) {
-            attributes->insert_vec<bool>(field_name);
+            field_readers.push_back(
+                {i, &attributes->insert_vec<bool>(field_name)});
           } else if (t == OFTInteger || t == OFTInteger64) {
-            attributes->insert_vec<int>(field_name);
+            field_readers.push_back(
+                {i, &attributes->insert_vec<int>(field_name)});
           } else if (t == OFTString) {
-            attributes->insert_vec<std::string>(field_name);
+            field_readers.push_back(
+                {i, &attributes->insert_vec<std::string>(field_name)});
           } else if (t == OFTReal) {
-            attributes->insert_vec<float>(field_name);
+            field_readers.push_back(
+                {i, &attributes->insert_vec<float>(field_name)});
           } else if (t == OFTDate) {
-            attributes->insert_vec<Date>(field_name);
+            field_readers.push_back(
+                {i, &attributes->insert_vec<Date>(field_name)});
           } else if (t == OFTTime) {
-            attributes->insert_vec<Time>(field_name);
+            field_readers.push_back(
+                {i, &attributes->insert_vec<Time>(field_name)});
           } else if (t == OFTDateTime) {
-            attributes->insert_vec<DateTime>(field_name);
+            field_readers.push_back(
+                {i, &attributes->insert_vec<DateTime>(field_name)});
+          } else {
+            ignore(field_name);
           }
         }
+      } else {
+        for (int i = 0; i < field_count; ++i) {
+          ignore(layer_def->GetFieldDefn(i)->GetNameRef());
+        }
+      }
+      ignored_fields.push_back("OGR_STYLE");
+      // fields that are not read are not fetched by the driver
+      std::vector<const char*> ignored_field_names;
+      for (auto& name : ignored_fields) {
+        ignored_field_names.push_back(name.c_str());
+      }
+      ignored_field_names.push_back(nullptr);
+      if (poLayer->SetIgnoredFields(ignored_field_names.data()) !=
+          OGRERR_NONE) {
+        logger.debug("Layer does not support ignoring fields");
       }
+      // restore the ignored fields also when reading throws
+      struct IgnoredFieldsReset {
+        OGRLayer* layer;
+        ~IgnoredFieldsReset() { layer->SetIgnoredFields(nullptr); }
+      } ignored_fields_reset{poLayer};
 
       poLayer->ResetReading();
       if (this->region_of_interest.has_value()) {
@@ -334,7 +406,7 @@ namespace roofer::io {
           // area.push_back(float(poPolygon->get_Area()));
           // is_valid.push_back(bool(poPolygon->IsValid()));
           if (attributes)
-            push_attributes(*poFeature, attributes, field_name_map);
+            push_attributes(*poFeature, field_readers);
 
         } else if (wkbFlatten(poGeometry->getGeometryType()) ==
                    wkbMultiPolygon) {
@@ -346,7 +418,7 @@ namespace roofer::io {
             // area.push_back(float((*poly_it)->get_Area()));
             // is_valid.push_back(bool((*poly_it)->IsValid()));
             if (attributes)
-              push_attributes(*poFeature, attributes, field_name_map);
+              push_attributes(*poFeature, field_readers);
           }
         } else {
           throw rooferException(
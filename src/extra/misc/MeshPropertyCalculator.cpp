@@ -22,6 +22,7 @@
 #include <CGAL/linear_least_squares_fitting_3.h>
 
 #include <roofer/reconstruction/cgal_shared_definitions.hpp>
+#include <roofer/common/percentile.hpp>
 #include <roofer/misc/MeshPropertyCalculator.hpp>
 
 namespace roofer::misc {
@@ -31,6 +32,9 @@ namespace roofer::misc {
   static const CF::Vector_3 up = CF::Vector_3(0, 0, 1);
 
   struct MeshPropertyCalculator : public MeshPropertyCalculatorInterface {
+    // roof face elevations, reused between faces
+    std::vector<float> part_z_;
+
     void rasterise_ring(LinearRing& polygon, RasterTools::Raster& r) {
       typedef double FT;
       typedef CGAL::Simple_cartesian<FT> K;
@@ -50,13 +54,14 @@ namespace roofer::misc {
       auto cr_min = r.getColRowCoord(bb_min[0], bb_min[1]);
       auto cr_max = r.getColRowCoord(bb_max[0], bb_max[1]);
 
-      auto points_inside = r.rasterise_polygon(polygon, cr_min, cr_max);
-      for (auto& p : points_inside) {
-        float z_interpolate = -plane.a() / plane.c() * p[0] -
-                              plane.b() / plane.c() * p[1] -
-                              plane.d() / plane.c();
-        r.add_point(p[0], p[1], z_interpolate, RasterTools::MAX);
-      }
+      double a = -plane.a() / plane.c(), b = -plane.b() / plane.c(),
+             d = -plane.d() / plane.c();
+      r.visit_polygon_cells(polygon, cr_min, cr_max,
+                            [&](size_t col, size_t row, float x, float y) {
+                              float z_interpolate = a * x + b * y + d;
+                              r.add_cell_value(col, row, z_interpolate,
+                                               RasterTools::MAX);
+                            });
     };
 
     void calculate_h_attr(Mesh& mesh, RasterTools::Raster& r_lod22,
@@ -72,27 +77,24 @@ namespace roofer::misc {
           auto bb_max = box.max();
           auto cr_min = r_lod22.getColRowCoord(bb_min[0], bb_min[1]);
           auto cr_max = r_lod22.getColRowCoord(bb_max[0], bb_max[1]);
-          auto part_points =
-              r_lod22.rasterise_polygon(polygon, cr_min, cr_max, false);
-
-          if (part_points.size() == 0) {
-            part_points.insert(part_points.begin(), polygon.begin(),
-                               polygon.end());
+          part_z_.clear();
+          r_lod22.visit_polygon_cells(
+              polygon, cr_min, cr_max,
+              [&](size_t col, size_t row, float x, float y) {
+                float z = r_lod22.vals_[col + row * r_lod22.dimx_];
+                if (z != r_lod22.noDataVal_) part_z_.push_back(z);
+              });
+
+          if (part_z_.size() == 0) {
+            for (auto& p : polygon) part_z_.push_back(p[2]);
           }
-          std::sort(part_points.begin(), part_points.end(),
-                    [](auto& p1, auto& p2) { return p1[2] < p2[2]; });
-
-          size_t N = part_points.size();
-          int elevation_id = std::floor(0.5 * float(N - 1));
-          attributes[i].insert(
-              cfg.h_50p, float(part_points[elevation_id][2] + cfg.z_offset));
-          elevation_id = std::floor(0.7 * float(N - 1));
-          attributes[i].insert(
-              cfg.h_70p, float(part_points[elevation_id][2] + cfg.z_offset));
-          attributes[i].insert(cfg.h_min,
-                               float(part_points[0][2] + cfg.z_offset));
-          attributes[i].insert(cfg.h_max,
-                               float(part_points[N - 1][2] + cfg.z_offset));
+
+          auto [h50, h70, hmin, hmax] = compute_percentiles(
+              part_z_.begin(), part_z_.end(), {0.5, 0.7, 0.0, 1.0});
+          attributes[i].insert(cfg.h_50p, float(h50 + cfg.z_offset));
+          attributes[i].insert(cfg.h_70p, float(h70 + cfg.z_offset));
+          attributes[i].insert(cfg.h_min, float(hmin + cfg.z_offset));
+          attributes[i].insert(cfg.h_max, float(hmax + cfg.z_offset));
         }
       }
     };
@@ -19,108 +19,240 @@
 // Author(s):
 // Ravi Peters
 
-#include <CGAL/AABB_traits_3.h>
-#include <CGAL/AABB_tree.h>
-#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
-#include <CGAL/Search_traits_3.h>
-#include <CGAL/Simple_cartesian.h>
-
-#include <list>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
 #include <roofer/misc/PC2MeshDistCalculator.hpp>
 
 namespace roofer::misc {
 
-  typedef CGAL::Simple_cartesian<double> SCK;
+  /**
+   * @brief Bounding volume hierarchy for closest point queries on triangles
+   *
+   * The triangles are stored in one flat array, ordered so that every leaf
+   * covers a contiguous range. The boxes are stored in float, the distance to
+   * a triangle is computed in double.
+   */
+  class TriangleBVH {
+    struct Node {
+      arr3f min, max;
+      // first triangle for a leaf, index of the left child for an inner node
+      // (the right child follows it)
+      uint32_t first;
+      // number of triangles, 0 for an inner node
+      uint32_t count;
+    };
+    static constexpr uint32_t leaf_size = 4;
 
-  // custom triangle type with
-  // three pointers to points
-  struct My_triangle {
-    roofer::Triangle m_t;
-    size_t m_face_id;
-    My_triangle(roofer::Triangle t, size_t face_id)
-        : m_t(t), m_face_id(face_id) {}
-  };
-  // the custom triangles are stored into a vector
-  typedef std::list<My_triangle>::const_iterator Iterator;
-  // The following primitive provides the conversion facilities between
-  // the custom triangle and point types and the CGAL ones
-  struct My_triangle_primitive {
-   public:
-    // this is the type of data that the queries returns. For this example
-    // we imagine that, for some reasons, we do not want to store the iterators
-    // of the vector, but raw pointers. This is to show that the Id type
-    // does not have to be the same as the one of the input parameter of the
-    // constructor.
-    typedef const My_triangle* Id;
-    // CGAL types returned
-    typedef SCK::Point_3 Point;     // CGAL 3D point type
-    typedef SCK::Triangle_3 Datum;  // CGAL 3D triangle type
-   private:
-    Id m_mytri;  // this is what the AABB tree stores internally
-   public:
-    My_triangle_primitive() {}  // default constructor needed
-    // the following constructor is the one that receives the iterators from the
-    // iterator range given as input to the AABB_tree
-    My_triangle_primitive(Iterator it) : m_mytri(&(*it)) {}
-    const Id& id() const { return m_mytri; }
-    // on the fly conversion from the internal data to the CGAL types
-    Point convert(const roofer::arr3f& p) const {
-      return Point(p[0], p[1], p[2]);
+    std::vector<Node> nodes_;
+    std::vector<Triangle> triangles_;
+    std::vector<size_t> face_ids_;
+
+    // scratch buffers for build()
+    std::vector<uint32_t> order_;
+    std::vector<arr3f> centroids_;
+
+    static float box_sqdist(const Node& node, const arr3f& p) {
+      float d = 0;
+      for (int k = 0; k < 3; ++k) {
+        float e = std::max({node.min[k] - p[k], 0.f, p[k] - node.max[k]});
+        d += e * e;
+      }
+      return d;
     }
-    Datum datum() const {
-      return Datum(convert(m_mytri->m_t[0]), convert(m_mytri->m_t[1]),
-                   convert(m_mytri->m_t[2]));
+
+    // Squared distance from p to triangle t, from Ericson (2005) Real-Time
+    // Collision Detection, section 5.1.5.
+    static double triangle_sqdist(const Triangle& t, const arr3f& p) {
+      typedef std::array<double, 3> V;
+      auto sub = [](const V& u, const V& v) -> V {
+        return {u[0] - v[0], u[1] - v[1], u[2] - v[2]};
+      };
+      auto dot = [](const V& u, const V& v) {
+        return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+      };
+      const V a = {t[0][0], t[0][1], t[0][2]};
+      const V b = {t[1][0], t[1][1], t[1][2]};
+      const V c = {t[2][0], t[2][1], t[2][2]};
+      const V q = {p[0], p[1], p[2]};
+      auto sqd_to = [&](const V& x) {
+        V d = sub(q, x);
+        return dot(d, d);
+      };
+      auto at = [&](const V& o, const V& dir, double s) -> V {
+        return {o[0] + s * dir[0], o[1] + s * dir[1], o[2] + s * dir[2]};
+      };
+
+      V ab = sub(b, a), ac = sub(c, a), ap = sub(q, a);
+      double d1 = dot(ab, ap), d2 = dot(ac, ap);
+      if (d1 <= 0 && d2 <= 0) return sqd_to(a);
+
+      V bp = sub(q, b);
+      double d3 = dot(ab, bp), d4 = dot(ac, bp);
+      if (d3 >= 0 && d4 <= d3) return sqd_to(b);
+
+      double vc = d1 * d4 - d3 * d2;
+      if (vc <= 0 && d1 >= 0 && d3 <= 0)
+        return sqd_to(at(a, ab, d1 / (d1 - d3)));
+
+      V cp = sub(q, c);
+      double d5 = dot(ab, cp), d6 = dot(ac, cp);
+      if (d6 >= 0 && d5 <= d6) return sqd_to(c);
+
+      double vb = d5 * d2 - d1 * d6;
+      if (vb <= 0 && d2 >= 0 && d6 <= 0)
+        return sqd_to(at(a, ac, d2 / (d2 - d6)));
+
+      double va = d3 * d6 - d5 * d4;
+      if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+        return sqd_to(at(b, sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+
+      // inside the face region
+      double denom = 1 / (va + vb + vc);
+      double v = vb * denom, w = vc * denom;
+      V x = {a[0] + ab[0] * v + ac[0] * w, a[1] + ab[1] * v + ac[1] * w,
+             a[2] + ab[2] * v + ac[2] * w};
+      return sqd_to(x);
     }
-    // returns a reference point which must be on the primitive
-    Point reference_point() const { return convert(m_mytri->m_t[0]); }
-  };
 
-  class PC2MeshDistCalculator : public PC2MeshDistCalculatorInterface {
-    vec1f compute_mesh2pc_errors(const TriangleCollection& triangles,
-                                 std::vector<SCK::Point_3> points) {
-      // KD tree
-      typedef CGAL::Search_traits_3<SCK> TreeTraits;
-      typedef CGAL::Orthogonal_k_neighbor_search<TreeTraits> Neighbor_search;
-      typedef Neighbor_search::Tree Tree;
-
-      Tree tree(points.begin(), points.end());
-      vec1f errors;
-      const unsigned int N = 1;
-      for (const auto& triangle : triangles) {
-        for (const auto& p : triangle) {
-          Neighbor_search search(tree, SCK::Point_3(p[0], p[1], p[2]), N);
-          for (Neighbor_search::iterator it = search.begin();
-               it != search.end(); ++it) {
-            errors.push_back(std::sqrt(it->second));
+    void build_node(uint32_t node_idx, uint32_t begin, uint32_t end) {
+      Node node;
+      node.min = {std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max()};
+      node.max = {std::numeric_limits<float>::lowest(),
+                  std::numeric_limits<float>::lowest(),
+                  std::numeric_limits<float>::lowest()};
+      arr3f cmin = node.min, cmax = node.max;
+      for (uint32_t i = begin; i < end; ++i) {
+        for (auto& v : triangles_[order_[i]]) {
+          for (int k = 0; k < 3; ++k) {
+            node.min[k] = std::min(node.min[k], v[k]);
+            node.max[k] = std::max(node.max[k], v[k]);
           }
         }
+        auto& c = centroids_[order_[i]];
+        for (int k = 0; k < 3; ++k) {
+          cmin[k] = std::min(cmin[k], c[k]);
+          cmax[k] = std::max(cmax[k], c[k]);
+        }
+      }
+
+      if (end - begin <= leaf_size) {
+        node.first = begin;
+        node.count = end - begin;
+        nodes_[node_idx] = node;
+        return;
       }
-      return errors;
+
+      // split at the median centroid along the longest axis
+      int axis = 0;
+      for (int k = 1; k < 3; ++k) {
+        if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) axis = k;
+      }
+      uint32_t mid = begin + (end - begin) / 2;
+      std::nth_element(order_.begin() + begin, order_.begin() + mid,
+                       order_.begin() + end, [&](uint32_t a, uint32_t b) {
+                         return centroids_[a][axis] < centroids_[b][axis];
+                       });
+
+      node.first = nodes_.size();
+      node.count = 0;
+      nodes_[node_idx] = node;
+      nodes_.resize(nodes_.size() + 2);
+      build_node(node.first, begin, mid);
+      build_node(node.first + 1, mid, end);
+    }
+
+   public:
+    void clear() {
+      nodes_.clear();
+      triangles_.clear();
+      face_ids_.clear();
+    }
+
+    void push_back(const Triangle& triangle, size_t face_id) {
+      triangles_.push_back(triangle);
+      face_ids_.push_back(face_id);
     }
 
-    vec1f compute_pc2pc_errors(PointCollection points_from,
-                               PointCollection points_to) {
-      // KD tree
-      typedef CGAL::Search_traits_3<SCK> TreeTraits;
-      typedef CGAL::Orthogonal_k_neighbor_search<TreeTraits> Neighbor_search;
-      typedef Neighbor_search::Tree Tree;
+    size_t size() const { return triangles_.size(); }
+
+    void build() {
+      nodes_.clear();
+      if (triangles_.empty()) return;
 
-      std::vector<SCK::Point_3> points_to_;
-      for (auto& p : points_to) {
-        points_to_.push_back(SCK::Point_3(p[0], p[1], p[2]));
+      order_.resize(triangles_.size());
+      centroids_.resize(triangles_.size());
+      for (uint32_t i = 0; i < triangles_.size(); ++i) {
+        order_[i] = i;
+        auto& t = triangles_[i];
+        for (int k = 0; k < 3; ++k) {
+          centroids_[i][k] = (t[0][k] + t[1][k] + t[2][k]) / 3;
+        }
       }
-      Tree tree(points_to_.begin(), points_to_.end());
-      vec1f errors;
-      const unsigned int N = 1;
-      for (const auto& p : points_from) {
-        Neighbor_search search(tree, SCK::Point_3(p[0], p[1], p[2]), N);
-        for (Neighbor_search::iterator it = search.begin(); it != search.end();
-             ++it) {
-          errors.push_back(std::sqrt(it->second));
+      nodes_.resize(1);
+      build_node(0, 0, triangles_.size());
+
+      // store the triangles in leaf order
+      std::vector<Triangle> triangles(triangles_.size());
+      std::vector<size_t> face_ids(face_ids_.size());
+      for (size_t i = 0; i < order_.size(); ++i) {
+        triangles[i] = triangles_[order_[i]];
+        face_ids[i] = face_ids_[order_[i]];
+      }
+      triangles_ = std::move(triangles);
+      face_ids_ = std::move(face_ids);
+    }
+
+    /**
+     * @brief Squared distance from p to the closest triangle
+     *
+     * face_id is set to the face id of that triangle. build() must have been
+     * called. Returns false and leaves face_id untouched if no triangle has a
+     * finite distance to p, eg. when the hierarchy is empty or p or the
+     * triangles contain NaN coordinates.
+     */
+    bool closest(const arr3f& p, double& sqdist, size_t& face_id) const {
+      if (nodes_.empty()) return false;
+      bool found = false;
+      double best = std::numeric_limits<double>::max();
+      uint32_t stack[64];
+      int top = 0;
+      stack[top++] = 0;
+      while (top) {
+        const Node& node = nodes_[stack[--top]];
+        if (box_sqdist(node, p) > best) continue;
+        if (node.count) {
+          for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            double d = triangle_sqdist(triangles_[i], p);
+            if (d < best) {
+              best = d;
+              face_id = face_ids_[i];
+              found = true;
+            }
+          }
+        } else {
+          // visit the nearest child first, so it is pushed last
+          uint32_t near = node.first, far = node.first + 1;
+          if (box_sqdist(nodes_[far], p) < box_sqdist(nodes_[near], p))
+            std::swap(near, far);
+          stack[top++] = far;
+          stack[top++] = near;
         }
       }
-      return errors;
+      sqdist = best;
+      return found;
     }
+  };
+
+  class PC2MeshDistCalculator : public PC2MeshDistCalculatorInterface {
+    TriangleBVH bvh_;
+    std::unordered_map<size_t, std::pair<double, size_t>> face_sums_;
 
     std::string get_json_histogram(vec1f& values) {
       std::sort(values.begin(), values.end(),
@@ -161,124 +293,89 @@ namespace roofer::misc {
     }
 
    public:
-    void compute(const std::vector<SCK::Point_3>& points,
+    void compute(const std::vector<arr3f>& points,
                  const MultiTriangleCollection& mtcs,
                  const roofer::vec1i& face_ids,
                  PC2MeshDistCalculatorConfig cfg) {
-      typedef CGAL::AABB_traits_3<SCK, My_triangle_primitive> My_AABB_traits;
-      typedef CGAL::AABB_tree<My_AABB_traits> Tree;
+      reset();
 
-      TriangleCollection trin;
+      // only the roof triangles, face_ids is indexed by the roof triangle
+      // index
+      bvh_.clear();
+      size_t n_tri = 0;
       for (size_t j = 0; j < mtcs.tri_size(); j++) {
         const auto& tc = mtcs.tri_at(j);
         const auto& labels = mtcs.attr_at(j).at("labels");
         for (size_t i = 0; i < tc.size(); ++i) {
-          if (std::get<int>(labels[i]) == 1) trin.push_back(tc[i]);
+          if (std::get<int>(labels[i]) == 1) {
+            bvh_.push_back(tc[i], face_ids[n_tri * 3]);
+            ++n_tri;
+          }
         }
       }
 
       // do not run if one of the inputs is empty
-      if (points.size() == 0 || trin.size() == 0) {
-        // std::cout << "Either input points or triangles are empty. Stopping "
-        //              "execution.";
+      if (points.size() == 0 || bvh_.size() == 0) {
         return;
       }
+      bvh_.build();
 
-      std::list<My_triangle> triangles;
-      for (size_t i = 0; i < trin.size(); ++i) {
-        triangles.push_back(My_triangle(trin[i], face_ids[i * 3]));
-      }
-
-      // constructs AABB tree
-      Tree tree(triangles.begin(), triangles.end());
-      tree.accelerate_distance_queries();
-
-      std::map<size_t, std::vector<double>> distances;
-      vec1f point_errors;
-      size_t i = 0;
+      // accumulate the squared errors per face, points without a closest
+      // triangle get a NaN point error and do not count for the rms error
+      face_sums_.clear();
+      point_errors.reserve(points.size());
+      double sum_total = 0;
+      size_t n_measured = 0;
       for (auto& p : points) {
-        auto pt_and_id = tree.closest_point_and_primitive(p);
-        auto sqd = CGAL::squared_distance(pt_and_id.first, p);
-        auto fid = pt_and_id.second->m_face_id;
-        distances[fid].push_back(sqd);
+        double sqd;
+        size_t fid = 0;
+        if (!bvh_.closest(p, sqd, fid)) {
+          point_errors.push_back(std::numeric_limits<float>::quiet_NaN());
+          continue;
+        }
+        auto& [sum, cnt] = face_sums_[fid];
+        sum += sqd;
+        ++cnt;
+        sum_total += sqd;
+        ++n_measured;
         point_errors.push_back(sqd);
       }
-
-      double sum_total = 0;
-      size_t len = 0;
-      std::map<size_t, float> face_error_map;
-      for (auto& [fid, errors] : distances) {
-        double sum_face = 0;
-        len += errors.size();
-        for (double& error : errors) {
-          sum_face += error;
-        }
-        face_error_map[fid] = float(CGAL::sqrt(sum_face / errors.size()));
-        sum_total += sum_face;
+      if (n_measured == 0) {
+        reset();
+        return;
       }
-      rms_error = float(CGAL::sqrt(sum_total / len));
+      rms_error = float(std::sqrt(sum_total / n_measured));
 
-      vec1f face_errors;
-      for (size_t i = 0; i < trin.size(); ++i) {
+      face_errors.reserve(n_tri * 3);
+      mesh_error.assign(n_tri * 3, rms_error);
+      for (size_t i = 0; i < n_tri; ++i) {
         size_t fid = face_ids[i * 3];
         // push zero error if this face has no points/no error defined
-        if (face_error_map.find(fid) == face_error_map.end()) {
-          face_errors.push_back(0);
-          face_errors.push_back(0);
-          face_errors.push_back(0);
-        } else {
-          face_errors.push_back(face_error_map[fid]);
-          face_errors.push_back(face_error_map[fid]);
-          face_errors.push_back(face_error_map[fid]);
+        float error = 0;
+        auto it = face_sums_.find(fid);
+        if (it != face_sums_.end()) {
+          error = float(std::sqrt(it->second.first / it->second.second));
         }
+        face_errors.insert(face_errors.end(), 3, error);
       }
-
-      vec1f mesh_error;
-      for (auto& t : triangles) {
-        mesh_error.push_back(rms_error);
-        mesh_error.push_back(rms_error);
-        mesh_error.push_back(rms_error);
-      }
-
-      // compute point error stats
-      // {
-      //   auto json = get_json_histogram(point_errors);
-      //   output("error_hist").set(json);
-      // }
-
-      // compute mesh to point cloud errors
-      // {
-      //   auto m2pc_errors = compute_mesh2pc_errors(trin, points);
-      //   auto json = get_json_histogram(m2pc_errors);
-      //   output("m2pc_error_hist").set(json);
-      //   output("m2pc_error_max").set(m2pc_errors.back());
-      // }
-
-      // output("point_errors").set(point_errors);
-      // output("face_errors").set(face_errors);
-      // output("mesh_error_f").set(rms_error);
-      // output("mesh_error").set(mesh_error);
     }
     void compute(const PointCollection& ipoints,
                  const MultiTriangleCollection& mtcs,
                  const roofer::vec1i& face_ids,
                  PC2MeshDistCalculatorConfig cfg) override {
-      std::vector<SCK::Point_3> points;
-      for (auto& p : ipoints) {
-        points.push_back(SCK::Point_3(p[0], p[1], p[2]));
-      }
-      compute(points, mtcs, face_ids, cfg);
+      compute(static_cast<const std::vector<arr3f>&>(ipoints), mtcs, face_ids,
+              cfg);
     }
     void compute(const IndexedPlanesWithPoints& points_per_plane,
                  const MultiTriangleCollection& mtcs,
                  const roofer::vec1i& face_ids,
                  PC2MeshDistCalculatorConfig cfg) override {
-      std::vector<SCK::Point_3> points;
+      std::vector<arr3f> points;
 
       for (auto& [plane_id, plane_pts] : points_per_plane) {
         if (plane_id > 0) {
           for (auto& p : plane_pts.second) {
-            points.push_back(SCK::Point_3(p.x(), p.y(), p.z()));
+            points.push_back({float(p.x()), float(p.y()), float(p.z())});
           }
         }
       }
@@ -48,30 +48,30 @@ namespace roofer::misc {
     auto boxmin = box.min();
     auto boxmax = box.max();
 
+    // the max raster also holds the ground and non-ground point counts
+    enum { GROUND_CNT, NON_GROUND_CNT };
     RasterTools::Raster r_max(cellsize, boxmin[0], boxmax[0], boxmin[1],
-                              boxmax[1]);
+                              boxmax[1], 2);
     r_max.prefill_arrays(RasterTools::MAX);
 
-    RasterTools::Raster r_min(r_max), r_fp(r_max), r_grp(r_max),
-        r_ground_points(r_max), r_non_ground_points(r_max);
+    RasterTools::Raster r_min(cellsize, boxmin[0], boxmax[0], boxmin[1],
+                              boxmax[1]),
+        r_fp(cellsize, boxmin[0], boxmax[0], boxmin[1], boxmax[1]);
     r_min.prefill_arrays(RasterTools::MIN);
     r_fp.prefill_arrays(RasterTools::MAX);
-    r_grp.prefill_arrays(RasterTools::ZERO);
-    r_ground_points.prefill_arrays(RasterTools::ZERO);
-    r_non_ground_points.prefill_arrays(RasterTools::ZERO);
 
     std::vector<std::vector<float>> buckets(r_max.dimx_ * r_max.dimy_);
 
     if (use_footprint) {
       auto fp_grid = GridPIPTester(footprint);
 
-      for (size_t col = 0; col < r_fp.dimx_; ++col) {
-        for (size_t row = 0; row < r_fp.dimy_; ++row) {
+      for (size_t row = 0; row < r_fp.dimy_; ++row) {
+        for (size_t col = 0; col < r_fp.dimx_; ++col) {
           auto p = r_fp.getPointFromRasterCoords(col, row);
           if (fp_grid.test(p)) {
-            r_fp.add_point(p[0], p[1], 1, RasterTools::MAX);
+            r_fp.add_cell_value(col, row, 1, RasterTools::MAX);
           } else {
-            r_fp.add_point(p[0], p[1], 0, RasterTools::MAX);
+            r_fp.add_cell_value(col, row, 0, RasterTools::MAX);
           }
         }
       }
@@ -83,9 +83,9 @@ namespace roofer::misc {
       auto& c = (*classification)[pi];
       if (r_max.check_point(p[0], p[1])) {
         if (c == ground_class) {
-          r_ground_points.add_value(p[0], p[1], 1);
+          r_max.add_count(p[0], p[1], GROUND_CNT);
         } else if (c == building_class) {
-          r_non_ground_points.add_value(p[0], p[1], 1);
+          r_max.add_count(p[0], p[1], NON_GROUND_CNT);
         }
 
         r_max.add_point(p[0], p[1], p[2], RasterTools::MAX);
@@ -94,70 +94,58 @@ namespace roofer::misc {
       }
     }
 
-    // PointCollection grid_points;
-    // vec1f values;
-    // double nodata = r_max.getNoDataVal();
-    image_bundle["max"] = Image{};
-    image_bundle["max"].dim_x = r_max.dimx_;
-    image_bundle["max"].dim_y = r_max.dimy_;
-    image_bundle["max"].min_x = r_max.minx_;
-    image_bundle["max"].min_y = r_max.miny_;
-    image_bundle["max"].cellsize = r_max.cellSize_;
-    image_bundle["max"].nodataval = r_max.noDataVal_;
-    image_bundle["max"].array = *r_max.vals_;
-
-    image_bundle["min"] = image_bundle["max"];
-    image_bundle["min"].nodataval = r_min.noDataVal_;
-    image_bundle["min"].array = *r_min.vals_;
-    image_bundle["fp"] = image_bundle["max"];
-    image_bundle["fp"].array = *r_fp.vals_;
-    image_bundle["cnt"] = image_bundle["max"],
-    image_bundle["med"] = image_bundle["max"],
-    image_bundle["avg"] = image_bundle["max"],
-    image_bundle["var"] = image_bundle["max"],
-    image_bundle["grp"] = image_bundle["max"];
-    image_bundle["gp"] = image_bundle["max"];
-    image_bundle["gp"].nodataval = r_ground_points.noDataVal_;
-    image_bundle["gp"].array = *r_ground_points.vals_;
-    image_bundle["ngp"] = image_bundle["max"];
-    image_bundle["ngp"].nodataval = r_non_ground_points.noDataVal_;
-    image_bundle["ngp"].array = *r_non_ground_points.vals_;
+    // the derived images share the geometry of the max raster, but are
+    // allocated fresh instead of copied from it
+    const size_t n_cells = r_max.dimx_ * r_max.dimy_;
+    const float nodata = r_max.noDataVal_;
+    Image derived_image{.dim_x = r_max.dimx_,
+                        .dim_y = r_max.dimy_,
+                        .min_x = float(r_max.minx_),
+                        .min_y = float(r_max.miny_),
+                        .cellsize = float(r_max.cellSize_),
+                        .nodataval = nodata};
+    for (auto name : {"cnt", "med", "avg", "var", "grp"}) {
+      image_bundle[name] = derived_image;
+      image_bundle[name].array.resize(n_cells);
+    }
+    auto& cnt = image_bundle["cnt"].array;
+    auto& med = image_bundle["med"].array;
+    auto& avg = image_bundle["avg"].array;
+    auto& var = image_bundle["var"].array;
+    auto& grp = image_bundle["grp"].array;
+    const auto* gp = r_max.count_band(GROUND_CNT);
+    const auto* ngp = r_max.count_band(NON_GROUND_CNT);
 
     for (size_t row = 0; row < r_max.dimy_; ++row) {
       for (size_t col = 0; col < r_max.dimx_; ++col) {
-        // auto p = r_max.getPointFromRasterCoords(col,row);
-        // if (p[2]!=nodata) {
-        // grid_points.push_back(p);
-        // values.push_back(p[2]);
-        // }
         auto lc = r_max.getLinearCoord(row, col);
         auto& buck = buckets.at(lc);
         if (buck.size() == 0) {
-          image_bundle["cnt"].array[lc] = image_bundle["cnt"].nodataval;
-          image_bundle["med"].array[lc] = image_bundle["med"].nodataval;
-          image_bundle["avg"].array[lc] = image_bundle["avg"].nodataval;
-          image_bundle["var"].array[lc] = image_bundle["var"].nodataval;
-          image_bundle["grp"].array[lc] = image_bundle["grp"].nodataval;
+          cnt[lc] = nodata;
+          med[lc] = nodata;
+          avg[lc] = nodata;
+          var[lc] = nodata;
+          grp[lc] = nodata;
         } else {
           std::sort(buck.begin(), buck.end());
-          image_bundle["cnt"].array[lc] = buck.size();
-          image_bundle["med"].array[lc] = buck[buck.size() / 2];
-          image_bundle["avg"].array[lc] =
-              std::accumulate(buck.begin(), buck.end(), 0) / buck.size();
-          image_bundle["grp"].array[lc] =
-              abs(image_bundle["gp"].array[lc] -
-                  image_bundle["ngp"].array[lc]) /
-              (image_bundle["gp"].array[lc] + image_bundle["ngp"].array[lc]);
+          cnt[lc] = buck.size();
+          med[lc] = buck[buck.size() / 2];
+          avg[lc] = std::accumulate(buck.begin(), buck.end(), 0) / buck.size();
+          grp[lc] = abs(float(gp[lc]) - float(ngp[lc])) /
+                    (float(gp[lc]) + float(ngp[lc]));
           int ssum = 0;
           for (auto& z : buck) {
-            ssum += std::pow(z - image_bundle["avg"].array[lc], 2);
+            ssum += std::pow(z - avg[lc], 2);
           }
-          image_bundle["var"].array[lc] = ssum / buck.size();
+          var[lc] = ssum / buck.size();
         }
       }
     }
-    image_bundle.erase("gp");
-    image_bundle.erase("ngp");
+
+    // move the value buffers into the bundle, no copies needed
+    image_bundle["max"] = std::move(r_max).to_image();
+    image_bundle["min"] = std::move(r_min).to_image();
+    image_bundle["fp"] = std::move(r_fp).to_image();
   }
 
   size_t getLinearCoord(const Image& im, double x, double y) {
@@ -171,8 +159,9 @@ namespace roofer::misc {
     const auto max_cnt_per_cell =
         max_density * (cnt_image.cellsize * cnt_image.cellsize);
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    // fixed seed, so that the same pointcloud is always thinned the same way
+    // and reruns give the same output
+    std::mt19937 gen(5489u);
     std::uniform_real_distribution<> dis(0.0, 1.0);
 
     PointCollection thinned_points;
@@ -29,6 +29,7 @@ namespace roofer::misc {
   class Val3dator : public Val3datorInterface {
     void compute(const std::unordered_map<int, Mesh>& meshmap,
                  Val3datorConfig cfg) override {
+      reset();
       for (auto& [sid, mesh] : meshmap) {
         // create a vertex list and vertex IDs, taking care of duplicates
         std::map<arr3f, size_t> vertex_map;
@@ -41,6 +41,21 @@ namespace roofer::misc {
 
       return result;
     };
+    void coord_transform_fwd(const double* x, const double* y,
+                             const double* z, size_t n,
+                             arr3f* out) override {
+      if (n == 0) return;
+      if (!data_offset.has_value()) {
+        data_offset = {x[0], y[0], z[0]};
+      }
+      const double ox = (*data_offset)[0];
+      const double oy = (*data_offset)[1];
+      const double oz = (*data_offset)[2];
+      // no branches or calls in the loop, so that it is vectorised
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = {float(x[i] - ox), float(y[i] - oy), float(z[i] - oz)};
+      }
+    }
     arr3d coord_transform_rev(const float& x, const float& y,
                               const float& z) override {
       if (data_offset.has_value()) {
@@ -0,0 +1,238 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <roofer/common/CityJsonBinary.hpp>
+#include <roofer/io/CityJsonBinaryWriter.hpp>
+#include <sstream>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace fs = std::filesystem;
+using namespace roofer::cjb;
+
+namespace {
+
+  roofer::LinearRing square(float z) {
+    roofer::LinearRing ring;
+    ring.push_back({0, 0, z});
+    ring.push_back({10, 0, z});
+    ring.push_back({10, 10, z});
+    ring.push_back({0, 10, z});
+    return ring;
+  }
+
+  // A box shaped building with one roof surface that has attributes
+  std::unordered_map<int, roofer::Mesh> box_solid() {
+    roofer::Mesh mesh;
+    auto floor = square(0);
+    auto roof = square(5);
+    roofer::LinearRing wall;
+    wall.push_back({0, 0, 0});
+    wall.push_back({10, 0, 0});
+    wall.push_back({10, 0, 5});
+    wall.push_back({0, 0, 5});
+    mesh.push_polygon(floor, 0);
+    mesh.push_polygon(roof, 1);
+    mesh.push_polygon(wall, 2);
+    mesh.get_attributes().resize(3);
+    mesh.get_attributes()[1].insert("b3_h_dak_max", 5.f);
+    return {{0, mesh}};
+  }
+
+  // Writes a file with the given features, returns its contents
+  std::string write_file(const fs::path& path,
+                         const std::vector<std::string>& ids) {
+    auto pj = roofer::misc::createProjHelper();
+    auto writer = roofer::io::createCityJsonBinaryWriter(*pj);
+    writer->identifier_attribute = "identificatie";
+    writer->translate_x_ = 100;
+
+    std::ostringstream out;
+    writer->write_header(out, R"({"title":"test"})");
+    auto footprint = square(0);
+    auto solid = box_solid();
+    std::string record;
+    for (auto& id : ids) {
+      roofer::AttributeMapRow attributes;
+      attributes.insert("identificatie", id);
+      attributes.insert("b3_bouwlagen", 2);
+      attributes.insert("b3_kas_warenhuis", false);
+      attributes.set_null("b3_val3dity_lod22");
+      writer->encode_feature(record, footprint, nullptr, nullptr, &solid,
+                             attributes, 0);
+      out << record;
+    }
+    std::ofstream(path, std::ios::binary) << out.str();
+    return out.str();
+  }
+
+  void write_raw(const fs::path& path, const std::string& contents) {
+    std::ofstream(path, std::ios::binary) << contents;
+  }
+
+  // offset in the file of the FeatureHeader of the first feature
+  size_t first_feature(const std::string& contents) {
+    FileHeader header;
+    std::memcpy(&header, contents.data(), sizeof(FileHeader));
+    return sizeof(FileHeader) + ((header.metadata_size + 7) & ~size_t(7)) +
+           sizeof(uint64_t);
+  }
+
+  FeatureHeader read_feature_header(const std::string& contents) {
+    FeatureHeader header;
+    std::memcpy(&header, contents.data() + first_feature(contents),
+                sizeof(FeatureHeader));
+    return header;
+  }
+
+  std::string with_feature_header(std::string contents,
+                                  const FeatureHeader& header) {
+    std::memcpy(contents.data() + first_feature(contents), &header,
+                sizeof(FeatureHeader));
+    return contents;
+  }
+
+}  // namespace
+
+TEST_CASE("cjb-round-trip") {
+  auto path = fs::temp_directory_path() / "roofer-test-round-trip.city.cjb";
+  write_file(path, {"NL.1", "NL.2"});
+
+  auto reader = createReader();
+  reader->open(path.string());
+  CHECK(reader->metadata() == R"({"title":"test"})");
+  CHECK(reader->header().translate[0] == 100);
+  REQUIRE(reader->size() == 2);
+  CHECK(reader->feature(0).id() == "NL.1");
+  CHECK(reader->feature(1).id() == "NL.2");
+
+  auto feature = reader->feature(1);
+  auto objects = feature.objects();
+  REQUIRE(objects.size() == 2);
+  CHECK(feature.string(objects[0].id) == "NL.2");
+  CHECK(objects[0].type == ObjectType::Building);
+  CHECK(objects[0].parent == -1);
+  CHECK(feature.string(objects[1].id) == "NL.2-0");
+  CHECK(objects[1].type == ObjectType::BuildingPart);
+  CHECK(objects[1].parent == 0);
+
+  // the building attributes, sorted by key
+  auto attributes =
+      FeatureView::select(feature.attributes(), objects[0].attributes);
+  REQUIRE(attributes.size() == 4);
+  CHECK(feature.string(attributes[0].key) == "b3_bouwlagen");
+  CHECK(attributes[0].type == AttributeType::Int);
+  CHECK(attributes[0].int_value == 2);
+  CHECK(attributes[1].type == AttributeType::Bool);
+  CHECK(attributes[1].int_value == 0);
+  CHECK(attributes[2].type == AttributeType::Null);
+  CHECK(feature.string(attributes[3].key) == "identificatie");
+  CHECK(feature.string(attributes[3].string_value) == "NL.2");
+
+  // the LoD2.2 solid and its roof surface
+  auto geometries =
+      FeatureView::select(feature.geometries(), objects[1].geometries);
+  REQUIRE(geometries.size() == 1);
+  CHECK(geometries[0].type == GeometryType::Solid);
+  CHECK(feature.string(geometries[0].lod) == "2.2");
+  auto surfaces =
+      FeatureView::select(feature.surfaces(), geometries[0].surfaces);
+  auto semantics =
+      FeatureView::select(feature.semantics(), geometries[0].semantics);
+  REQUIRE(surfaces.size() == 3);
+  REQUIRE(surfaces[1].semantic >= 0);
+  auto& roof_semantic = semantics[surfaces[1].semantic];
+  CHECK(roof_semantic.type == SemanticType::RoofSurface);
+  auto roof_attributes =
+      FeatureView::select(feature.attributes(), roof_semantic.attributes);
+  REQUIRE(roof_attributes.size() == 1);
+  CHECK(roof_attributes[0].float_value == 5.);
+
+  // the roof ring resolves to the quantised input coordinates
+  auto rings = FeatureView::select(feature.rings(), surfaces[1].rings);
+  REQUIRE(rings.size() == 1);
+  auto indices = FeatureView::select(feature.indices(), rings[0]);
+  REQUIRE(indices.size() == 4);
+  auto roof = square(5);
+  auto& v = feature.vertices()[indices[2]];
+  auto& scale = reader->header().scale;
+  auto& translate = reader->header().translate;
+  for (int k = 0; k < 3; ++k) {
+    CHECK(std::abs(v[k] * scale[k] + translate[k] - roof[2][k]) <= scale[k]);
+  }
+
+  reader->close();
+  fs::remove(path);
+}
+
+TEST_CASE("cjb-truncated-file") {
+  auto path = fs::temp_directory_path() / "roofer-test-truncated.city.cjb";
+  auto contents = write_file(path, {"NL.1", "NL.2"});
+  write_raw(path, contents.substr(0, contents.size() - 8));
+
+  auto reader = createReader();
+  CHECK_THROWS(reader->open(path.string()));
+  fs::remove(path);
+}
+
+TEST_CASE("cjb-corrupt-feature") {
+  auto path = fs::temp_directory_path() / "roofer-test-corrupt.city.cjb";
+  auto contents = write_file(path, {"NL.1"});
+  auto header = read_feature_header(contents);
+  auto reader = createReader();
+
+  SECTION("column past the end of the record") {
+    auto corrupt = header;
+    corrupt.vertices.count += 1000;
+    write_raw(path, with_feature_header(contents, corrupt));
+    CHECK_THROWS(reader->open(path.string()));
+  }
+  SECTION("misaligned column") {
+    auto corrupt = header;
+    corrupt.objects.offset += 4;
+    write_raw(path, with_feature_header(contents, corrupt));
+    CHECK_THROWS(reader->open(path.string()));
+  }
+  SECTION("string past the end of the strings column") {
+    auto corrupt = header;
+    corrupt.id.size = corrupt.strings.count + 1;
+    write_raw(path, with_feature_header(contents, corrupt));
+    CHECK_THROWS(reader->open(path.string()));
+  }
+  SECTION("vertex index past the end of the vertices") {
+    auto corrupt = header;
+    corrupt.vertices.count = 0;
+    write_raw(path, with_feature_header(contents, corrupt));
+    CHECK_THROWS(reader->open(path.string()));
+  }
+  SECTION("unchanged") {
+    write_raw(path, with_feature_header(contents, header));
+    CHECK_NOTHROW(reader->open(path.string()));
+    CHECK(reader->size() == 1);
+  }
+  reader->close();
+  fs::remove(path);
+}
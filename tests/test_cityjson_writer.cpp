@@ -0,0 +1,475 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <roofer/roofer.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <roofer/io/CityJsonWriter.hpp>
+#include <roofer/io/PointCloudReader.hpp>
+#include <roofer/io/VectorReader.hpp>
+#include <set>
+#include <sstream>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+  using MeshMap = std::unordered_map<int, roofer::Mesh>;
+
+  /**
+   * @brief The CityJSONFeature writer as it was before it was changed to
+   * stream into a buffer
+   *
+   * It builds an nlohmann::json DOM per feature and writes its dump(). The
+   * streaming writer must give the same bytes.
+   */
+  class DomCityJsonWriter {
+    roofer::misc::projHelperInterface& pjHelper;
+    size_t written_features_count = 0;
+
+   public:
+    std::string identifier_attribute;
+    double translate_x_ = 0., translate_y_ = 0., translate_z_ = 0.;
+    double scale_x_ = 0.01, scale_y_ = 0.01, scale_z_ = 0.01;
+
+    DomCityJsonWriter(roofer::misc::projHelperInterface& pjh) : pjHelper(pjh) {}
+
+   private:
+    template <typename T>
+    void add_vertices_ring(std::map<roofer::arr3d, size_t>& vertex_map,
+                           std::vector<roofer::arr3d>& vertex_vec,
+                           std::set<roofer::arr3d>& vertex_set, const T& ring,
+                           roofer::TBox<double>& bbox) {
+      size_t v_cntr = vertex_vec.size();
+      for (auto& vertex_ : ring) {
+        auto vertex = pjHelper.coord_transform_rev(vertex_);
+        bbox.add(vertex);
+        auto [it, did_insert] = vertex_set.insert(vertex);
+        if (did_insert) {
+          vertex_map[vertex] = v_cntr++;
+          vertex_vec.push_back(vertex);
+        }
+      }
+    }
+
+    roofer::TBox<double> add_vertices_polygon(
+        std::map<roofer::arr3d, size_t>& vertex_map,
+        std::vector<roofer::arr3d>& vertex_vec,
+        std::set<roofer::arr3d>& vertex_set,
+        const roofer::LinearRing& polygon) {
+      roofer::TBox<double> bbox;
+      add_vertices_ring(vertex_map, vertex_vec, vertex_set, polygon, bbox);
+      for (auto& iring : polygon.interior_rings()) {
+        add_vertices_ring(vertex_map, vertex_vec, vertex_set, iring, bbox);
+      }
+      return bbox;
+    }
+
+    roofer::TBox<double> add_vertices_mesh(
+        std::map<roofer::arr3d, size_t>& vertex_map,
+        std::vector<roofer::arr3d>& vertex_vec,
+        std::set<roofer::arr3d>& vertex_set, const roofer::Mesh& mesh) {
+      roofer::TBox<double> bbox;
+      for (auto& face : mesh.get_polygons()) {
+        bbox.add(
+            add_vertices_polygon(vertex_map, vertex_vec, vertex_set, face));
+      }
+      return bbox;
+    }
+
+    std::vector<std::vector<size_t>> LinearRing2jboundary(
+        std::map<roofer::arr3d, size_t>& vertex_map,
+        const roofer::LinearRing& face) {
+      std::vector<std::vector<size_t>> jface;
+      std::vector<size_t> exterior_ring;
+      for (auto& vertex_ : face) {
+        auto vertex = pjHelper.coord_transform_rev(vertex_);
+        exterior_ring.push_back(vertex_map[vertex]);
+      }
+      jface.emplace_back(std::move(exterior_ring));
+      for (auto& iring : face.interior_rings()) {
+        std::vector<size_t> interior_ring;
+        for (auto& vertex_ : iring) {
+          auto vertex = pjHelper.coord_transform_rev(vertex_);
+          interior_ring.push_back(vertex_map[vertex]);
+        }
+        jface.emplace_back(std::move(interior_ring));
+      }
+      return jface;
+    }
+
+    nlohmann::json::object_t mesh2jSolid(
+        const roofer::Mesh& mesh, const char* lod,
+        std::map<roofer::arr3d, size_t>& vertex_map) {
+      auto geometry = nlohmann::json::object();
+      geometry["type"] = "Solid";
+      geometry["lod"] = lod;
+      std::vector<std::vector<std::vector<size_t>>> exterior_shell;
+
+      for (auto& face : mesh.get_polygons()) {
+        exterior_shell.emplace_back(LinearRing2jboundary(vertex_map, face));
+      }
+      geometry["boundaries"] = {exterior_shell};
+
+      auto semantic_objects = nlohmann::json::array();
+      semantic_objects.push_back(
+          nlohmann::json::object({{"type", "GroundSurface"}}));
+      semantic_objects.push_back(nlohmann::json::object(
+          {{"type", "WallSurface"}, {"on_footprint_edge", true}}));
+      semantic_objects.push_back(nlohmann::json::object(
+          {{"type", "WallSurface"}, {"on_footprint_edge", false}}));
+
+      std::vector<int> sem_values;
+      size_t wallSurface_cntr = semantic_objects.size();
+      for (size_t i = 0; i < mesh.get_polygons().size(); ++i) {
+        auto& label = mesh.get_labels()[i];
+        if (label == 0) {
+          sem_values.push_back(0);
+        } else if (label == 1) {
+          nlohmann::json::object_t semantic_object;
+          if (mesh.get_attributes().size()) {
+            semantic_object = attributes2json(mesh.get_attributes().at(i));
+          }
+          semantic_object["type"] = "RoofSurface";
+          semantic_objects.push_back(semantic_object);
+          sem_values.push_back(wallSurface_cntr++);
+        } else if (label == 2) {
+          sem_values.push_back(1);
+        } else if (label == 3) {
+          sem_values.push_back(2);
+        } else {
+          throw roofer::rooferException("Unknown label in mesh");
+        }
+      }
+      geometry["semantics"] = {{"surfaces", semantic_objects},
+                               {"values", {sem_values}}};
+      return geometry;
+    }
+
+    nlohmann::json::array_t compute_geographical_extent(
+        const roofer::TBox<double>& bbox) {
+      auto minp = bbox.min();
+      auto maxp = bbox.max();
+      return {minp[0], minp[1], minp[2], maxp[0], maxp[1], maxp[2]};
+    }
+
+    nlohmann::json::object_t attributes2json(
+        const roofer::AttributeMapRow& attributes) {
+      nlohmann::json::object_t jattributes;
+      nlohmann::json j_null;
+      for (const auto& [name, val] : attributes) {
+        if (attributes.is_null(name)) {
+          jattributes[name] = j_null;
+        } else if (auto val = attributes.get_if<bool>(name)) {
+          jattributes[name] = *val;
+        } else if (auto val = attributes.get_if<float>(name)) {
+          jattributes[name] = *val;
+        } else if (auto val = attributes.get_if<int>(name)) {
+          jattributes[name] = *val;
+        } else if (auto val = attributes.get_if<std::string>(name)) {
+          jattributes[name] = *val;
+        } else if (auto val = attributes.get_if<roofer::Date>(name)) {
+          auto t = *val;
+          jattributes[name] = t.format_to_ietf();
+        } else if (auto val = attributes.get_if<roofer::Time>(name)) {
+          auto t = *val;
+          jattributes[name] = std::to_string(t.hour) + ":" +
+                              std::to_string(t.minute) + ":" +
+                              std::to_string(t.second) + "Z";
+        } else if (auto val = attributes.get_if<roofer::DateTime>(name)) {
+          auto t = *val;
+          jattributes[name] = t.format_to_ietf();
+        }
+      }
+      return jattributes;
+    }
+
+    void write_cityobject(const roofer::LinearRing& footprint,
+                          const MeshMap* multisolid_lod12,
+                          const MeshMap* multisolid_lod13,
+                          const MeshMap* multisolid_lod22,
+                          const roofer::AttributeMapRow& attributes,
+                          nlohmann::json& outputJSON,
+                          std::vector<roofer::arr3d>& vertex_vec,
+                          std::string building_id) {
+      std::map<roofer::arr3d, size_t> vertex_map;
+      std::set<roofer::arr3d> vertex_set;
+
+      bool export_lod12 = multisolid_lod12;
+      bool export_lod13 = multisolid_lod13;
+      bool export_lod22 = multisolid_lod22;
+
+      auto building = nlohmann::json::object();
+      auto b_id = building_id;
+      building["type"] = "Building";
+      building["attributes"] = attributes2json(attributes);
+      for (const auto& [name, val] : attributes) {
+        if (name == identifier_attribute) {
+          if (auto val = attributes.get_if<float>(name)) {
+            b_id = std::to_string(*val);
+          } else if (auto val = attributes.get_if<int>(name)) {
+            b_id = std::to_string(*val);
+          } else if (auto val = attributes.get_if<std::string>(name)) {
+            b_id = *val;
+          }
+        }
+      }
+
+      auto fp_geometry = nlohmann::json::object();
+      fp_geometry["lod"] = "0";
+      fp_geometry["type"] = "MultiSurface";
+      add_vertices_polygon(vertex_map, vertex_vec, vertex_set, footprint);
+      fp_geometry["boundaries"] = {LinearRing2jboundary(vertex_map, footprint)};
+      building["geometry"].push_back(fp_geometry);
+
+      std::vector<std::string> buildingPartIds;
+
+      bool has_solids = false;
+      if (export_lod12) has_solids = multisolid_lod12->size();
+      if (export_lod13) has_solids = multisolid_lod13->size();
+      if (export_lod22) has_solids = multisolid_lod22->size();
+
+      roofer::TBox<double> building_bbox;
+      if (has_solids) {
+        const MeshMap* meshmap;
+        if (export_lod22) {
+          meshmap = multisolid_lod22;
+        } else if (export_lod13) {
+          meshmap = multisolid_lod13;
+        } else {
+          meshmap = multisolid_lod12;
+        }
+        for (const auto& [sid, solid_lodx] : *meshmap) {
+          auto buildingPart = nlohmann::json::object();
+          auto bp_id = b_id + "-" + std::to_string(sid);
+
+          buildingPartIds.push_back(bp_id);
+          buildingPart["type"] = "BuildingPart";
+          buildingPart["parents"] = {b_id};
+
+          if (export_lod12) {
+            try {
+              building_bbox =
+                  add_vertices_mesh(vertex_map, vertex_vec, vertex_set,
+                                    multisolid_lod12->at(sid));
+              buildingPart["geometry"].push_back(
+                  mesh2jSolid(multisolid_lod12->at(sid), "1.2", vertex_map));
+            } catch (const std::exception& e) {
+            }
+          }
+          if (export_lod13) {
+            try {
+              building_bbox =
+                  add_vertices_mesh(vertex_map, vertex_vec, vertex_set,
+                                    multisolid_lod13->at(sid));
+              buildingPart["geometry"].push_back(
+                  mesh2jSolid(multisolid_lod13->at(sid), "1.3", vertex_map));
+            } catch (const std::exception& e) {
+            }
+          }
+          if (export_lod22) {
+            building_bbox = add_vertices_mesh(vertex_map, vertex_vec,
+                                              vertex_set,
+                                              multisolid_lod22->at(sid));
+            buildingPart["geometry"].push_back(
+                mesh2jSolid(multisolid_lod22->at(sid), "2.2", vertex_map));
+          }
+          outputJSON["CityObjects"][bp_id] = buildingPart;
+        }
+      }
+
+      building["children"] = buildingPartIds;
+      building["geographicalExtent"] =
+          compute_geographical_extent(building_bbox);
+      outputJSON["CityObjects"][b_id] = building;
+    }
+
+   public:
+    void write_feature(std::ostream& output_stream,
+                       const roofer::LinearRing& footprint,
+                       const MeshMap* multisolid_lod12,
+                       const MeshMap* multisolid_lod13,
+                       const MeshMap* multisolid_lod22,
+                       const roofer::AttributeMapRow attributes) {
+      nlohmann::json outputJSON;
+      outputJSON["type"] = "CityJSONFeature";
+      outputJSON["CityObjects"] = nlohmann::json::object();
+
+      std::vector<roofer::arr3d> vertex_vec;
+      write_cityobject(footprint, multisolid_lod12, multisolid_lod13,
+                       multisolid_lod22, attributes, outputJSON, vertex_vec,
+                       std::to_string(++written_features_count));
+
+      for (auto& el : outputJSON["CityObjects"].items()) {
+        if (!el.value().contains(std::string("parents"))) {
+          outputJSON["id"] = el.key();
+        }
+      };
+
+      std::vector<std::array<int, 3>> vertices_int;
+      for (auto& vertex : vertex_vec) {
+        vertices_int.push_back({int((vertex[0] - translate_x_) / scale_x_),
+                                int((vertex[1] - translate_y_) / scale_y_),
+                                int((vertex[2] - translate_z_) / scale_z_)});
+      }
+      outputJSON["vertices"] = vertices_int;
+      output_stream << outputJSON << std::endl;
+    }
+  };
+
+  struct Building {
+    std::string id;
+    roofer::LinearRing footprint;
+    MeshMap lod12, lod13, lod22;
+    roofer::AttributeMapRow attributes;
+  };
+
+  MeshMap to_map(std::vector<roofer::Mesh>&& meshes) {
+    MeshMap map;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      map[int(i)] = std::move(meshes[i]);
+    }
+    return map;
+  }
+
+  // Gives each roof surface float attributes with all the digits of the
+  // reconstructed vertex heights
+  void add_roof_attributes(MeshMap& meshes) {
+    for (auto& [sid, mesh] : meshes) {
+      auto& polygons = mesh.get_polygons();
+      mesh.get_attributes().resize(polygons.size());
+      for (size_t i = 0; i < polygons.size(); ++i) {
+        if (mesh.get_labels()[i] != 1) continue;
+        float zmin = polygons[i][0][2], zmax = zmin, zsum = 0;
+        for (auto& p : polygons[i]) {
+          zmin = std::min(zmin, p[2]);
+          zmax = std::max(zmax, p[2]);
+          zsum += p[2];
+        }
+        auto& attributes = mesh.get_attributes()[i];
+        attributes.insert("b3_h_dak_min", zmin);
+        attributes.insert("b3_h_dak_max", zmax);
+        attributes.insert("b3_h_dak_mean", zsum / polygons[i].size());
+      }
+    }
+  }
+
+  // Reconstructs the wippolder test objects
+  std::vector<Building> wippolder_buildings(
+      roofer::misc::projHelperInterface& pj) {
+    std::vector<Building> buildings;
+    for (auto& dir : fs::directory_iterator("data/wippolder/objects")) {
+      std::string id = dir.path().filename().string();
+      auto crop = dir.path() / "crop";
+      if (!fs::exists(crop / (id + ".gpkg")) ||
+          !fs::exists(crop / (id + "_pointcloud.las"))) {
+        continue;
+      }
+      auto vector_reader = roofer::io::createVectorReaderOGR(pj);
+      vector_reader->open((crop / (id + ".gpkg")).string());
+      std::vector<roofer::LinearRing> footprints;
+      vector_reader->readPolygons(footprints);
+      if (footprints.empty()) continue;
+
+      auto point_reader = roofer::io::createPointCloudReaderLASlib(pj);
+      point_reader->open((crop / (id + "_pointcloud.las")).string());
+      roofer::PointCollection points, ground, roof;
+      roofer::vec1i classification;
+      point_reader->readPointCloud(points, &classification);
+      for (size_t i = 0; i < points.size(); ++i) {
+        if (classification[i] == 2) ground.push_back(points[i]);
+        if (classification[i] == 6) roof.push_back(points[i]);
+      }
+      if (ground.empty() || roof.empty()) continue;
+      float floor = std::min_element(ground.begin(), ground.end(),
+                                     [](auto& a, auto& b) {
+                                       return a[2] < b[2];
+                                     })
+                        ->at(2);
+
+      Building b;
+      b.id = id;
+      b.footprint = footprints.front();
+      roofer::ReconstructionConfig cfg{.floor_elevation = floor,
+                                       .override_with_floor_elevation = true};
+      b.lod22 = to_map(roofer::reconstruct(roof, ground, b.footprint, cfg));
+      cfg.lod = 13;
+      b.lod13 = to_map(roofer::reconstruct(roof, ground, b.footprint, cfg));
+      cfg.lod = 12;
+      b.lod12 = to_map(roofer::reconstruct(roof, ground, b.footprint, cfg));
+      add_roof_attributes(b.lod22);
+
+      b.attributes.insert("identificatie", "NL.IMBAG.Pand." + id);
+      b.attributes.insert("b3_h_maaiveld", floor);
+      b.attributes.insert("b3_rmse_lod22", float(roof.size()) / 7.f);
+      b.attributes.insert("b3_nodata_fractie_ahn3", 1.f / 3.f);
+      b.attributes.insert("b3_n_punten", int(roof.size()));
+      b.attributes.insert("b3_kas_warenhuis", false);
+      b.attributes.insert("oorspronkelijkbouwjaar", roofer::Date{1970, 1, 1});
+      b.attributes.set_null("b3_val3dity_lod22");
+      buildings.push_back(std::move(b));
+    }
+    return buildings;
+  }
+
+}  // namespace
+
+TEST_CASE("cityjson-writer-matches-dom") {
+  auto pj = roofer::misc::createProjHelper();
+  auto buildings = wippolder_buildings(*pj);
+  REQUIRE(buildings.size() > 0);
+
+  auto writer = roofer::io::createCityJsonWriter(*pj);
+  DomCityJsonWriter dom_writer(*pj);
+
+  SECTION("all LoDs, identifier from the attributes") {
+    writer->identifier_attribute = "identificatie";
+    dom_writer.identifier_attribute = "identificatie";
+    for (auto& b : buildings) {
+      std::ostringstream streamed, dom;
+      writer->write_feature(streamed, b.footprint, &b.lod12, &b.lod13,
+                            &b.lod22, b.attributes);
+      dom_writer.write_feature(dom, b.footprint, &b.lod12, &b.lod13, &b.lod22,
+                               b.attributes);
+      INFO(b.id);
+      CHECK(streamed.str() == dom.str());
+    }
+  }
+  SECTION("LoD2.2 only, counted ids, translated vertices") {
+    writer->translate_x_ = dom_writer.translate_x_ = 85000;
+    writer->translate_y_ = dom_writer.translate_y_ = 446000;
+    writer->scale_z_ = dom_writer.scale_z_ = 0.001;
+    for (auto& b : buildings) {
+      std::ostringstream streamed, dom;
+      writer->write_feature(streamed, b.footprint, nullptr, nullptr, &b.lod22,
+                            b.attributes);
+      dom_writer.write_feature(dom, b.footprint, nullptr, nullptr, &b.lod22,
+                               b.attributes);
+      INFO(b.id);
+      CHECK(streamed.str() == dom.str());
+    }
+  }
+}
@@ -0,0 +1,297 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <roofer/logger/logger.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <roofer/io/PointCloudReader.hpp>
+#include <roofer/io/PointCloudWriter.hpp>
+#include <roofer/io/SpatialReferenceSystem.hpp>
+#include <roofer/io/StreamCropper.hpp>
+#include <roofer/io/VectorReader.hpp>
+#include <roofer/misc/Vector2DOps.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+  struct CropResult {
+    // holds the data offset of the cropped points
+    std::unique_ptr<roofer::misc::projHelperInterface> pj;
+    std::vector<roofer::PointCollection> point_clouds;
+    roofer::vec1f ground_elevations;
+    roofer::vec1i acquisition_years;
+    roofer::vec1b pointcloud_insufficient;
+  };
+
+  // Crops the wippolder pointcloud with the wippolder footprints, the same
+  // way as the roofer app does
+  CropResult crop_wippolder(roofer::io::PointCloudCropperConfig cfg) {
+    CropResult result;
+    result.pj = roofer::misc::createProjHelper();
+    auto& pj = result.pj;
+    auto vector_reader = roofer::io::createVectorReaderOGR(*pj);
+    auto vector_ops = roofer::misc::createVector2DOpsGEOS();
+    auto cropper = roofer::io::createPointCloudCropper(*pj);
+
+    std::vector<roofer::LinearRing> footprints;
+    vector_reader->open("data/wippolder/wippolder.gpkg");
+    vector_reader->readPolygons(footprints);
+    vector_ops->simplify_polygons(footprints);
+    auto buffered_footprints = footprints;
+    vector_ops->buffer_polygons(buffered_footprints);
+
+    roofer::Box polygon_extent;
+    for (auto& buf_ring : buffered_footprints) {
+      polygon_extent.add(buf_ring.box());
+    }
+
+    cropper->process({"data/wippolder/wippolder.las"}, footprints,
+                     buffered_footprints, result.point_clouds,
+                     result.ground_elevations, result.acquisition_years,
+                     result.pointcloud_insufficient, polygon_extent, cfg);
+    return result;
+  }
+
+  roofer::LinearRing rectangle(float x0, float y0, float x1, float y1) {
+    roofer::LinearRing ring;
+    ring.push_back({x0, y0, 0});
+    ring.push_back({x1, y0, 0});
+    ring.push_back({x1, y1, 0});
+    ring.push_back({x0, y1, 0});
+    return ring;
+  }
+
+  /*
+   * Two footprints of 10 by 10 m that overlap in a strip 2 m wide, with a
+   * 1 m buffer:
+   *
+   *   A = [0, 10] x [0, 10], roof at 10 m
+   *   B = [8, 18] x [0, 10], roof at 5 m
+   *
+   * Building points on a 0.5 m grid over both footprints, 320 in A only, 80
+   * in the overlap and 320 in B only. A row of 40 ground points at y = -0.5
+   * in the buffers, with elevations 0.00, 0.01, ... from west to east. The
+   * coordinates are whole centimeters, the precision of the LAS writer, and
+   * no point is on a footprint boundary.
+   */
+  struct SyntheticScene {
+    std::vector<roofer::LinearRing> footprints = {rectangle(0, 0, 10, 10),
+                                                  rectangle(8, 0, 18, 10)};
+    std::vector<roofer::LinearRing> buffered_footprints = {
+        rectangle(-1, -1, 11, 11), rectangle(7, -1, 19, 11)};
+    roofer::PointCollection points;
+
+    // with spacing, building points fill the footprints at that spacing and
+    // ground points the buffer row
+    explicit SyntheticScene(float spacing = 0.5f) {
+      auto& classification = points.attributes.insert_vec<int>("classification");
+      const int nx = int(std::lround(18 / spacing));
+      const int ny = int(std::lround(10 / spacing));
+      for (int i = 0; i < nx; ++i) {
+        float x = (i + 0.5f) * spacing;
+        for (int j = 0; j < ny; ++j) {
+          points.push_back({x, (j + 0.5f) * spacing, x < 10 ? 10.f : 5.f});
+          classification.push_back(6);
+        }
+      }
+      const int n_ground = int(std::lround(20 / spacing));
+      for (int k = 0; k < n_ground; ++k) {
+        points.push_back({-1 + (k + 0.5f) * spacing, -0.5f, 0.01f * k});
+        classification.push_back(2);
+      }
+    }
+
+    // Writes the points to a LAS or LAZ file, depending on the extension
+    void write(const std::filesystem::path& path) {
+      auto pj = roofer::misc::createProjHelper();
+      roofer::arr3d offset = {0, 0, 0};
+      pj->set_data_offset(offset);
+      auto srs = roofer::io::createSpatialReferenceSystemOGR();
+      roofer::io::createLASWriter(*pj)->write_pointcloud(points, srs.get(),
+                                                         path.string());
+    }
+
+    CropResult crop(const std::filesystem::path& path,
+                    roofer::io::PointCloudCropperConfig cfg) {
+      CropResult result;
+      result.pj = roofer::misc::createProjHelper();
+      roofer::arr3d offset = {0, 0, 0};
+      result.pj->set_data_offset(offset);
+      roofer::Box polygon_extent;
+      for (auto& ring : buffered_footprints) polygon_extent.add(ring.box());
+      roofer::io::createPointCloudCropper(*result.pj)
+          ->process({path.string()}, footprints, buffered_footprints,
+                    result.point_clouds, result.ground_elevations,
+                    result.acquisition_years, result.pointcloud_insufficient,
+                    polygon_extent, cfg);
+      return result;
+    }
+  };
+
+  // Number of points of a class in a point cloud
+  size_t count_class(const roofer::PointCollection& point_cloud, int cls) {
+    auto& classification =
+        *point_cloud.attributes.get_if<int>("classification");
+    return std::count(classification.begin(), classification.end(), cls);
+  }
+
+}  // namespace
+
+TEST_CASE("crop-synthetic-footprints") {
+  roofer::logger::Logger::get_logger().set_level(
+      roofer::logger::LogLevel::warning);
+  SyntheticScene scene;
+  auto path =
+      std::filesystem::temp_directory_path() / "roofer-test-synthetic.las";
+  scene.write(path);
+
+  // The ground elevation of a footprint is the 5th percentile of the 24
+  // ground points in its buffer, the second lowest
+  auto check_ground = [](const CropResult& result) {
+    REQUIRE(result.ground_elevations.size() == 2);
+    CHECK(std::fabs(result.ground_elevations[0] - 0.01f) < 1e-4f);
+    CHECK(std::fabs(result.ground_elevations[1] - 0.17f) < 1e-4f);
+    for (auto& point_cloud : result.point_clouds) {
+      CHECK(count_class(point_cloud, 2) == 24);
+    }
+    CHECK(result.pointcloud_insufficient == roofer::vec1b{false, false});
+  };
+
+  SECTION("overlap points in both footprints") {
+    auto result = scene.crop(path, {.handle_overlap_points = false});
+    REQUIRE(result.point_clouds.size() == 2);
+    CHECK(count_class(result.point_clouds[0], 6) == 400);
+    CHECK(count_class(result.point_clouds[1], 6) == 400);
+    check_ground(result);
+  }
+  SECTION("overlap points in the higher footprint") {
+    // the footprints have the same point density, so the overlap points go to
+    // the one with the higher roof
+    auto result = scene.crop(path, {.handle_overlap_points = true});
+    REQUIRE(result.point_clouds.size() == 2);
+    CHECK(count_class(result.point_clouds[0], 6) == 400);
+    CHECK(count_class(result.point_clouds[1], 6) == 320);
+    auto& b = result.point_clouds[1];
+    auto& classification = *b.attributes.get_if<int>("classification");
+    for (size_t i = 0; i < b.size(); ++i) {
+      if (classification[i] == 6) CHECK(b[i][2] == 5.f);
+    }
+    check_ground(result);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("crop-synthetic-decode-threads") {
+  roofer::logger::Logger::get_logger().set_level(
+      roofer::logger::LogLevel::warning);
+  // 450k points, LASzip writes chunks of 50k points
+  SyntheticScene scene(0.02f);
+  REQUIRE(scene.points.size() > 400000);
+  auto las_path =
+      std::filesystem::temp_directory_path() / "roofer-test-decode.las";
+  auto laz_path =
+      std::filesystem::temp_directory_path() / "roofer-test-decode.laz";
+  scene.write(las_path);
+  scene.write(laz_path);
+
+  // a range per chunk, so that four threads decode the chunks in parallel
+  auto expected = scene.crop(las_path, {.handle_overlap_points = true});
+  auto one = scene.crop(laz_path, {.handle_overlap_points = true,
+                                   .decode_threads = 1,
+                                   .decode_range_points = 1});
+  auto four = scene.crop(laz_path, {.handle_overlap_points = true,
+                                    .decode_threads = 4,
+                                    .decode_range_points = 1});
+
+  // The points are cropped in file order regardless of the number of threads
+  for (auto* result : {&one, &four}) {
+    REQUIRE(result->point_clouds.size() == expected.point_clouds.size());
+    for (size_t i = 0; i < expected.point_clouds.size(); ++i) {
+      CHECK(static_cast<std::vector<roofer::arr3f>&>(
+                result->point_clouds[i]) ==
+            static_cast<std::vector<roofer::arr3f>&>(
+                expected.point_clouds[i]));
+    }
+    CHECK(result->ground_elevations == expected.ground_elevations);
+    CHECK(result->acquisition_years == expected.acquisition_years);
+  }
+  std::filesystem::remove(las_path);
+  std::filesystem::remove(laz_path);
+}
+
+TEST_CASE("crop-wippolder-tile-pack") {
+  roofer::logger::Logger::get_logger().set_level(
+      roofer::logger::LogLevel::warning);
+  auto result = crop_wippolder({});
+
+  // Pack the buildings one after the other, like the tiled crop output does
+  roofer::PointCollection pack;
+  auto& pack_classification = pack.attributes.insert_vec<int>("classification");
+  std::vector<size_t> first, count;
+  for (auto& point_cloud : result.point_clouds) {
+    auto& classification =
+        *point_cloud.attributes.get_if<int>("classification");
+    first.push_back(pack.size());
+    count.push_back(point_cloud.size());
+    pack.insert(pack.end(), point_cloud.begin(), point_cloud.end());
+    pack_classification.insert(pack_classification.end(),
+                               classification.begin(), classification.end());
+  }
+  // the building with the most points, somewhere in the middle of the pack
+  size_t b = std::max_element(count.begin(), count.end()) - count.begin();
+  REQUIRE(count[b] > 0);
+
+  // uncompressed LAS is read from a memory mapping, LAZ by seeking
+  for (std::string extension : {".las", ".laz"}) {
+    auto path = std::filesystem::temp_directory_path() /
+                ("roofer-test-tile-pack" + extension);
+    auto srs = roofer::io::createSpatialReferenceSystemOGR();
+    roofer::io::createLASWriter(*result.pj)
+        ->write_pointcloud(pack, srs.get(), path.string());
+
+    auto reader = roofer::io::createPointCloudReaderLASlib(*result.pj);
+    reader->open(path.string());
+    roofer::PointCollection points;
+    roofer::vec1i classification;
+    reader->readPointCloudSlice(first[b], count[b], points, &classification);
+
+    auto& expected = result.point_clouds[b];
+    auto& expected_classification =
+        *expected.attributes.get_if<int>("classification");
+    REQUIRE(points.size() == expected.size());
+    REQUIRE(classification.size() == expected.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+      for (int k = 0; k < 3; ++k) {
+        // the LAS writer stores coordinates in centimeters
+        CHECK(std::fabs(points[i][k] - expected[i][k]) <= 0.006f);
+      }
+      CHECK(classification[i] == expected_classification[i]);
+    }
+    CHECK_THROWS(
+        reader->readPointCloudSlice(pack.size() - 1, 2, points, nullptr));
+
+    reader->close();
+    std::filesystem::remove(path);
+  }
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+// Compares the crop of the wippolder test data with the values that were
+// recorded with the cropper from before the post-processing was rewritten
+// (commit df61143). This file only uses the cropper API of that commit, so
+// that the values can be recorded again with it: build the test at that
+// commit and run it with ROOFER_RECORD_CROP_BASELINE set, from the tests
+// directory. It then writes crop-baseline/wippolder.txt instead of comparing.
+
+#include <roofer/logger/logger.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <roofer/io/StreamCropper.hpp>
+#include <roofer/io/VectorReader.hpp>
+#include <roofer/misc/Vector2DOps.hpp>
+#include <sstream>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+  const char* baseline_path = "crop-baseline/wippolder.txt";
+
+  // The crop outputs of one footprint
+  struct FootprintCrop {
+    int handle_overlap_points;
+    size_t footprint;
+    float ground_elevation;
+    size_t building_points;
+    size_t ground_points;
+    int acquisition_year;
+    int pointcloud_insufficient;
+
+    bool operator==(const FootprintCrop&) const = default;
+  };
+
+  std::ostream& operator<<(std::ostream& os, const FootprintCrop& c) {
+    return os << c.handle_overlap_points << ' ' << c.footprint << ' '
+              << std::setprecision(9) << c.ground_elevation << ' '
+              << c.building_points << ' ' << c.ground_points << ' '
+              << c.acquisition_year << ' ' << c.pointcloud_insufficient;
+  }
+
+  // Crops the wippolder pointcloud with the wippolder footprints, the same
+  // way as the roofer app does
+  std::vector<FootprintCrop> crop_wippolder(bool handle_overlap_points) {
+    auto pj = roofer::misc::createProjHelper();
+    auto vector_reader = roofer::io::createVectorReaderOGR(*pj);
+    auto vector_ops = roofer::misc::createVector2DOpsGEOS();
+    auto cropper = roofer::io::createPointCloudCropper(*pj);
+
+    std::vector<roofer::LinearRing> footprints;
+    vector_reader->open("data/wippolder/wippolder.gpkg");
+    vector_reader->readPolygons(footprints);
+    vector_ops->simplify_polygons(footprints);
+    auto buffered_footprints = footprints;
+    vector_ops->buffer_polygons(buffered_footprints);
+
+    roofer::Box polygon_extent;
+    for (auto& buf_ring : buffered_footprints) {
+      polygon_extent.add(buf_ring.box());
+    }
+
+    std::vector<roofer::PointCollection> point_clouds;
+    roofer::vec1f ground_elevations;
+    roofer::vec1i acquisition_years;
+    roofer::vec1b pointcloud_insufficient;
+    roofer::io::PointCloudCropperConfig cfg;
+    cfg.handle_overlap_points = handle_overlap_points;
+    cropper->process({"data/wippolder/wippolder.las"}, footprints,
+                     buffered_footprints, point_clouds, ground_elevations,
+                     acquisition_years, pointcloud_insufficient,
+                     polygon_extent, cfg);
+
+    std::vector<FootprintCrop> crops;
+    for (size_t i = 0; i < footprints.size(); ++i) {
+      auto& classification =
+          *point_clouds[i].attributes.get_if<int>("classification");
+      crops.push_back(
+          {.handle_overlap_points = handle_overlap_points,
+           .footprint = i,
+           .ground_elevation = ground_elevations[i],
+           .building_points = size_t(
+               std::count(classification.begin(), classification.end(), 6)),
+           .ground_points = size_t(
+               std::count(classification.begin(), classification.end(), 2)),
+           .acquisition_year = acquisition_years[i],
+           .pointcloud_insufficient = pointcloud_insufficient[i]});
+    }
+    return crops;
+  }
+
+  std::vector<FootprintCrop> read_baseline() {
+    std::vector<FootprintCrop> crops;
+    std::ifstream ifs(baseline_path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      if (line.empty() || line.starts_with('#')) continue;
+      std::istringstream iss(line);
+      FootprintCrop c;
+      iss >> c.handle_overlap_points >> c.footprint >> c.ground_elevation >>
+          c.building_points >> c.ground_points >> c.acquisition_year >>
+          c.pointcloud_insufficient;
+      if (iss) crops.push_back(c);
+    }
+    return crops;
+  }
+
+}  // namespace
+
+TEST_CASE("crop-wippolder-baseline") {
+  roofer::logger::Logger::get_logger().set_level(
+      roofer::logger::LogLevel::warning);
+  auto crops = crop_wippolder(false);
+  auto overlap_crops = crop_wippolder(true);
+  crops.insert(crops.end(), overlap_crops.begin(), overlap_crops.end());
+  REQUIRE(crops.size() > 0);
+
+  if (std::getenv("ROOFER_RECORD_CROP_BASELINE")) {
+    std::ofstream ofs(baseline_path);
+    ofs << "# handle_overlap_points footprint ground_elevation "
+           "building_points ground_points acquisition_year "
+           "pointcloud_insufficient\n";
+    for (auto& c : crops) ofs << c << '\n';
+    REQUIRE(ofs);
+    return;
+  }
+
+  auto baseline = read_baseline();
+  INFO(baseline_path << " has no recorded values, see test_crop_baseline.cpp");
+  REQUIRE(baseline.size() == crops.size());
+  for (size_t i = 0; i < crops.size(); ++i) {
+    INFO("expected " << baseline[i]);
+    INFO("cropped  " << crops[i]);
+    CHECK(crops[i] == baseline[i]);
+  }
+}
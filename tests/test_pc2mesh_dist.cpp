@@ -0,0 +1,156 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <CGAL/AABB_traits_3.h>
+#include <CGAL/AABB_tree.h>
+#include <CGAL/AABB_triangle_primitive_3.h>
+#include <CGAL/Simple_cartesian.h>
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <roofer/misc/PC2MeshDistCalculator.hpp>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+  typedef CGAL::Simple_cartesian<double> SCK;
+
+  // A gable roof with a flat annex, split into small triangles with a bit of
+  // relief so that neighbouring triangles are not coplanar, and a wall.
+  struct RoofMesh {
+    roofer::MultiTriangleCollection mtc;
+    // the face id of every roof triangle, three times
+    roofer::vec1i face_ids;
+    // the roof triangles in the order of face_ids
+    std::vector<roofer::Triangle> roof;
+
+    static float z(int face, float x, float y) {
+      float relief = 0.05f * std::sin(1.3f * x + 0.7f * y);
+      if (face == 0) return 5 + 0.5f * y + relief;
+      if (face == 1) return 10 - 0.5f * y + relief;
+      return 3 + relief;
+    }
+
+    void add_face(roofer::TriangleCollection& tc,
+                  std::vector<roofer::AttributeValue>& labels, int face,
+                  float x0, float x1, float y0, float y1) {
+      const int n = 8;
+      float dx = (x1 - x0) / n, dy = (y1 - y0) / n;
+      auto v = [&](int i, int j) -> roofer::arr3f {
+        float x = x0 + i * dx, y = y0 + j * dy;
+        return {x, y, z(face, x, y)};
+      };
+      for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+          for (roofer::Triangle t :
+               {roofer::Triangle{v(i, j), v(i + 1, j), v(i + 1, j + 1)},
+                roofer::Triangle{v(i, j), v(i + 1, j + 1), v(i, j + 1)}}) {
+            tc.push_back(t);
+            labels.emplace_back(1);
+            roof.push_back(t);
+            face_ids.insert(face_ids.end(), 3, face);
+          }
+        }
+      }
+    }
+
+    RoofMesh() {
+      roofer::TriangleCollection tc;
+      std::vector<roofer::AttributeValue> labels;
+      add_face(tc, labels, 0, 0, 10, 0, 5);
+      // a wall between the roof faces, it is not used for the distances
+      tc.push_back({roofer::arr3f{0, 0, 0}, {10, 0, 0}, {10, 0, 5}});
+      labels.emplace_back(0);
+      add_face(tc, labels, 1, 0, 10, 5, 10);
+      add_face(tc, labels, 2, 10, 15, 0, 10);
+      roofer::AttributeMap attributes;
+      attributes["labels"] = labels;
+      mtc.push_back(tc);
+      mtc.push_back(attributes);
+    }
+  };
+
+  // Points above, below and next to the roof. Points above the ridge are
+  // equally close to both gable faces, which face gets them depends on the
+  // order in which the triangles are visited, so those are kept below it.
+  roofer::PointCollection sample_points() {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> x(-2, 17), y(-2, 12), dz(-1.5, 1.5);
+    roofer::PointCollection points;
+    for (int i = 0; i < 2000; ++i) {
+      float px = x(rng), py = y(rng), pdz = dz(rng);
+      int face = px > 10 ? 2 : (py < 5 ? 0 : 1);
+      if (face != 2 && std::abs(py - 5) < 2) pdz = -std::abs(pdz);
+      points.push_back({px, py, RoofMesh::z(face, px, py) + pdz});
+    }
+    return points;
+  }
+
+}  // namespace
+
+// PC2MeshDistCalculator used a CGAL AABB tree before it got its own BVH, the
+// errors must stay the same
+TEST_CASE("pc2mesh-distances-match-cgal") {
+  RoofMesh mesh;
+  auto points = sample_points();
+
+  auto calculator = roofer::misc::createPC2MeshDistCalculator();
+  calculator->compute(points, mesh.mtc, mesh.face_ids);
+  REQUIRE(calculator->point_errors.size() == points.size());
+  REQUIRE(calculator->face_errors.size() == mesh.face_ids.size());
+
+  // the errors as the AABB tree computed them
+  std::vector<SCK::Triangle_3> triangles;
+  for (auto& t : mesh.roof) {
+    triangles.emplace_back(SCK::Point_3(t[0][0], t[0][1], t[0][2]),
+                           SCK::Point_3(t[1][0], t[1][1], t[1][2]),
+                           SCK::Point_3(t[2][0], t[2][1], t[2][2]));
+  }
+  typedef std::vector<SCK::Triangle_3>::const_iterator Iterator;
+  typedef CGAL::AABB_triangle_primitive_3<SCK, Iterator> Primitive;
+  typedef CGAL::AABB_tree<CGAL::AABB_traits_3<SCK, Primitive>> Tree;
+  Tree tree(triangles.cbegin(), triangles.cend());
+  tree.accelerate_distance_queries();
+
+  std::map<int, std::pair<double, size_t>> face_sums;
+  double sum_total = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    SCK::Point_3 p(points[i][0], points[i][1], points[i][2]);
+    auto [closest, primitive] = tree.closest_point_and_primitive(p);
+    double sqd = CGAL::squared_distance(closest, p);
+    int face = mesh.face_ids[(primitive - triangles.cbegin()) * 3];
+    face_sums[face].first += sqd;
+    ++face_sums[face].second;
+    sum_total += sqd;
+    CHECK(std::abs(calculator->point_errors[i] - sqd) < 1e-4);
+  }
+  double rms_error = std::sqrt(sum_total / points.size());
+  CHECK(std::abs(calculator->rms_error - rms_error) < 1e-4);
+
+  for (size_t i = 0; i < mesh.face_ids.size(); ++i) {
+    auto& [sum, count] = face_sums[mesh.face_ids[i]];
+    double face_error = count ? std::sqrt(sum / count) : 0;
+    CHECK(std::abs(calculator->face_errors[i] - face_error) < 1e-4);
+  }
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2018-2024 TU Delft 3D geoinformation group, Ravi Peters (3DGI),
+// and Balazs Dukai (3DGI)
+
+// This file is part of roofer (https://github.com/3DBAG/roofer)
+
+// geoflow-roofer was created as part of the 3DBAG project by the TU Delft 3D
+// geoinformation group (3d.bk.tudelf.nl) and 3DGI (3dgi.nl)
+
+// geoflow-roofer is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version. geoflow-roofer is distributed in the hope that it will be
+// useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+// Public License for more details. You should have received a copy of the GNU
+// General Public License along with geoflow-roofer. If not, see
+// <https://www.gnu.org/licenses/>.
+
+// Author(s):
+// Ravi Peters
+
+#include <roofer/io/PointCloudReader.hpp>
+#include <roofer/misc/projHelper.hpp>
+#include <roofer/reconstruction/PlaneDetector.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+
+  // the roof points of one wippolder building
+  roofer::PointCollection building_points() {
+    auto pj = roofer::misc::createProjHelper();
+    auto reader = roofer::io::createPointCloudReaderLASlib(*pj);
+    reader->open(
+        "data/wippolder/objects/503100000030812/crop/"
+        "503100000030812_pointcloud.las");
+    roofer::PointCollection points, roof;
+    roofer::vec1i classification;
+    reader->readPointCloud(points, &classification);
+    for (size_t i = 0; i < points.size(); ++i) {
+      if (classification[i] == 6) roof.push_back(points[i]);
+    }
+    return roof;
+  }
+
+  bool has_roof_elevations(
+      const roofer::reconstruction::PlaneDetectorInterface& detector) {
+    return detector.roof_elevation_70p || detector.roof_elevation_50p ||
+           detector.roof_elevation_min || detector.roof_elevation_max;
+  }
+
+}  // namespace
+
+// roofer-app reuses one detector per worker thread, a building without roof
+// planes must not get the roof elevations of the building before it
+TEST_CASE("plane-detector-reuse") {
+  auto detector = roofer::reconstruction::createPlaneDetector();
+  auto roof = building_points();
+  REQUIRE(roof.size() > 100);
+
+  detector->detect(roof);
+  REQUIRE(detector->pts_per_roofplane.size() > 0);
+  REQUIRE(detector->roof_elevation_70p.has_value());
+  REQUIRE(detector->roof_elevation_min.has_value());
+  CHECK(*detector->roof_elevation_min <= *detector->roof_elevation_50p);
+  CHECK(*detector->roof_elevation_50p <= *detector->roof_elevation_70p);
+  CHECK(*detector->roof_elevation_70p <= *detector->roof_elevation_max);
+
+  SECTION("no points") {
+    detector->detect(roofer::PointCollection());
+    CHECK(detector->roof_type == "no points");
+    CHECK(detector->pts_per_roofplane.empty());
+    CHECK_FALSE(has_roof_elevations(*detector));
+  }
+  SECTION("too few points for a plane") {
+    roofer::PointCollection sparse;
+    for (size_t i = 0; i < 10; ++i) sparse.push_back(roof[i]);
+    detector->detect(sparse);
+    CHECK(detector->pts_per_roofplane.empty());
+    CHECK_FALSE(has_roof_elevations(*detector));
+  }
+}